@@ -0,0 +1,837 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/raycast.h"
+
+/*
+headless benchmark driver, every scene is generated from a fixed seed and flown through on a
+scripted camera path so runs are comparable between builds, results are printed one json object
+per scene, and a checksum of every frame is compared against a golden file to catch changes in output
+
+usage: bench [-w width] [-h height] [-f frames] [-t threads] [-r rays] [-T transposed_walls] [-s render_scale] [-L linear_upscale] [-m memory_block] [-v visibility_distance] [-V unlimited_visibility] [-p shading] [-c column_depth] [-H cell_heights] [-l lightmap] [-C frame_cache] [-b batch_views] [-S scene_prefix] [-g golden_file] [-G golden_file_to_write]
+
+-v n culls objects more than n cells away, so those runs differ from the golden checksums, -V 1 builds the set
+with no max_distance, which only culls what can't be seen, so those runs must still match them (run it on the
+64 and 256 scenes and maze_1024 with -S, on the open 1024 maps every cell's set is close to the whole map, as it
+is on maze_1024 with -H, whose lower walls are seen over),
+-S only runs the scenes whose names start with scene_prefix
+
+scenes with a chunk_shift write their map to a tiled map file in /tmp and read it from there, streaming the chunks
+around the camera every frame, the map and path are those of the scene without _tiled so the checksums match too
+
+options that change what is drawn give the golden key a suffix, so each has checksums of its own:
+-p 1 shades through the pixel functions and -p 2 through the span functions, both draw the same (_shaded),
+-c 1 turns on column depth mode (_column), -H 1 gives every cell a height (_heights), -l 1 bakes a lightmap of
+lights along the path and a sun (_lit), -s n draws at 1 / n of the size and upscales to it with the nearest pixel
+(_scalen) or with -L 1 by blending the nearest four (_scalen_linear), the float and fixed builds (make bench builds
+build/bench_float and build/bench_fixed) add _float and _fixed, -t, -T, -m and -V only change how a frame is drawn,
+not what
+
+-C 1 turns on the frame cache and holds every pose of the path for four frames, changing only the pitch and then
+the height on the last two, on the second frame of every other pose a map cell is walled up or opened and an
+object moved, so the cache has to drop hits the edit made stale, every frame is drawn again by a renderer without
+the cache and any difference fails the run (_cache, -f 400 is the long run the golden file has), -b n draws n
+views of the path at once with a batch, the first filling the top half of the frame and the rest splitting the
+bottom half, and draws every view again on its own renderer, any difference fails the run (_batchn)
+
+the bench is linked with malloc, calloc and realloc wrapped, frame_allocations counts the calls made while
+drawing every frame after the first, with -m 1 there must be none, or the run fails
+*/
+
+// golden checksums differ between math types, so each build has keys of its own
+#if defined(RAYCAST_PRECISION_FLOAT)
+#define BENCH_PRECISION "_float"
+#elif defined(RAYCAST_PRECISION_FIXED)
+#define BENCH_PRECISION "_fixed"
+#else
+#define BENCH_PRECISION ""
+#endif
+
+typedef enum {
+	bench_open,
+	bench_maze,
+	bench_pillars
+} bench_layout_t;
+
+typedef struct {
+	const char *name;
+	bench_layout_t layout;
+	uint32_t size, object_count, chunk_shift;
+} bench_scene_t;
+
+static const bench_scene_t bench_scenes[] = {
+	{"open_64", bench_open, 64, 0, 0},
+	{"open_1024", bench_open, 1024, 1000, 0},
+	{"maze_64", bench_maze, 64, 100, 0},
+	{"maze_256", bench_maze, 256, 1000, 0},
+	{"maze_1024", bench_maze, 1024, 0, 0},
+	{"pillars_256", bench_pillars, 256, 10000, 0},
+	{"pillars_1024", bench_pillars, 1024, 100000, 0},
+	{"maze_1024_tiled", bench_maze, 1024, 0, 5},
+};
+
+typedef struct {
+	uint32_t width, height, frames, threads, rays, transposed, scale, linear, memory_block, visibility, unlimited_visibility;
+	uint32_t shading, column_depth, heights, lightmap, frame_cache, batch;
+	const char *scenes, *golden, *write_golden;
+} bench_options_t;
+
+// calls to the allocator, counted from any thread
+static uint64_t bench_allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __real_realloc(pointer, size);
+}
+
+// small fixed generator so scenes don't depend on the platform's rand
+static uint32_t bench_seed;
+
+static uint32_t bench_random(void) {
+	bench_seed = bench_seed * 1664525u + 1013904223u;
+	return bench_seed >> 8;
+}
+
+static double bench_random_unit(void) {
+	return bench_random() / (double)(1 << 24);
+}
+
+static double bench_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_hash(uint64_t hash, const uint32_t *data, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// camera path, a slow loop around the middle of the map that also sways and looks up and down
+static void bench_path(const bench_scene_t *scene, uint32_t frame, uint32_t frames, double *x, double *y, double *angle, int *pitch) {
+	double t = frame / (double)frames * 2 * M_PI;
+	double radius = scene->size * 0.3;
+
+	*x = scene->size / 2.0 + radius * cos(t) + 0.5;
+	*y = scene->size / 2.0 + radius * sin(2 * t) / 2 + 0.5;
+	*angle = t * 3 + sin(t * 5) / 2;
+	*pitch = (int)(sin(t * 7) * 20);
+}
+
+// generates the map of a scene, the cells along the camera path are always left empty
+static void bench_build_map(const bench_scene_t *scene, uint8_t *map) {
+	uint32_t size = scene->size;
+
+	if (scene->layout == bench_maze) {
+		// recursive backtracker over the odd cells, walls fill everything it doesn't carve
+		memset(map, 1, size * size);
+
+		uint32_t *stack = (uint32_t *) malloc(size * size * sizeof(uint32_t));
+		uint32_t depth = 0;
+
+		stack[depth++] = 1 + size * 1;
+		map[1 + size * 1] = 0;
+
+		while (depth != 0) {
+			uint32_t cell = stack[depth - 1];
+			int cell_x = cell % size, cell_y = cell / size;
+
+			int options[4], option_count = 0;
+			static const int dx[4] = {2, -2, 0, 0}, dy[4] = {0, 0, 2, -2};
+
+			for (int i = 0; i < 4; i++) {
+				int next_x = cell_x + dx[i], next_y = cell_y + dy[i];
+				if (next_x > 0 && next_y > 0 && next_x < (int)size - 1 && next_y < (int)size - 1 && map[next_x + size * next_y]) options[option_count++] = i;
+			}
+
+			if (option_count == 0) {
+				depth--;
+				continue;
+			}
+
+			int i = options[bench_random() % option_count];
+			map[cell_x + dx[i] / 2 + size * (cell_y + dy[i] / 2)] = 0;
+			map[cell_x + dx[i] + size * (cell_y + dy[i])] = 0;
+			stack[depth++] = cell_x + dx[i] + size * (cell_y + dy[i]);
+		}
+
+		free(stack);
+	} else {
+		uint32_t pillar_chance = scene->layout == bench_pillars ? 12 : 0;
+
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				int border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+				map[x + size * y] = border ? 1 : (bench_random() % 100 < pillar_chance ? 1 + bench_random() % 2 : 0);
+			}
+		}
+	}
+
+	// a few wall types so every wall texture gets drawn
+	for (uint32_t i = 0; i < size * size; i++) {
+		if (map[i] != 0) map[i] = 1 + i % 2;
+	}
+
+	// sampled finer than any frame count the path is flown at, so the map doesn't depend on it
+	for (uint32_t sample = 0; sample < 16384; sample++) {
+		double x, y, angle;
+		int pitch;
+		bench_path(scene, sample, 16384, &x, &y, &angle, &pitch);
+
+		for (int oy = -1; oy <= 1; oy++) {
+			for (int ox = -1; ox <= 1; ox++) {
+				int cell_x = (int)x + ox, cell_y = (int)y + oy;
+				if (cell_x > 0 && cell_y > 0 && cell_x < (int)size - 1 && cell_y < (int)size - 1) map[cell_x + size * cell_y] = 0;
+			}
+		}
+	}
+}
+
+// procedural textures, two walls, floor, ceiling, a cut out sprite and a translucent sprite
+static void bench_build_atlas(raycast_texture_atlas_t *atlas) {
+	static uint32_t texels[64 * 64];
+
+	for (int texture = 0; texture < 6; texture++) {
+		for (uint32_t y = 0; y < 64; y++) {
+			for (uint32_t x = 0; x < 64; x++) {
+				uint32_t color = ((x * 4 + texture * 40) << 24) | ((y * 4) << 16) | (((x ^ y) * 4 + texture * 20) << 8);
+				uint32_t alpha = 255;
+
+				if (texture == 4) alpha = (x - 32) * (x - 32) + (y - 32) * (y - 32) < 900 ? 255 : 0;
+				if (texture == 5) alpha = 128;
+
+				texels[x + 64 * y] = color | alpha;
+			}
+		}
+		raycast_texture_atlas_add(atlas, texels, 64, 64);
+	}
+
+	for (int face = 0; face < 4; face++) {
+		raycast_texture_atlas_set_wall(atlas, 1, face, 0);
+		raycast_texture_atlas_set_wall(atlas, 2, face, 1);
+	}
+
+	atlas->floor_texture = 2;
+	atlas->ceiling_texture = 3;
+}
+
+static void bench_build_objects(const bench_scene_t *scene, const uint8_t *map, raycast_object_t *objects) {
+	uint32_t size = scene->size;
+
+	for (uint32_t i = 0; i < scene->object_count; i++) {
+		double x, y;
+		do {
+			x = 1 + bench_random_unit() * (size - 2);
+			y = 1 + bench_random_unit() * (size - 2);
+		} while (map[(int)x + size * (int)y] != 0);
+
+		raycast_object_init(objects + i, i, x, y);
+		objects[i].texture = i % 4 == 0 ? 5 : 4;
+		objects[i].translucent = i % 4 == 0;
+	}
+}
+
+static int bench_compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// looks up the golden checksum of a scene, returns 0 if the file has no entry for it
+static int bench_find_golden(const char *path, const char *key, uint64_t *checksum) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) return 0;
+
+	char name[128];
+	unsigned long long value;
+	int found = 0;
+
+	while (fscanf(file, "%127s %llx", name, &value) == 2) {
+		if (strcmp(name, key) == 0) {
+			*checksum = value;
+			found = 1;
+		}
+	}
+
+	fclose(file);
+	return found;
+}
+
+// color of a surface pixel with -p, the pixel and span functions both shade through it so they draw the same frame
+static uint32_t bench_shade_surface(int map_x, int map_y, raycast_real_t unit_x, raycast_real_t unit_y, raycast_face_t face, raycast_real_t depth, uint8_t light) {
+	uint32_t checker = ((int)(unit_x * 8) ^ (int)(unit_y * 8)) & 1;
+	uint32_t fog = (uint32_t)(255 / (1 + depth / 8));
+
+	uint32_t r = ((map_x * 37 + face * 40) & 127) + checker * 64;
+	uint32_t g = ((map_y * 23 + face * 20) & 127) + checker * 32;
+	uint32_t b = fog / 2 + 64;
+
+	return ((r * light / 255) << 24) | ((g * light / 255) << 16) | ((b * light / 255) << 8) | 255;
+}
+
+// sprites are cut out to a circle, and objects with ids divisible by 4, the translucent ones, are blended half over what is behind
+static uint32_t bench_shade_sprite(uint32_t behind, int id, raycast_real_t unit_x, raycast_real_t unit_y, raycast_real_t depth) {
+	raycast_real_t dx = unit_x - (raycast_real_t)0.5;
+	raycast_real_t dy = unit_y - (raycast_real_t)0.5;
+	if (dx * dx + dy * dy > (raycast_real_t)0.2) return behind;
+
+	uint32_t color = ((uint32_t)(id * 53 & 255) << 24) | ((uint32_t)(id * 97 & 255) << 16) | ((uint32_t)(255 / (1 + depth)) << 8) | 255;
+	if (id % 4 != 0) return color;
+
+	return (((behind >> 1) & 0x7F7F7F00) + ((color >> 1) & 0x7F7F7F00)) | 255;
+}
+
+static void bench_surface_pixel(raycast_screen_pixel_t *pixel, int map_x, int map_y, raycast_real_t unit_x, raycast_real_t unit_y, raycast_face_t face, raycast_real_t depth) {
+	raycast_uint32_to_color(bench_shade_surface(map_x, map_y, unit_x, unit_y, face, depth, pixel->light), &pixel->color);
+}
+
+static void bench_sprite_pixel(raycast_screen_pixel_t *pixel, int id, raycast_real_t unit_x, raycast_real_t unit_y, raycast_real_t depth) {
+	raycast_uint32_to_color(bench_shade_sprite(raycast_color_to_uint32(&pixel->color), id, unit_x, unit_y, depth), &pixel->color);
+}
+
+static void bench_surface_span(raycast_surface_span_t *span) {
+	for (uint32_t i = 0; i < span->count; i++) {
+		*span->pixels[i] = bench_shade_surface(span->map_x[i], span->map_y[i], span->unit_x[i], span->unit_y[i], span->face, span->depth[i], span->light[i]);
+	}
+}
+
+static void bench_sprite_span(raycast_sprite_span_t *span) {
+	for (uint32_t i = 0; i < span->count; i++) {
+		*span->pixels[i] = bench_shade_sprite(*span->pixels[i], span->id, span->unit_x[i], span->unit_y, span->depth);
+	}
+}
+
+// heights for -H, walls from half to one and a half times wall_height and every eighth empty cell a raised floor
+static void bench_build_heights(const uint8_t *map, uint8_t *heights, uint32_t size) {
+	for (uint32_t i = 0; i < size * size; i++) {
+		uint32_t hash = i * 2654435761u;
+
+		if (map[i] != 0) {
+			heights[i] = 8 + (hash >> 24) % 17;
+		} else {
+			heights[i] = (hash >> 24) % 8 == 0 ? 1 + (hash >> 20) % 4 : 0;
+		}
+	}
+}
+
+#define BENCH_LIGHTS 16
+
+// lights for -l, spread along the camera path so the frames see them
+static void bench_build_lights(const bench_scene_t *scene, raycast_light_t *lights) {
+	for (uint32_t i = 0; i < BENCH_LIGHTS; i++) {
+		double x, y, angle;
+		int pitch;
+		bench_path(scene, i, BENCH_LIGHTS, &x, &y, &angle, &pitch);
+
+		lights[i].position.x = x;
+		lights[i].position.y = y;
+		lights[i].radius = 6;
+		lights[i].intensity = 0.7;
+	}
+}
+
+// applies the options every renderer of a run shares, returns -1 if one of them can't be turned on
+static int bench_setup_renderer(raycast_renderer_t *renderer, const bench_options_t *options, uint32_t threads) {
+	int failed = raycast_renderer_set_thread_count(renderer, threads) != 0;
+	failed |= raycast_renderer_set_transposed_walls(renderer, options->transposed != 0) != 0;
+	failed |= raycast_renderer_set_render_scale(renderer, options->scale, options->scale) != 0;
+	raycast_renderer_set_linear_upscale(renderer, options->linear != 0);
+
+	if (options->column_depth) failed |= raycast_renderer_set_column_depth(renderer, 1) != 0;
+	if (options->shading == 2) raycast_renderer_set_span_functions(renderer, bench_surface_span, bench_sprite_span);
+
+	return failed ? -1 : 0;
+}
+
+/*
+pose of a frame of the -C run, each pose of the path is held for four frames, drawn as it is, again unchanged,
+with the pitch moved and then also raised, so the cache gets frames to skip and frames to redraw from its hits
+*/
+static void bench_cache_pose(const bench_scene_t *scene, uint32_t frame, uint32_t frames, double *x, double *y, double *angle, int *pitch, double *height) {
+	bench_path(scene, frame & ~3u, frames, x, y, angle, pitch);
+
+	if ((frame & 3) >= 2) *pitch += 25;
+	*height = (frame & 3) == 3 ? 0.1 : 0;
+}
+
+// the first view of -b fills the top half of the frame and the rest split the bottom half, all of them draw straight into it
+static void bench_batch_layout(const bench_options_t *options, uint32_t *pixels, raycast_view_t *views, uint32_t count) {
+	uint32_t top = count == 1 ? options->height : options->height / 2;
+	uint32_t share = count == 1 ? 0 : options->width / (count - 1);
+
+	for (uint32_t i = 0; i < count; i++) {
+		raycast_view_t *view = views + i;
+		view->pixel_data = pixels;
+		view->stride = options->width;
+
+		if (i == 0) {
+			view->x = 0;
+			view->y = 0;
+			view->width = options->width;
+			view->height = top;
+			continue;
+		}
+
+		view->x = share * (i - 1);
+		view->y = top;
+		view->width = i == count - 1 ? options->width - view->x : share;
+		view->height = options->height - top;
+	}
+}
+
+// runs one scene and prints its json line, returns 1 if its checksum doesn't match the golden file or one of its checks fails
+static int bench_run(const bench_scene_t *scene, const bench_options_t *options, FILE *golden_out) {
+	uint32_t size = scene->size;
+
+	bench_seed = 12345 + size * 7 + scene->layout * 131 + scene->object_count;
+
+	uint8_t *map = (uint8_t *) malloc(size * size);
+	uint8_t *heights = options->heights ? (uint8_t *) malloc(size * size) : NULL;
+	raycast_object_t *objects = (raycast_object_t *) malloc((scene->object_count + 1) * sizeof(raycast_object_t));
+	uint32_t *pixels = (uint32_t *) malloc(options->width * options->height * sizeof(uint32_t));
+	double *frame_times = (double *) malloc(options->frames * sizeof(double));
+
+	bench_build_map(scene, map);
+	bench_build_objects(scene, map, objects);
+
+	raycast_texture_atlas_t atlas;
+	raycast_texture_atlas_init(&atlas, 6 * 64 * 64, 6);
+	bench_build_atlas(&atlas);
+
+	raycast_scene_t world;
+	raycast_scene_init(&world, map, size, size, scene->object_count ? objects : NULL, scene->object_count);
+	world.textures = &atlas;
+
+	if (heights != NULL) {
+		bench_build_heights(map, heights, size);
+		world.cell_heights = heights;
+	}
+
+	// the file is unlinked as soon as it is mapped, the mapping keeps it until the map is closed
+	raycast_tiled_map_t tiled;
+	int tiled_failed = 0;
+
+	if (scene->chunk_shift != 0) {
+		char path[] = "/tmp/bench_tiled_XXXXXX";
+		int fd = mkstemp(path);
+
+		tiled_failed = fd == -1;
+		if (fd != -1) {
+			close(fd);
+			tiled_failed = raycast_tiled_map_write(path, map, NULL, NULL, size, size, scene->chunk_shift) != 0 || raycast_tiled_map_open(&tiled, path, 256) != 0;
+			unlink(path);
+		}
+
+		if (tiled_failed) {
+			fprintf(stderr, "bench: failed to write the tiled map of %s\n", scene->name);
+			exit(1);
+		}
+		raycast_scene_set_tiled_map(&world, &tiled);
+	}
+
+	// with -v n objects are culled through a visibility set that sees up to n cells away, with -V 1 through one that sees the whole map
+	raycast_visibility_t visibility;
+	raycast_visibility_init(&visibility);
+	raycast_visibility_set_thread_count(&visibility, options->threads);
+
+	double visibility_time = 0;
+
+	if (options->visibility > 0 || options->unlimited_visibility) {
+		visibility.max_distance = options->unlimited_visibility ? 0 : options->visibility;
+
+		double start = bench_now();
+		if (raycast_visibility_build(&visibility, &world) != 0) {
+			fprintf(stderr, "bench: failed to build the visibility set of %s\n", scene->name);
+			exit(1);
+		}
+		visibility_time = bench_now() - start;
+
+		world.visibility = &visibility;
+	}
+
+	// with -l 1 surfaces are lit by a lightmap baked from lights along the path, a sun and some ambient light
+	raycast_lightmap_t lightmap;
+	raycast_light_t lights[BENCH_LIGHTS];
+	double lightmap_time = 0;
+
+	if (options->lightmap) {
+		bench_build_lights(scene, lights);
+
+		double start = bench_now();
+		if (raycast_lightmap_init(&lightmap, &world) != 0 || raycast_lightmap_set_thread_count(&lightmap, options->threads) != 0) {
+			fprintf(stderr, "bench: failed to create the lightmap of %s\n", scene->name);
+			exit(1);
+		}
+
+		lightmap.lights = lights;
+		lightmap.light_count = BENCH_LIGHTS;
+		lightmap.ambient = 0.25;
+		lightmap.sun_direction.x = 0.6;
+		lightmap.sun_direction.y = 0.8;
+		lightmap.sun_intensity = 0.5;
+
+		if (raycast_lightmap_bake(&lightmap, &world) != 0) {
+			fprintf(stderr, "bench: failed to bake the lightmap of %s\n", scene->name);
+			exit(1);
+		}
+		lightmap_time = bench_now() - start;
+
+		world.lightmap = &lightmap;
+	}
+
+	surface_pixel_t surface_pixel = options->shading ? bench_surface_pixel : NULL;
+	sprite_pixel_t sprite_pixel = options->shading ? bench_sprite_pixel : NULL;
+
+	// with -m 1 the renderer is carved out of one block sized for exactly the features the run uses
+	raycast_renderer_features_t features = {options->threads, scene->object_count, !options->column_depth, options->transposed != 0, options->frame_cache != 0, options->scale > 1};
+	size_t block_size = (raycast_renderer_memory_size(options->width, options->height, &features) + RAYCAST_MEMORY_ALIGNMENT - 1) & ~(size_t)(RAYCAST_MEMORY_ALIGNMENT - 1);
+	void *block = options->memory_block ? aligned_alloc(RAYCAST_MEMORY_ALIGNMENT, block_size) : NULL;
+
+	raycast_renderer_t renderer;
+	int init_failed = options->memory_block ?
+		block == NULL || raycast_renderer_init_memory(&renderer, pixels, options->width, options->height, surface_pixel, sprite_pixel, &features, block, block_size) != 0 :
+		raycast_renderer_init(&renderer, pixels, options->width, options->height, surface_pixel, sprite_pixel) != 0;
+
+	if (!init_failed) init_failed = bench_setup_renderer(&renderer, options, options->threads) != 0 || (options->frame_cache && raycast_renderer_set_frame_cache(&renderer, 1) != 0);
+
+	// with -C 1 every frame is drawn again by a renderer without the cache
+	raycast_renderer_t reference;
+	uint32_t *reference_pixels = NULL;
+
+	if (!init_failed && options->frame_cache) {
+		reference_pixels = (uint32_t *) malloc(options->width * options->height * sizeof(uint32_t));
+		init_failed = reference_pixels == NULL || raycast_renderer_init(&reference, reference_pixels, options->width, options->height, surface_pixel, sprite_pixel) != 0 ||
+			bench_setup_renderer(&reference, options, options->threads) != 0;
+	}
+
+	if (init_failed) {
+		fprintf(stderr, "bench: failed to create a %ux%u renderer\n", options->width, options->height);
+		exit(1);
+	}
+
+	// with -b n the views are drawn by a batch, and every view again on a renderer of its own
+	uint32_t view_count = options->batch;
+	raycast_batch_t batch;
+	raycast_view_t *views = NULL;
+	raycast_camera_t *cameras = NULL;
+	raycast_renderer_t *singles = NULL;
+	uint32_t **single_pixels = NULL;
+
+	if (view_count != 0) {
+		views = (raycast_view_t *) calloc(view_count, sizeof(raycast_view_t));
+		cameras = (raycast_camera_t *) malloc(view_count * sizeof(raycast_camera_t));
+		singles = (raycast_renderer_t *) malloc(view_count * sizeof(raycast_renderer_t));
+		single_pixels = (uint32_t **) calloc(view_count, sizeof(uint32_t *));
+
+		init_failed = views == NULL || cameras == NULL || singles == NULL || single_pixels == NULL;
+		if (!init_failed) bench_batch_layout(options, pixels, views, view_count);
+
+		uint32_t max_height = view_count == 1 ? options->height : options->height - options->height / 2;
+		init_failed = init_failed || raycast_batch_init(&batch, options->width, max_height, surface_pixel, sprite_pixel, options->threads) != 0;
+
+		for (uint32_t i = 0; !init_failed && i < batch.thread_count; i++) {
+			init_failed = bench_setup_renderer(batch.renderers + i, options, 1) != 0;
+		}
+
+		for (uint32_t i = 0; !init_failed && i < view_count; i++) {
+			single_pixels[i] = (uint32_t *) malloc(views[i].width * views[i].height * sizeof(uint32_t));
+			init_failed = single_pixels[i] == NULL || raycast_renderer_init(singles + i, single_pixels[i], views[i].width, views[i].height, surface_pixel, sprite_pixel) != 0 ||
+				bench_setup_renderer(singles + i, options, 1) != 0;
+
+			raycast_camera_init(cameras + i, singles + i, 0, 0);
+			views[i].camera = cameras + i;
+		}
+
+		if (init_failed) {
+			fprintf(stderr, "bench: failed to create a batch of %u views\n", view_count);
+			exit(1);
+		}
+	}
+
+	raycast_camera_t camera;
+	raycast_camera_init(&camera, &renderer, 0, 0);
+
+	uint64_t checksum = 1469598103934665603ULL;
+	double render_time = 0;
+	uint64_t frame_allocations = 0;
+	uint32_t cache_mismatches = 0;
+	uint32_t batch_mismatches = 0;
+	int64_t edited_cell = -1;
+
+	for (uint32_t frame = 0; frame < options->frames; frame++) {
+		double x, y, angle, height = 0;
+		int pitch;
+
+		if (options->frame_cache) {
+			bench_cache_pose(scene, frame, options->frames, &x, &y, &angle, &pitch, &height);
+		} else {
+			bench_path(scene, frame, options->frames, &x, &y, &angle, &pitch);
+		}
+
+		camera.position.x = x;
+		camera.position.y = y;
+		camera.pitch = pitch;
+		camera.height = height;
+		raycast_camera_set_rotation(&camera, angle);
+
+		// on the second frame of every other -C pose the last cell walled up is opened again, one two steps ahead of the camera is walled up and an object moves
+		if (options->frame_cache && frame % 8 == 5) {
+			if (edited_cell != -1) {
+				map[edited_cell] = 0;
+				raycast_renderer_invalidate_cell(&renderer, edited_cell % size, edited_cell / size);
+				edited_cell = -1;
+			}
+
+			int cell_x = (int)(x + camera.direction.x * 2);
+			int cell_y = (int)(y + camera.direction.y * 2);
+			int64_t cell = cell_x + (int64_t)size * cell_y;
+
+			if (scene->chunk_shift == 0 && cell_x > 0 && cell_y > 0 && cell_x < (int)size - 1 && cell_y < (int)size - 1 && map[cell] == 0 && (cell_x != (int)x || cell_y != (int)y)) {
+				map[cell] = 2;
+				raycast_renderer_invalidate_cell(&renderer, cell_x, cell_y);
+				edited_cell = cell;
+			}
+
+			if (scene->object_count != 0) objects[frame / 8 % scene->object_count].position.y += 0.25;
+		}
+
+		// the views of -b fly the same path spread out over it
+		for (uint32_t i = 0; i < view_count; i++) {
+			bench_path(scene, (frame + i * options->frames / view_count) % options->frames, options->frames, &x, &y, &angle, &pitch);
+
+			cameras[i].position.x = x;
+			cameras[i].position.y = y;
+			cameras[i].pitch = pitch;
+			raycast_camera_set_rotation(cameras + i, angle);
+		}
+
+		uint64_t allocations = bench_allocations;
+
+		double start = bench_now();
+		if (scene->chunk_shift != 0) raycast_tiled_map_stream(&tiled, &camera, 64);
+
+		if (view_count != 0) {
+			if (raycast_batch_render(&batch, &world, views, view_count) != 0) {
+				fprintf(stderr, "bench: failed to draw a batch of %u views\n", view_count);
+				exit(1);
+			}
+		} else {
+			raycast_render(&renderer, &world, &camera);
+		}
+		frame_times[frame] = bench_now() - start;
+
+		if (frame > 0) frame_allocations += bench_allocations - allocations;
+
+		render_time += frame_times[frame];
+		checksum = bench_hash(checksum, pixels, options->width * options->height);
+
+		if (options->frame_cache) {
+			raycast_render(&reference, &world, &camera);
+			cache_mismatches += memcmp(pixels, reference_pixels, options->width * options->height * sizeof(uint32_t)) != 0;
+		}
+
+		for (uint32_t i = 0; i < view_count; i++) {
+			raycast_view_t *view = views + i;
+			raycast_render(singles + i, &world, cameras + i);
+
+			for (uint32_t row = 0; row < view->height; row++) {
+				if (memcmp(pixels + (view->y + row) * options->width + view->x, single_pixels[i] + row * view->width, view->width * sizeof(uint32_t)) != 0) {
+					batch_mismatches++;
+					break;
+				}
+			}
+		}
+	}
+
+	if (edited_cell != -1) map[edited_cell] = 0;
+
+	// rays start on the camera path and head in random directions or towards random points
+	raycast_point_t *starts = (raycast_point_t *) malloc(options->rays * sizeof(raycast_point_t));
+	raycast_point_t *ends = (raycast_point_t *) malloc(options->rays * sizeof(raycast_point_t));
+	uint8_t *obstructed = (uint8_t *) malloc(options->rays);
+
+	for (uint32_t i = 0; i < options->rays; i++) {
+		double x, y, angle;
+		int pitch;
+		bench_path(scene, i, options->rays, &x, &y, &angle, &pitch);
+
+		starts[i].x = x;
+		starts[i].y = y;
+		ends[i].x = 1 + bench_random_unit() * (size - 2);
+		ends[i].y = 1 + bench_random_unit() * (size - 2);
+	}
+
+	raycast_hit_info_t hit_info;
+	uint32_t hits = 0;
+
+	double start = bench_now();
+	for (uint32_t i = 0; i < options->rays; i++) {
+		raycast_cast_ray(&hit_info, &world, starts[i].x, starts[i].y, ends[i].x - starts[i].x, ends[i].y - starts[i].y);
+		hits += hit_info.wall_type != 0;
+	}
+	double cast_time = bench_now() - start;
+
+	uint32_t blocked = 0;
+
+	start = bench_now();
+	for (uint32_t i = 0; i < options->rays; i++) {
+		blocked += raycast_check_obstruction(&world, starts[i].x, starts[i].y, ends[i].x, ends[i].y);
+	}
+	double sight_time = bench_now() - start;
+
+	raycast_distance_field_t field;
+	raycast_distance_field_init(&field, &world);
+	raycast_distance_field_set_thread_count(&field, options->threads);
+
+	start = bench_now();
+	raycast_check_obstructions(&field, &world, starts, ends, obstructed, options->rays);
+	double field_time = bench_now() - start;
+
+	uint32_t field_blocked = 0;
+	for (uint32_t i = 0; i < options->rays; i++) {
+		field_blocked += obstructed[i];
+	}
+
+	qsort(frame_times, options->frames, sizeof(double), bench_compare_doubles);
+
+	char key[160];
+	int length = snprintf(key, sizeof(key), "%s_%ux%u_%u%s%s%s%s%s%s", scene->name, options->width, options->height, options->frames, BENCH_PRECISION,
+		options->shading ? "_shaded" : "", options->column_depth ? "_column" : "", options->heights ? "_heights" : "", options->lightmap ? "_lit" : "", options->frame_cache ? "_cache" : "");
+	if (options->scale > 1) length += snprintf(key + length, sizeof(key) - length, "_scale%u%s", options->scale, options->linear ? "_linear" : "");
+	if (view_count != 0) snprintf(key + length, sizeof(key) - length, "_batch%u", view_count);
+
+	uint64_t golden;
+	const char *golden_state = "none";
+	int failed = cache_mismatches != 0 || batch_mismatches != 0 || (options->memory_block && frame_allocations != 0);
+
+	if (options->golden != NULL && bench_find_golden(options->golden, key, &golden)) {
+		golden_state = golden != checksum ? "mismatch" : "ok";
+		failed |= golden != checksum;
+	}
+
+	if (golden_out != NULL) fprintf(golden_out, "%s %016llx\n", key, (unsigned long long)checksum);
+
+	printf("{\"scene\": \"%s\", \"key\": \"%s\", \"map_size\": %u, \"chunk_shift\": %u, \"objects\": %u, \"width\": %u, \"height\": %u, \"threads\": %u, \"transposed\": %u, \"scale\": %u, \"linear_upscale\": %u, \"memory_block\": %u, ",
+		scene->name, key, size, scene->chunk_shift, scene->object_count, options->width, options->height, options->threads, options->transposed != 0, options->scale, options->linear != 0, options->memory_block != 0);
+	printf("\"shading\": %u, \"column_depth\": %u, \"heights\": %u, \"lightmap\": %u, \"frame_cache\": %u, \"batch_views\": %u, \"visibility\": %u, \"unlimited_visibility\": %u, \"visibility_build_ms\": %.1f, \"lightmap_bake_ms\": %.1f, \"frames\": %u, ",
+		options->shading, options->column_depth != 0, options->heights != 0, options->lightmap != 0, options->frame_cache != 0, view_count,
+		options->visibility, options->unlimited_visibility != 0, visibility_time * 1e3, lightmap_time * 1e3, options->frames);
+	printf("\"ms_p50\": %.3f, \"ms_p90\": %.3f, \"ms_p99\": %.3f, \"ms_max\": %.3f, \"mpixels_per_s\": %.2f, \"frame_allocations\": %llu, \"cache_mismatches\": %u, \"batch_mismatches\": %u, ",
+		frame_times[options->frames / 2] * 1e3, frame_times[options->frames * 9 / 10] * 1e3, frame_times[options->frames * 99 / 100] * 1e3,
+		frame_times[options->frames - 1] * 1e3, (double)options->width * options->height * options->frames / render_time / 1e6,
+		(unsigned long long)frame_allocations, cache_mismatches, batch_mismatches);
+	printf("\"rays\": %u, \"cast_rays_per_s\": %.0f, \"sight_checks_per_s\": %.0f, \"field_sight_checks_per_s\": %.0f, \"hits\": %u, \"blocked\": %u, \"field_blocked\": %u, ",
+		options->rays, options->rays / cast_time, options->rays / sight_time, options->rays / field_time, hits, blocked, field_blocked);
+	printf("\"checksum\": \"%016llx\", \"golden\": \"%s\"}\n", (unsigned long long)checksum, golden_state);
+	fflush(stdout);
+
+	for (uint32_t i = 0; i < view_count; i++) {
+		raycast_renderer_free(singles + i);
+		free(single_pixels[i]);
+	}
+	if (view_count != 0) raycast_batch_free(&batch);
+
+	if (options->frame_cache) raycast_renderer_free(&reference);
+	if (options->lightmap) raycast_lightmap_free(&lightmap);
+	if (scene->chunk_shift != 0) raycast_tiled_map_close(&tiled);
+	raycast_distance_field_free(&field);
+	raycast_visibility_free(&visibility);
+	raycast_renderer_free(&renderer);
+	raycast_texture_atlas_free(&atlas);
+	free(views);
+	free(cameras);
+	free(singles);
+	free(single_pixels);
+	free(reference_pixels);
+	free(block);
+	free(starts);
+	free(ends);
+	free(obstructed);
+	free(frame_times);
+	free(pixels);
+	free(objects);
+	free(heights);
+	free(map);
+
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	bench_options_t options = {640, 360, 120, 1, 200000, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "", NULL, NULL};
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "-w") == 0) options.width = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-h") == 0) options.height = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-f") == 0) options.frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-t") == 0) options.threads = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-r") == 0) options.rays = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-T") == 0) options.transposed = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-s") == 0) options.scale = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-L") == 0) options.linear = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-m") == 0) options.memory_block = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-v") == 0) options.visibility = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-V") == 0) options.unlimited_visibility = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-p") == 0) options.shading = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-c") == 0) options.column_depth = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-H") == 0) options.heights = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-l") == 0) options.lightmap = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-C") == 0) options.frame_cache = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-b") == 0) options.batch = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-S") == 0) options.scenes = argv[i + 1];
+		else if (strcmp(argv[i], "-g") == 0) options.golden = argv[i + 1];
+		else if (strcmp(argv[i], "-G") == 0) options.write_golden = argv[i + 1];
+		else {
+			fprintf(stderr, "usage: bench [-w width] [-h height] [-f frames] [-t threads] [-r rays] [-T transposed_walls] [-s render_scale] [-L linear_upscale] [-m memory_block] [-v visibility_distance] [-V unlimited_visibility] [-p shading] [-c column_depth] [-H cell_heights] [-l lightmap] [-C frame_cache] [-b batch_views] [-S scene_prefix] [-g golden_file] [-G golden_file_to_write]\n");
+			return 2;
+		}
+	}
+
+	if (options.frames == 0 || options.rays == 0 || options.width == 0 || options.height == 0 || options.scale == 0) {
+		fprintf(stderr, "bench: sizes and counts must be positive\n");
+		return 2;
+	}
+
+	if (options.shading > 2 || (options.batch != 0 && (options.frame_cache || options.batch > options.width || options.height < 2))) {
+		fprintf(stderr, "bench: -p is 0, 1 or 2, -b can't be combined with -C and needs a frame at least as wide as its views and 2 rows tall\n");
+		return 2;
+	}
+
+	FILE *golden_out = NULL;
+	if (options.write_golden != NULL) {
+		golden_out = fopen(options.write_golden, "w");
+		if (golden_out == NULL) {
+			fprintf(stderr, "bench: can't write %s\n", options.write_golden);
+			return 2;
+		}
+	}
+
+	int failed = 0;
+	for (uint32_t i = 0; i < sizeof(bench_scenes) / sizeof(bench_scenes[0]); i++) {
+		if (strncmp(bench_scenes[i].name, options.scenes, strlen(options.scenes)) != 0) continue;
+		failed += bench_run(bench_scenes + i, &options, golden_out);
+	}
+
+	if (golden_out != NULL) fclose(golden_out);
+
+	if (failed) fprintf(stderr, "bench: %d scene(s) don't match the golden checksums or failed their checks\n", failed);
+	return failed != 0;
+}
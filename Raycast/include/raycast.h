@@ -2,6 +2,34 @@
 #define RAYCAST_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+/*
+the math type is picked at build time, define one of these before including this header
+and when compiling raycast.c (the makefile builds one library for each):
+RAYCAST_PRECISION_DOUBLE (the default), RAYCAST_PRECISION_FLOAT, or RAYCAST_PRECISION_FIXED,
+fixed keeps float coordinates in the api but runs the DDA and the depth buffer in 16.16 fixed point
+*/
+#if defined(RAYCAST_PRECISION_FLOAT) || defined(RAYCAST_PRECISION_FIXED)
+typedef float raycast_real_t;
+#else
+typedef double raycast_real_t;
+#endif
+
+/*
+one entry of the depth buffer, by default it matches the math type (a 16.16 fixed point distance in fixed mode),
+RAYCAST_DEPTH_32 stores it as a float in double builds, and RAYCAST_DEPTH_16 packs it into 16 bits
+of 9.6 fixed point in any build, where everything past 511 units is treated as equally far away
+*/
+#if defined(RAYCAST_DEPTH_16)
+typedef int16_t raycast_depth_t;
+#elif defined(RAYCAST_PRECISION_FIXED)
+typedef int32_t raycast_depth_t;
+#elif defined(RAYCAST_DEPTH_32)
+typedef float raycast_depth_t;
+#else
+typedef raycast_real_t raycast_depth_t;
+#endif
 
 /*
 all the possible faces a ray can hit
@@ -21,29 +49,69 @@ typedef struct {
 	uint8_t r, g, b, a;
 } raycast_color_t;
 
+// light is the scene's lightmap value for the surface (0 - 255), 255 when the scene has no lightmap
 typedef struct {
 	raycast_color_t color;
 	uint32_t location;
+	uint8_t light;
 } raycast_screen_pixel_t;
 
 /*
 this function runs for every pixel on the screen that coorelates to a surface, whether it be wall, floor, or ceiling
 it provides information about that pixels location in the world through its arguments
 the user can use this information to map textures to surfaces, implement depth lighting,
-source lighting, glossy floors, sunlight shadows, and more
+source lighting, glossy floors, sunlight shadows, and more, source lights and sunlight shadows are
+cheapest baked into a lightmap (see struct raycast_lightmap) whose value comes in the pixel's light
 the first parameter is the pixel that the user is supposed to change
 */
-typedef void (*surface_pixel_t)(raycast_screen_pixel_t*, int map_x, int map_y, double unit_x, double unit_y, raycast_face_t face, double depth);
+typedef void (*surface_pixel_t)(raycast_screen_pixel_t*, int map_x, int map_y, raycast_real_t unit_x, raycast_real_t unit_y, raycast_face_t face, raycast_real_t depth);
 
 /*
 similar to the function above, but it instead runs for every pixel on the screen
 that coorelates to a sprite in the raycast scene
 */
-typedef void (*sprite_pixel_t)(raycast_screen_pixel_t*, int id, double unit_x, double unit_y, double depth);
+typedef void (*sprite_pixel_t)(raycast_screen_pixel_t*, int id, raycast_real_t unit_x, raycast_real_t unit_y, raycast_real_t depth);
+
+/*
+a batch of surface pixels that already passed the depth test, one batch is made for every wall column
+and every floor / ceiling row, entry i of every array describes the same pixel, the user writes the
+final color straight into *pixels[i] in the same packed format as raycast_color_to_uint32, light[i] is the
+lightmap value of the pixel's surface like the light of raycast_screen_pixel_t
+*/
+typedef struct {
+	uint32_t count;
+	raycast_face_t face;
+	int *map_x, *map_y;
+	raycast_real_t *unit_x, *unit_y;
+	raycast_real_t *depth;
+	uint32_t **pixels;
+	uint32_t *locations;
+	uint8_t *light;
+} raycast_surface_span_t;
+
+/*
+same idea as the surface span, but made for every row of a sprite, unit_y and depth are the
+same for the whole row, pixels left with an alpha of 255 will occlude anything behind them
+*/
+typedef struct {
+	uint32_t count;
+	int id;
+	raycast_real_t unit_y, depth;
+	raycast_real_t *unit_x;
+	uint32_t **pixels;
+	uint32_t *locations;
+} raycast_sprite_span_t;
+
+/*
+span versions of the two pixel functions, they run once per batch instead of once per pixel,
+which saves the function call and color unpacking / packing for every pixel
+*/
+typedef void (*surface_span_t)(raycast_surface_span_t*);
+typedef void (*sprite_span_t)(raycast_sprite_span_t*);
 
 // simple 2d point struct
 typedef struct {
-	double x, y;
+	raycast_real_t x, y;
 } raycast_point_t;
 
 // vector is the same as point, only used to distinguish the intent of a variable
@@ -55,44 +123,244 @@ information about the hit location of the ray
 */
 typedef struct {
 	raycast_point_t hit_point;
-	double distance;
+	raycast_real_t distance;
 	raycast_face_t face;
 	uint8_t wall_type;
 } raycast_hit_info_t;
 
 /*
-objects represent basic information about sprites in the scene,
-its up to the user to provide the texture of the object
+objects represent basic information about sprites in the scene, its up to the user to provide the texture
+of the object, either through the sprite functions or through a texture index into the scene's atlas (-1 for none),
+objects with partly see through pixels (alpha between 0 and 255) should set translucent so they are drawn after
+every opaque object and back to front, opaque objects are drawn front to back
 */
 typedef struct {
 	int id;
 	raycast_point_t position;
-	double height, size;
+	raycast_real_t height, size;
+	int texture;
+	char translucent;
 } raycast_object_t;
 
+// one texture in an atlas, its width and height are 1 << width_shift and 1 << height_shift texels
+typedef struct {
+	uint32_t offset;
+	uint8_t width_shift, height_shift;
+} raycast_texture_t;
+
+/*
+holds every texture of a scene back to back in one block of texels, textures are stored column by column
+so a wall column reads its texels in order, wall textures are looked up by wall type and face (north - west)
+and floor / ceiling textures by cell through floor_map and ceiling_map, which can be NULL to use
+floor_texture and ceiling_texture everywhere, -1 means nothing is drawn for that surface
+*/
+typedef struct {
+	uint32_t *texels;
+	uint32_t texel_count, texel_capacity;
+	raycast_texture_t *textures;
+	uint32_t texture_count, texture_capacity;
+	int16_t wall_textures[256][4];
+	uint8_t *floor_map, *ceiling_map;
+	int floor_texture, ceiling_texture;
+} raycast_texture_atlas_t;
+
+// rows resolved together when copying transposed walls to the screen, one cache line of a column at 16
+#ifndef RAYCAST_RESOLVE_ROWS
+#define RAYCAST_RESOLVE_ROWS 16
+#endif
+
+// frames timed before a target frame time changes the render scale
+#ifndef RAYCAST_SCALE_FRAMES
+#define RAYCAST_SCALE_FRAMES 8
+#endif
+
+// every buffer carved out of a renderer's memory block starts on a multiple of this, one cache line
+#ifndef RAYCAST_MEMORY_ALIGNMENT
+#define RAYCAST_MEMORY_ALIGNMENT 64
+#endif
+
+// number of threads a renderer uses after raycast_renderer_init, 1 renders on the calling thread only
+#ifndef RAYCAST_DEFAULT_THREAD_COUNT
+#define RAYCAST_DEFAULT_THREAD_COUNT 1
+#endif
+
+/*
+filled in by every raycast_render call when the library is built with RAYCAST_PROFILE, without it the
+counters are compiled out and the stats stay zero, the struct is kept in every build so a renderer has the
+same layout whichever library it is linked against, times are in seconds from a monotonic clock, start_time is when
+the frame began, shaded counts pixels that passed the depth test and rejected the ones that failed it,
+dda_steps counts the cells every wall ray stepped through, counting rejected floor and ceiling pixels
+of textured rows costs an extra pass over each row
+*/
+typedef struct {
+	double start_time, frame_time;
+	double clear_time, wall_time, top_bottom_time, sprite_time, upscale_time;
+	uint64_t dda_steps;
+	uint64_t walls_shaded, top_bottom_shaded, sprites_shaded;
+	uint64_t top_bottom_rejected, sprites_rejected;
+	uint32_t sprites_drawn, sprites_culled;
+} raycast_frame_stats_t;
+
+/*
+persistent pool of worker threads owned by a renderer, the calling thread
+always takes part in the work so a pool of n threads only spawns n - 1 workers
+*/
+typedef struct raycast_thread_pool raycast_thread_pool_t;
+
+// per thread scratch memory of a renderer, used to build spans
+typedef struct raycast_scratch raycast_scratch_t;
+
+// floor and ceiling distance of every row of a renderer, rebuilt when the pitch or heights change
+typedef struct raycast_row_table raycast_row_table_t;
+
+// cached wall hits and frame state of a renderer, see raycast_renderer_set_frame_cache
+typedef struct raycast_frame_cache raycast_frame_cache_t;
+
+// a projected object that survived culling, the renderer keeps a sorted list of them for each frame
+typedef struct raycast_sprite raycast_sprite_t;
+
+// where the buffers of a renderer given a memory block are, see raycast_renderer_init_memory
+typedef struct raycast_renderer_memory raycast_renderer_memory_t;
+
+/*
+what a renderer's memory block holds besides the buffers every renderer needs, scratch memory for up to
+thread_count threads, room for sprite_capacity visible sprites a frame (more are culled), and the buffers
+needed to turn on a per pixel depth buffer (without it the renderer stays in column depth mode), transposed
+walls, the frame cache and a render scale above 1, turning on a feature without its buffers, or more threads
+than there is scratch memory for, makes the setter return -1
+*/
+typedef struct {
+	uint32_t thread_count, sprite_capacity;
+	char depth_buffer, transposed_walls, frame_cache, render_scale;
+} raycast_renderer_features_t;
+
+// see struct raycast_distance_field below, renderers can cast their wall rays through one
+typedef struct raycast_distance_field raycast_distance_field_t;
+
+// see struct raycast_tiled_map below, scenes can read their map from one instead of world_map
+typedef struct raycast_tiled_map raycast_tiled_map_t;
+
+// see struct raycast_lightmap below, scenes can light their surfaces with one
+typedef struct raycast_lightmap raycast_lightmap_t;
+
+// see struct raycast_visibility below, scenes can cull objects and lights the camera can't see with one
+typedef struct raycast_visibility raycast_visibility_t;
+
 /*
 the renderer is responsible for storing information about the screen,
 certain render settings, and the two pixel functions provided by the user
+
+when thread_count is greater than 1, walls are split into column bands and floors, ceilings
+and sprites into row bands, every pixel is still written by exactly one thread in the same order
+as the serial path so the output is identical, but the pixel functions must be thread safe
+
+when a span function is set it is used instead of the matching pixel function
+
+in column depth mode there is no depth buffer (depth_buffer is NULL), only the depth and the rows
+[wall_starts[x], wall_ends[x]) of the wall in each column are kept, floors and ceilings only fill
+the rows walls don't cover, and sprites are only tested against walls, so sprites that overlap
+each other are all drawn back to front
+
+wall_depths, wall_starts and wall_ends are kept in both modes, sprites that are off screen, behind the camera
+or hidden behind walls are culled before drawing, and the columns of a sprite hidden by walls are clipped off,
+sprites_drawn and sprites_culled count the objects that were drawn and culled in the last frame
+
+the wall pass never writes the depth buffer, it only records every column's wall in the wall arrays, and the
+floor and ceiling pass writes the depth of each row from them right before drawing the row, so the depth buffer
+is only ever written a row at a time
+
+with transposed walls, textured walls are drawn down the columns of wall_pixels, a column major copy of the
+screen, which is then resolved to pixel_data in row strips, so the wall pass never strides down the screen a
+row at a time
+
+with a render scale above 1, raycast_render draws the frame at (screen_width / scale_x) x (screen_height / scale_y)
+into scaled_pixels, so one wall ray is cast for every scale_x columns and one floor / ceiling row shaded for every
+scale_y rows, and scales it up to pixel_data, copying the nearest pixel or blending the four around it with linear
+upscaling, while it draws, screen_width, screen_height and pixel_data describe the scaled frame, so pixel and span
+functions get locations in it, with a target frame time raycast_render picks both scales itself
+
+with a distance field set, wall rays skip empty space through it, the field has to be built from the
+scene's map, a field of another size than the map is ignored
+
+a batch culls the scene's objects against its visibility set for all of its views in one pass, object_views then
+holds a word per object with the bits of the views that see it and object_view_bit is the bit of the view being
+drawn, outside a batch object_view_bit is 0 and the renderer tests the set itself
+
+a renderer made by raycast_renderer_init_memory carves every buffer out of the block it was given and
+never allocates afterwards, only its thread pool is allocated, memory is NULL for other renderers
 */
 typedef struct {
 	uint32_t *pixel_data;
-	double *depth_buffer;
+	raycast_depth_t *depth_buffer;
+	char column_depth;
+	raycast_depth_t *wall_depths;
+	int *wall_starts, *wall_ends;
+	uint32_t *wall_pixels;
+	uint32_t *scaled_pixels;
+	raycast_frame_cache_t *frame_cache;
+	raycast_row_table_t *row_table;
+	const raycast_distance_field_t *distance_field;
+	const uint64_t *object_views;
+	uint64_t object_view_bit;
+	raycast_sprite_t *sprites;
+	uint32_t sprite_count, sprite_capacity;
+	uint32_t sprites_drawn, sprites_culled;
 	uint32_t screen_width, screen_height;
-	double aspect_ratio;
+	raycast_real_t aspect_ratio;
 	char render_top_bottom, render_top, render_bottom, render_walls, render_sprites;
+	uint32_t scale_x, scale_y;
+	char linear_upscale;
+	double target_frame_time, scale_time;
+	uint32_t max_scale, scale_frames;
 	surface_pixel_t surface_pixel;
 	sprite_pixel_t sprite_pixel;
+	surface_span_t surface_span;
+	sprite_span_t sprite_span;
+	uint32_t thread_count;
+	raycast_thread_pool_t *thread_pool;
+	raycast_scratch_t *scratch;
+	raycast_renderer_memory_t *memory;
+	raycast_frame_stats_t stats;
 } raycast_renderer_t;
 
 /*
 the scene is responsible for storing information about
 the geometry of the world, and the objects in the scene
+
+when textures is set, any pass the renderer has no pixel or span function for
+is drawn straight from the atlas without calling the user
+
+when tiled_map is set (see raycast_scene_set_tiled_map), cells are read from it instead of world_map,
+and its floor and ceiling layers, if it has them, are used instead of the atlas' floor_map and ceiling_map
+
+cell_heights can be NULL for flat floors and walls of one height, otherwise it holds one height for every cell
+of the map, in steps of height_scale above bottom_height, every cell is a block up to its height, empty cells
+are floors raised that high and wall cells walls that tall, with 0 meaning wall_height for walls, the ceiling
+stays at top_height, the top of every cell is drawn as floor, the sides of wall cells with their wall textures
+and the steps up to higher empty cells with the textures of wall type 0
+
+with cell heights raycast_render_walls draws whole columns front to back, floors and ceilings included, so
+raycast_render_top_bottom draws nothing, each column stops once it is full, and there is no distance field,
+frame cache reuse of wall hits or transposed target for it, in column depth mode sprites are only hidden by
+the surface that filled a column, not by lower cells in front of them
+
+when lightmap is set, every surface is drawn with the light of its cell and face, atlas texels are darkened by it
+and pixel and span functions are handed it, a lightmap of another size than the map is ignored
+
+when visibility is set, objects standing in cells the camera's cell can't see are culled before they are projected,
+and lightmap bakes skip lights in cells a sample's cell can't see, a set of another size than the map is ignored
 */
 typedef struct {
 	uint8_t *world_map;
+	raycast_tiled_map_t *tiled_map;
 	uint32_t world_width, world_height, object_count;
 	raycast_object_t *objects;
-	double wall_height, top_height, bottom_height;
+	raycast_real_t wall_height, top_height, bottom_height;
+	uint8_t *cell_heights;
+	raycast_real_t height_scale;
+	raycast_texture_atlas_t *textures;
+	const raycast_lightmap_t *lightmap;
+	const raycast_visibility_t *visibility;
 } raycast_scene_t;
 
 /*
@@ -103,25 +371,284 @@ typedef struct {
 	raycast_point_t position;
 	raycast_vector_t direction;
 	raycast_vector_t plane;
-	double height, focal_length, plane_length;
+	raycast_real_t height, focal_length, plane_length;
 	int pitch;
 } raycast_camera_t;
 
+/*
+buckets the objects of a scene by the world cell they stand in, so range queries only visit the cells
+around them instead of every object, each cell keeps a linked list of object indices and objects
+outside the world map share one extra list that every query checks
+
+the index refers to objects by their position in the scene's object array, call raycast_object_index_update
+after moving an object and raycast_object_index_build after the object array or the world size changes,
+queries only read the index so any number of threads can query it at once
+*/
+typedef struct {
+	uint32_t width, height, object_count;
+	int32_t *cell_heads;
+	int32_t *next, *prev, *cells;
+} raycast_object_index_t;
+
+/*
+chessboard distance from every cell of a scene's map to the nearest wall, with the cells around the
+map counted as walls, capped at 255, rays cast through it skip the empty square around their cell in
+one jump instead of stepping through it cell by cell and still stop on the same wall cell and face
+
+build it again after changing the map, a field that no longer matches the map's walls lets rays jump
+through the new ones, a field whose size doesn't match the scene's map is ignored and rays cast through
+it fall back to raycast_DDA, the thread pool is only used by raycast_check_obstructions, so call that
+from one thread at a time, single rays can be cast through the field from any thread
+*/
+struct raycast_distance_field {
+	uint8_t *distances;
+	uint32_t width, height, thread_count;
+	raycast_thread_pool_t *thread_pool;
+};
+
+// first bytes of a tiled map file, chunk data starts at multiples of this so chunks can be paged in and out alone
+#define RAYCAST_TILED_MAP_MAGIC 0x4d544352
+#define RAYCAST_TILED_MAP_VERSION 1
+#ifndef RAYCAST_TILED_MAP_ALIGNMENT
+#define RAYCAST_TILED_MAP_ALIGNMENT 4096
+#endif
+
+// layers a tiled map can store for every cell, walls always come first
+typedef enum {
+	raycast_layer_walls = 0,
+	raycast_layer_floor,
+	raycast_layer_ceiling
+} raycast_layer_t;
+
+/*
+a map stored on disk as square chunks of (1 << chunk_shift) cells a side, the file is a header, an index with
+the file offset of every chunk (row by row), then the chunks, each holding layer_count blocks of cells (walls,
+then floor and ceiling textures), every chunk with only zero cells points at the same empty chunk
+
+the file is memory mapped, so opening it reads nothing but the header and index, and a cell is paged in the
+first time a ray reads it, any number of threads can read cells at once, cache holds the file offsets of up to
+cache_size chunks kept resident, raycast_tiled_map_stream asks the system to load the chunks ahead of a camera
+into it, then drops every other chunk, those that fell out of it and those rays read outside it since the last
+call alike, so between calls only the cache and the chunks read since stay in memory, however big the map is
+*/
+struct raycast_tiled_map {
+	const uint8_t *file;
+	size_t file_size;
+	const uint64_t *chunk_offsets;
+	uint32_t width, height, layer_count;
+	uint32_t chunk_shift, chunks_x, chunks_y;
+	uint64_t *cache;
+	uint32_t *cache_frames;
+	uint32_t cache_size, cache_count, frame;
+};
+
+// a point light, it reaches radius cells and its light fades linearly from intensity (1 is full light) to 0
+typedef struct {
+	raycast_point_t position;
+	raycast_real_t radius, intensity;
+} raycast_light_t;
+
+/*
+light of every face of every cell of a scene's map, 0 - 255, at values[6 * (x + width * y) + face], the wall faces
+(north - west) are the sides of a cell, lit from the cell next to them, and the top and bottom its ceiling and floor
+
+values are baked from ambient light, the point lights in lights and a sun far away in sun_direction from every
+cell with sun_intensity, light only reaches a face it can see, which is found with the same DDA that casts wall rays,
+the sun lights floors and wall faces that see out of the map in its direction, but never ceilings, everything
+adds up and is clamped to 1, with the defaults (ambient 1, no lights, no sun) every value is 255
+
+the lights and the sun are read on every bake, after changing them or the map, rebake only the cells that
+changed with raycast_lightmap_update_light and raycast_lightmap_update_cell, version counts the bakes so
+renderers with a frame cache see the change, the thread pool is used by bakes, so bake from one thread at a time
+*/
+struct raycast_lightmap {
+	uint8_t *values;
+	uint32_t width, height;
+	const raycast_light_t *lights;
+	uint32_t light_count;
+	raycast_real_t ambient;
+	raycast_vector_t sun_direction;
+	raycast_real_t sun_intensity;
+	uint32_t version, thread_count;
+	raycast_thread_pool_t *thread_pool;
+};
+
+/*
+potentially visible set of a scene's map, for every empty cell the cells that a straight line from somewhere in it
+reaches without passing through a wall (lines touching a wall's corner or side count), found exactly by sweeping the
+window of cells around it once per quadrant with a precise permissive field of view, the walls seen are in the set
+too, and so is every cell next to a seen one since the renderer's rays are rounded, cells further than max_distance
+apart (0 for no limit) are never visible and objects further away than it are culled too, the build and the set
+grow with how far every cell sees, so open maps want a max_distance (with none a cell of an open map stores the
+whole map), cells that were walls when it was built see everything
+
+with cell heights only cells whose top reaches top_height block sight, as they fill the column from floor to ceiling,
+lower walls and raised floors are seen over, the set is built and queried with the heights the scene had, so build it
+again after changing them too
+
+each cell's set is stored as a bitset of the map clipped to the rows it sees, and each row to the 32 cell words
+it sees, at data + offsets[x + width * y], as first_y, row_count, then row_count times first_word, word_count and
+the offset of the row's words from the start of the set, then the words, so a lookup reads three words and no more
+
+build it again after changing the map, version counts the builds so renderers with a frame cache see the change,
+the thread pool is used by builds, so build from one thread at a time, it can be queried from any thread
+*/
+struct raycast_visibility {
+	uint32_t *data;
+	uint64_t *offsets;
+	uint32_t width, height;
+	raycast_real_t max_distance;
+	uint32_t version, thread_count;
+	raycast_thread_pool_t *thread_pool;
+};
+
+/*
+a rectangle of a framebuffer drawn from one camera, rows of the framebuffer are stride pixels apart and
+the view covers width x height pixels from (x, y), the camera's plane should match the view's aspect ratio
+*/
+typedef struct {
+	raycast_camera_t *camera;
+	uint32_t *pixel_data;
+	uint32_t stride;
+	uint32_t x, y, width, height;
+} raycast_view_t;
+
+/*
+draws several views of one scene at once, for split screen or several players on a server, each thread
+owns a single threaded renderer sized for the largest view and draws whole views with it, so the depth
+buffer, wall arrays, scratch memory and sprite list of each thread are allocated once and reused by every
+view it draws, view i is drawn by thread i % thread_count
+
+a view that starts at the left edge of a framebuffer as wide as itself is drawn in place, any other view is
+drawn to its thread's part of pixels and copied into its rectangle, settings like the render scale can be
+changed on each of the renderers, views are drawn with whatever settings their thread's renderer has
+
+when the scene has a visibility set, every object is tested once against the set of each distinct camera cell
+of the first 64 views before any view is drawn, split between the threads, and object_views keeps the result, a
+word per object with bit i set if view i sees it, views after the first 64 test the set themselves
+*/
+typedef struct {
+	raycast_renderer_t *renderers;
+	uint32_t *pixels;
+	uint32_t thread_count;
+	raycast_thread_pool_t *thread_pool;
+	uint32_t max_width, max_height;
+	uint64_t *object_views;
+	uint32_t object_capacity;
+} raycast_batch_t;
+
 // utility functions
 void raycast_uint32_to_color(uint32_t, raycast_color_t*);
 uint32_t raycast_color_to_uint32(raycast_color_t*);
 
 
 // init functions
-void raycast_object_init(raycast_object_t*, int id, double x, double y);
+void raycast_object_init(raycast_object_t*, int id, raycast_real_t x, raycast_real_t y);
 void raycast_scene_init(raycast_scene_t*, uint8_t *world_map, uint32_t world_width, uint32_t world_height, raycast_object_t *objects, uint32_t object_count);
-void raycast_camera_init(raycast_camera_t*, raycast_renderer_t*, double x, double y);
+
+// reads the scene's cells from a tiled map instead of world_map and takes its size, NULL goes back to world_map
+void raycast_scene_set_tiled_map(raycast_scene_t*, raycast_tiled_map_t*);
+void raycast_camera_init(raycast_camera_t*, raycast_renderer_t*, raycast_real_t x, raycast_real_t y);
+
+// returns -1 on failure to allocate the atlas or 0 on success
+int raycast_texture_atlas_init(raycast_texture_atlas_t*, uint32_t texel_capacity, uint32_t texture_capacity);
 
 // returns -1 on failure to initialize or 0 on success
 int raycast_renderer_init(raycast_renderer_t*, uint32_t *pixel_data, uint32_t width, uint32_t height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel);
 
+/*
+same as raycast_renderer_init, but every buffer is carved out of memory, which must be aligned to RAYCAST_MEMORY_ALIGNMENT
+and hold raycast_renderer_memory_size bytes for the same size and features, the renderer starts with the features'
+thread count, returns -1 if the block is misaligned or too small or on failure to create the threads, or 0 on success,
+the block has to outlive the renderer and is never freed by it
+*/
+int raycast_renderer_init_memory(raycast_renderer_t*, uint32_t *pixel_data, uint32_t width, uint32_t height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel, const raycast_renderer_features_t*, void *memory, size_t size);
+
+// exact number of bytes raycast_renderer_init_memory needs for a screen size and set of features
+size_t raycast_renderer_memory_size(uint32_t width, uint32_t height, const raycast_renderer_features_t*);
+
+/*
+moves a renderer made by raycast_renderer_init_memory to a new screen size, carving its buffers out of the same block
+again, settings and threads are kept, returns -1 if the renderer has no block or it is too small for the new size,
+in which case nothing changes, or 0 on success
+*/
+int raycast_renderer_resize_memory(raycast_renderer_t*, uint32_t *pixel_data, uint32_t width, uint32_t height);
+
 // de-init functions
 void raycast_renderer_free(raycast_renderer_t*);
+void raycast_texture_atlas_free(raycast_texture_atlas_t*);
+
+// texture functions
+
+/*
+copies a row major width x height texture into the atlas, both sizes must be powers of two
+returns the index of the new texture or -1 if it doesn't fit or the size is invalid
+*/
+int raycast_texture_atlas_add(raycast_texture_atlas_t*, const uint32_t *texels, uint32_t width, uint32_t height);
+
+// sets the texture drawn on one face (north - west) of a wall type, -1 to draw nothing
+void raycast_texture_atlas_set_wall(raycast_texture_atlas_t*, uint8_t wall_type, raycast_face_t face, int texture);
+
+/*
+replaces the renderers worker pool with one of thread_count threads (0 is treated as 1),
+returns -1 on failure to create the threads or 0 on success, on failure the renderer falls back to 1 thread
+*/
+int raycast_renderer_set_thread_count(raycast_renderer_t*, uint32_t thread_count);
+
+/*
+turns column depth mode on (enabled = 1) or off, turning it on frees the depth buffer and turning it off allocates it again,
+returns -1 on failure to allocate the depth buffer, in which case the renderer stays in column depth mode, or 0 on success
+*/
+int raycast_renderer_set_column_depth(raycast_renderer_t*, char enabled);
+
+/*
+turns transposed walls on (enabled = 1) or off, turning them on allocates wall_pixels and turning them off frees it,
+returns -1 on failure to allocate, in which case walls stay drawn straight to the screen, or 0 on success
+*/
+int raycast_renderer_set_transposed_walls(raycast_renderer_t*, char enabled);
+
+/*
+turns the frame cache on (enabled = 1) or off, returns -1 on failure to allocate it or 0 on success
+
+with the cache on the renderer keeps the wall hit of every column, while the camera's position, direction,
+plane and focal length stay the same the hits are reused and only the walls, floors and ceilings are drawn
+again (so changing only pitch or height never casts a ray), and while the camera, the scene's objects,
+heights and texture settings and the renderer's settings all stay the same raycast_render leaves the last
+frame in pixel_data as it is and returns straight away
+
+the cache can't see changes to the map itself, call raycast_renderer_invalidate_cell after changing a cell of
+world_map and raycast_renderer_invalidate after changing atlas texels, the floor / ceiling maps, or anything
+pixel or span functions draw, neither can be called while the renderer is drawing
+*/
+int raycast_renderer_set_frame_cache(raycast_renderer_t*, char enabled);
+
+// recasts every column and redraws the whole frame on the next raycast_render
+void raycast_renderer_invalidate(raycast_renderer_t*);
+
+// recasts the columns whose last wall ray passed through or stopped on cell (x, y) of the map
+void raycast_renderer_invalidate_cell(raycast_renderer_t*, uint32_t x, uint32_t y);
+
+/*
+sets how many columns share a wall ray (scale_x) and how many rows share a floor / ceiling row (scale_y), 1 and 1
+draws every pixel, a scale above 1 allocates scaled_pixels and going back to 1 and 1 frees it, returns -1 if either
+scale is 0 or on failure to allocate, in which case the scale stays as it was, or 0 on success
+*/
+int raycast_renderer_set_render_scale(raycast_renderer_t*, uint32_t scale_x, uint32_t scale_y);
+
+// upscales scaled frames by blending the four nearest pixels (enabled = 1) instead of copying the nearest one
+void raycast_renderer_set_linear_upscale(raycast_renderer_t*, char enabled);
+
+/*
+lets raycast_render raise or lower the render scale (up to max_scale on each axis) every RAYCAST_SCALE_FRAMES frames
+it draws so a frame takes about frame_time seconds, 0 turns this off and leaves the scale where it is
+*/
+void raycast_renderer_set_target_frame_time(raycast_renderer_t*, double frame_time, uint32_t max_scale);
+
+// sets the span functions, either can be NULL to go back to the pixel function
+void raycast_renderer_set_span_functions(raycast_renderer_t*, surface_span_t surface_span, sprite_span_t sprite_span);
+
+// casts wall rays through a distance field of the scene's map, NULL goes back to plain DDA
+void raycast_renderer_set_distance_field(raycast_renderer_t*, const raycast_distance_field_t*);
 
 
 // camera movement functions
@@ -131,9 +658,9 @@ user cannot directly manipulate the direction
 attribute of the camera because camera plane must be perpendicular
 to camera direction at all times, hence why these functions exist
 */
-void raycast_camera_set_dir(raycast_camera_t*, double x, double y);
-void raycast_camera_rotate(raycast_camera_t*, double angle);
-void raycast_camera_set_rotation(raycast_camera_t*, double angle);
+void raycast_camera_set_dir(raycast_camera_t*, raycast_real_t x, raycast_real_t y);
+void raycast_camera_rotate(raycast_camera_t*, raycast_real_t angle);
+void raycast_camera_set_rotation(raycast_camera_t*, raycast_real_t angle);
 
 // cast ray functions
 
@@ -142,27 +669,207 @@ only used internally by the render engine and other cast ray functions, faster b
 by the camera, and it doesn't calculate the true euclidean distance traveled by the ray
 uses hit_info in first parameter to return information about where the ray hit
 */
-void raycast_DDA(raycast_hit_info_t*, raycast_scene_t*, double pos_x, double pos_y, double dir_x, double dir_y, double initial_ray_length);
+void raycast_DDA(raycast_hit_info_t*, raycast_scene_t*, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t initial_ray_length);
+
+// number of rays the packet DDA walks together, walls are cast this many columns at a time
+#ifndef RAYCAST_PACKET_SIZE
+#define RAYCAST_PACKET_SIZE 8
+#endif
+
+/*
+casts count rays from the same position, like calling raycast_DDA once per direction and with
+identical results, but the rays are walked through the grid in packets of RAYCAST_PACKET_SIZE,
+on x86 the double and float builds step a packet in SSE2 or AVX2 lanes (AVX2 gathers the map cells),
+fixed point and RAYCAST_NO_SIMD builds move the rays of a packet one at a time in lock step
+hit_info must hold count entries, one per direction
+*/
+void raycast_DDA_packet(raycast_hit_info_t*, raycast_scene_t*, raycast_real_t pos_x, raycast_real_t pos_y, const raycast_vector_t *directions, raycast_real_t initial_ray_length, uint32_t count);
 
 /*
 cast ray function intended for the user to use, slower than the previous
 function but it gives more practical information, information returned regarding
 where the ray hit is stored in the hit_info struct
 */
-void raycast_cast_ray(raycast_hit_info_t*, raycast_scene_t*, double pos_x, double pos_y, double dir_x, double dir_y);
+void raycast_cast_ray(raycast_hit_info_t*, raycast_scene_t*, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y);
+
+// bulk version of raycast_cast_ray, casts count arbitrary rays in packets, filling one hit_info per ray
+void raycast_cast_rays(raycast_hit_info_t*, raycast_scene_t*, const raycast_point_t *positions, const raycast_vector_t *directions, uint32_t count);
 
 /*
 casts a ray from one point to another, returns 1 if there
-is an obstruction, and 0 if there is no obstruction
+is an obstruction, and 0 if there is no obstruction,
+the ray stops at the end point, so the cost grows with the
+distance between the points and not the distance to a wall
+*/
+int raycast_check_obstruction(raycast_scene_t*, raycast_real_t start_x, raycast_real_t start_y, raycast_real_t end_x, raycast_real_t end_y);
+
+// distance field functions
+
+// returns -1 on failure to allocate the field or 0 on success, the field starts out single threaded
+int raycast_distance_field_init(raycast_distance_field_t*, raycast_scene_t*);
+void raycast_distance_field_free(raycast_distance_field_t*);
+
+// recomputes the field from the scene's map, returns -1 on failure to allocate or 0 on success
+int raycast_distance_field_build(raycast_distance_field_t*, raycast_scene_t*);
+
+// same as raycast_renderer_set_thread_count, used to split batches of obstruction checks
+int raycast_distance_field_set_thread_count(raycast_distance_field_t*, uint32_t thread_count);
+
+/*
+same as raycast_DDA and raycast_cast_ray, but empty space is skipped using the distance field, a jump never
+passes a wall so the hit cell, face and wall type match raycast_DDA, skipped steps are added up in one multiply
+instead of one add per cell though, so the distance can differ in the last bits, and with RAYCAST_PRECISION_FLOAT
+a long ray passing close to a cell corner can end in the neighbour of the cell raycast_DDA's rounding drifts into,
+with RAYCAST_PRECISION_FIXED the results are identical
+*/
+void raycast_DDA_field(raycast_hit_info_t*, raycast_scene_t*, const raycast_distance_field_t*, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t initial_ray_length);
+void raycast_cast_ray_field(raycast_hit_info_t*, raycast_scene_t*, const raycast_distance_field_t*, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y);
+
+/*
+runs raycast_check_obstruction for every pair of starts[i] and ends[i] through the distance field,
+writing 1 to obstructed[i] if there is an obstruction and 0 otherwise, split over the field's threads
 */
-int raycast_check_obstruction(raycast_scene_t*, double start_x, double start_y, double end_x, double end_y);
+void raycast_check_obstructions(raycast_distance_field_t*, raycast_scene_t*, const raycast_point_t *starts, const raycast_point_t *ends, uint8_t *obstructed, uint32_t count);
 
-// render functions
+// tiled map functions
+
+/*
+writes a width x height map to a tiled map file with chunks of (1 << chunk_shift) cells a side, floor_map and
+ceiling_map can be NULL, layers after the last one given are left out of the file, returns -1 if chunk_shift is
+0 or over 12 or on failure to write the file or 0 on success
+*/
+int raycast_tiled_map_write(const char *path, const uint8_t *world_map, const uint8_t *floor_map, const uint8_t *ceiling_map, uint32_t width, uint32_t height, uint32_t chunk_shift);
+
+/*
+maps a tiled map file without reading its chunks, cache_size is how many chunks raycast_tiled_map_stream
+keeps resident, returns -1 if the file can't be mapped or isn't a valid tiled map, or on failure to allocate
+the cache, or 0 on success
+*/
+int raycast_tiled_map_open(raycast_tiled_map_t*, const char *path, uint32_t cache_size);
+void raycast_tiled_map_close(raycast_tiled_map_t*);
+
+// one cell of a layer, 0 for cells outside the map or layers the file doesn't have
+uint8_t raycast_tiled_map_cell(const raycast_tiled_map_t*, raycast_layer_t layer, uint32_t x, uint32_t y);
+
+/*
+call once a frame before drawing from camera, keeps the chunks around the camera and in its view up to
+distance cells away resident, nearest first, loading the ones that weren't in the background and dropping
+those that haven't been in view for the longest when the cache is full, then drops every chunk outside the
+cache, only call it from one thread at a time, it can run while other threads read the map
+*/
+void raycast_tiled_map_stream(raycast_tiled_map_t*, raycast_camera_t*, raycast_real_t distance);
+
+// lightmap functions
+
+// returns -1 on failure to allocate the lightmap or 0 on success, the lightmap starts out fully lit and single threaded
+int raycast_lightmap_init(raycast_lightmap_t*, raycast_scene_t*);
+void raycast_lightmap_free(raycast_lightmap_t*);
+
+// same as raycast_renderer_set_thread_count, used to split bakes into row bands
+int raycast_lightmap_set_thread_count(raycast_lightmap_t*, uint32_t thread_count);
+
+// bakes every cell, resizing the lightmap to the scene's map first, returns -1 on failure to allocate or 0 on success
+int raycast_lightmap_bake(raycast_lightmap_t*, raycast_scene_t*);
+
+// bakes the cells from (min_x, min_y) to (max_x, max_y), both included, the rectangle is clipped to the map
+void raycast_lightmap_bake_rect(raycast_lightmap_t*, raycast_scene_t*, int min_x, int min_y, int max_x, int max_y);
+
+/*
+rebakes the cells a light reached before it changed and the ones it reaches after, pass NULL as before for a light that
+was added and as after for one that was removed, the lights array should already hold the light as it is after
+*/
+void raycast_lightmap_update_light(raycast_lightmap_t*, raycast_scene_t*, const raycast_light_t *before, const raycast_light_t *after);
+
+// rebakes the faces around a cell of the map that changed, the cells every light reaching it lights and its shadow from the sun
+void raycast_lightmap_update_cell(raycast_lightmap_t*, raycast_scene_t*, uint32_t x, uint32_t y);
+
+// visibility functions
+
+// sets up an empty set with no max_distance, a set that isn't built sees everything
+void raycast_visibility_init(raycast_visibility_t*);
+void raycast_visibility_free(raycast_visibility_t*);
+
+// same as raycast_renderer_set_thread_count, used to split builds into row bands
+int raycast_visibility_set_thread_count(raycast_visibility_t*, uint32_t thread_count);
+
+// builds the set from the scene's map, returns -1 on failure to allocate, in which case the set is left empty, or 0 on success
+int raycast_visibility_build(raycast_visibility_t*, raycast_scene_t*);
+
+/*
+returns 0 if the cell of (to_x, to_y) can't be seen from the cell of (from_x, from_y) and 1 if it might be,
+points off the map, cells that blocked sight when the set was built and sets that aren't built give 1 for anything
+*/
+int raycast_visibility_query(const raycast_visibility_t*, raycast_real_t from_x, raycast_real_t from_y, raycast_real_t to_x, raycast_real_t to_y);
+
+/*
+writes the index of every point in points that might be seen from (x, y) to results, in order, and returns
+how many there are, results must have room for count indexes, for culling lights or objects before a frame
+*/
+uint32_t raycast_visibility_filter(const raycast_visibility_t*, raycast_real_t x, raycast_real_t y, const raycast_point_t* points, uint32_t count, uint32_t* results);
+
+// object index functions
+
+// returns -1 on failure to allocate the index or 0 on success
+int raycast_object_index_init(raycast_object_index_t*, raycast_scene_t*);
+void raycast_object_index_free(raycast_object_index_t*);
+
+/*
+re-buckets every object of the scene, growing the index if the scene has more objects or cells than before,
+returns -1 on failure to allocate, in which case the index is left empty, or 0 on success
+*/
+int raycast_object_index_build(raycast_object_index_t*, raycast_scene_t*);
+
+// moves one object to the bucket of its current position, cheap when it stays in the same cell
+void raycast_object_index_update(raycast_object_index_t*, raycast_scene_t*, uint32_t object);
+
+/*
+query functions write the indices of matching objects to results, in no particular order, and return how many
+objects matched, only the first max_results of them are written, objects are treated as points at their position
+*/
+uint32_t raycast_object_index_query_radius(raycast_object_index_t*, raycast_scene_t*, raycast_real_t x, raycast_real_t y, raycast_real_t radius, uint32_t *results, uint32_t max_results);
+uint32_t raycast_object_index_query_rect(raycast_object_index_t*, raycast_scene_t*, raycast_real_t min_x, raycast_real_t min_y, raycast_real_t max_x, raycast_real_t max_y, uint32_t *results, uint32_t max_results);
+
+// objects within range whose direction from (x, y) is at most half_angle radians away from (dir_x, dir_y)
+uint32_t raycast_object_index_query_cone(raycast_object_index_t*, raycast_scene_t*, raycast_real_t x, raycast_real_t y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t half_angle, raycast_real_t range, uint32_t *results, uint32_t max_results);
+
+// objects within radius that raycast_check_obstruction finds no wall in front of
+uint32_t raycast_object_index_query_visible(raycast_object_index_t*, raycast_scene_t*, raycast_real_t x, raycast_real_t y, raycast_real_t radius, uint32_t *results, uint32_t max_results);
+
+// returns the index of the nearest object within max_distance of (x, y), or -1 if there is none
+int raycast_object_index_nearest(raycast_object_index_t*, raycast_scene_t*, raycast_real_t x, raycast_real_t y, raycast_real_t max_distance);
+
+/*
+render functions, walls are drawn first and record the rows and depth of every column, then floors and ceilings
+write the depth of every pixel row by row from those, with render_top_bottom off too, so the depth buffer never
+needs clearing and raycast_render_top_bottom has to run before raycast_render_sprites
+
+on x86 floor and ceiling rows drawn from the atlas go through SSE2 or AVX2 kernels, per cell textures, tiled map
+layers and lightmaps included, rows drawn with a pixel function stay scalar, they step the real world position
+pixel by pixel and pass it on as is, which per lane math would round differently
+*/
 void raycast_render_walls(raycast_renderer_t*, raycast_scene_t*, raycast_camera_t*);
 void raycast_render_top_bottom(raycast_renderer_t*, raycast_scene_t*, raycast_camera_t*);
 void raycast_render_sprites(raycast_renderer_t*, raycast_scene_t*, raycast_camera_t*);
 
-// runs all three previous render function to draw a complete world
+// runs all three previous render function to draw a complete world, only this one applies the render scale
 void raycast_render(raycast_renderer_t*, raycast_scene_t*, raycast_camera_t*);
 
-#endif
\ No newline at end of file
+// batch functions
+
+/*
+views can be up to max_width x max_height pixels, the pixel functions are shared by every thread's renderer
+so they must be thread safe when thread_count is greater than 1, returns -1 on failure to allocate or 0 on success
+*/
+int raycast_batch_init(raycast_batch_t*, uint32_t max_width, uint32_t max_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel, uint32_t thread_count);
+void raycast_batch_free(raycast_batch_t*);
+
+// sets the distance field of every thread's renderer, one field is shared by all of them
+void raycast_batch_set_distance_field(raycast_batch_t*, const raycast_distance_field_t*);
+
+/*
+draws every view of the scene, split between the batch's threads, returns -1 without drawing anything
+if a view is bigger than the batch or has no camera or framebuffer or on failure to allocate, or 0 on success
+*/
+int raycast_batch_render(raycast_batch_t*, raycast_scene_t*, raycast_view_t*, uint32_t view_count);
+
+#endif
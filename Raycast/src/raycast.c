@@ -1,9 +1,335 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "raycast.h"
 
+// x86 builds also get SSE2 and AVX2 kernels picked at runtime, define RAYCAST_NO_SIMD to only build the scalar ones
+#if !defined(RAYCAST_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYCAST_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// math functions that match raycast_real_t, so float builds never round trip through double
+#if defined(RAYCAST_PRECISION_FLOAT) || defined(RAYCAST_PRECISION_FIXED)
+#define raycast_sqrt sqrtf
+#define raycast_fabs fabsf
+#define raycast_floor floorf
+#define raycast_sin sinf
+#define raycast_cos cosf
+#else
+#define raycast_sqrt sqrt
+#define raycast_fabs fabs
+#define raycast_floor floor
+#define raycast_sin sin
+#define raycast_cos cos
+#endif
+
+/*
+the value the depth buffer is cleared to, for integer formats every distance is clamped to one less
+so far away surfaces (the horizon row, rays that left the map) still pass the depth test
+*/
+#ifdef RAYCAST_PRECISION_FIXED
+#define RAYCAST_FIXED_ONE 65536
+#endif
+
+#if defined(RAYCAST_DEPTH_16)
+#define RAYCAST_DEPTH_INT16
+#define RAYCAST_DEPTH_CLEAR INT16_MAX
+#define RAYCAST_DEPTH_ONE 64
+#elif defined(RAYCAST_PRECISION_FIXED)
+#define RAYCAST_DEPTH_INT32
+#define RAYCAST_DEPTH_CLEAR INT32_MAX
+#define RAYCAST_DEPTH_ONE 65536
+#elif defined(RAYCAST_PRECISION_FLOAT) || defined(RAYCAST_DEPTH_32)
+#define RAYCAST_DEPTH_FLOAT
+#define RAYCAST_DEPTH_CLEAR INFINITY
+#else
+#define RAYCAST_DEPTH_DOUBLE
+#define RAYCAST_DEPTH_CLEAR INFINITY
+#endif
+
+// converts a distance to the depth buffer's format, done once per column / row / sprite instead of per pixel
+static inline raycast_depth_t raycast_to_depth(raycast_real_t distance) {
+#ifdef RAYCAST_DEPTH_ONE
+	if (!(distance < (raycast_real_t)(RAYCAST_DEPTH_CLEAR - 1) / RAYCAST_DEPTH_ONE)) return RAYCAST_DEPTH_CLEAR - 1;
+	return (raycast_depth_t)(distance * RAYCAST_DEPTH_ONE);
+#else
+	return distance;
+#endif
+}
+
+/*
+type the DDA steps its side distances in, 64 bit 16.16 fixed point in fixed mode so the loop is
+integer only, step lengths are clamped far below the limit so long rays can't overflow
+*/
+#ifdef RAYCAST_PRECISION_FIXED
+typedef int64_t raycast_dda_t;
+
+static inline raycast_dda_t raycast_to_dda(raycast_real_t value) {
+	if (value > (1 << 30)) return (raycast_dda_t)1 << 46;
+	return (raycast_dda_t)(value * RAYCAST_FIXED_ONE);
+}
+
+#define raycast_from_dda(value) ((raycast_real_t)(value) / RAYCAST_FIXED_ONE)
+#else
+typedef raycast_real_t raycast_dda_t;
+
+#define raycast_to_dda(value) (value)
+#define raycast_from_dda(value) (value)
+#endif
+
+/*
+a task is run once for every band in [0, band_count), bands are handed out
+statically so band i always runs on thread i % thread_count
+*/
+typedef void (*raycast_task_t)(void *data, uint32_t band, uint32_t band_count);
+
+struct raycast_thread_pool {
+	pthread_t *workers;
+	uint32_t thread_count;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_ready, work_done;
+
+	raycast_task_t task;
+	void *data;
+	uint32_t band_count;
+
+	// bumped every time new work is posted, workers compare against the last generation they ran
+	uint32_t generation;
+	uint32_t busy_workers;
+	char quit;
+};
+
+typedef struct {
+	raycast_thread_pool_t *pool;
+	uint32_t index;
+} raycast_worker_arg_t;
+
+/*
+a sprite that is at least partly visible this frame, projected once by
+raycast_render_sprites and then drawn by every band that its rows fall in
+*/
+struct raycast_sprite {
+	raycast_object_t *object;
+	const raycast_texture_t *texture;
+	raycast_real_t distance, step, step_x, percent_x;
+	raycast_depth_t depth;
+	int top, left;
+	int draw_start_x, draw_end_x, draw_start_y, draw_end_y;
+};
+
+/*
+wall hits of every column from the last frame, kept when the renderer's frame cache is on, hits are
+reused while the camera casts the same rays and columns are only recast once marked dirty, the frame
+left in pixel_data is reused whole while nothing it was drawn from has changed
+*/
+struct raycast_frame_cache {
+	raycast_hit_info_t *hits;
+	uint8_t *dirty;
+
+	// what the hits were cast with, hit_width is the width of the frame they were cast for
+	raycast_camera_t hit_camera;
+	uint32_t hit_width;
+	const uint8_t *world_map;
+	const raycast_tiled_map_t *tiled_map;
+	uint32_t world_width, world_height;
+
+	// what the frame in pixel_data was drawn with
+	char frame_valid;
+	raycast_camera_t frame_camera;
+	const raycast_scene_t *frame_scene;
+	uint64_t frame_hash;
+};
+
+// see raycast_update_row_table, the arrays have one entry per row of the screen
+struct raycast_row_table {
+	raycast_real_t *distances;
+	raycast_depth_t *depths;
+
+	// what the table was built for
+	char valid;
+	int height, pitch;
+	raycast_real_t camera_height, top_height, bottom_height;
+};
+
+/*
+arrays a band fills in while building spans, each one
+holds as many entries as the longer side of the screen
+*/
+struct raycast_scratch {
+	void *block;
+	int *map_x, *map_y;
+	raycast_real_t *unit_x, *unit_y, *depth;
+	uint32_t **pixels;
+	uint32_t *locations;
+	uint8_t *light;
+#ifdef RAYCAST_PROFILE
+	// counters of the band using this scratch, summed into the renderer's stats after the frame
+	raycast_frame_stats_t stats;
+#endif
+};
+
+/*
+buffers carved out of the block given to raycast_renderer_init_memory, the renderer points at the optional ones
+while their feature is on, so turning a feature off and on again never allocates
+*/
+struct raycast_renderer_memory {
+	raycast_renderer_features_t features;
+	size_t size;
+	raycast_depth_t *depth_buffer, *wall_depths;
+	int *wall_starts, *wall_ends;
+	uint32_t *wall_pixels, *scaled_pixels;
+	raycast_frame_cache_t *frame_cache;
+	raycast_row_table_t *row_table;
+	raycast_sprite_t *sprites;
+	raycast_scratch_t *scratch;
+};
+
+// a block being carved up, with no base only the bytes are counted
+typedef struct {
+	char *base;
+	size_t used;
+} raycast_arena_t;
+
+// adds to a counter of a band's stats, nothing is evaluated unless the library is built with RAYCAST_PROFILE
+#ifdef RAYCAST_PROFILE
+#define RAYCAST_PROFILE_ADD(scratch, counter, amount) ((scratch)->stats.counter += (amount))
+#else
+#define RAYCAST_PROFILE_ADD(scratch, counter, amount) ((void)0)
+#endif
+
+// thread pool functions
+
+static void raycast_thread_pool_run_bands(raycast_thread_pool_t* pool, uint32_t index) {
+	for (uint32_t band = index; band < pool->band_count; band += pool->thread_count) {
+		pool->task(pool->data, band, pool->band_count);
+	}
+}
+
+static void* raycast_worker_main(void* arg) {
+	raycast_worker_arg_t worker = *(raycast_worker_arg_t *)arg;
+	raycast_thread_pool_t *pool = worker.pool;
+	free(arg);
+
+	uint32_t seen_generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		while (!pool->quit && pool->generation == seen_generation) {
+			pthread_cond_wait(&pool->work_ready, &pool->mutex);
+		}
+		if (pool->quit) break;
+
+		seen_generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		raycast_thread_pool_run_bands(pool, worker.index);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy_workers == 0) {
+			pthread_cond_signal(&pool->work_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void raycast_thread_pool_free(raycast_thread_pool_t* pool) {
+	if (pool == NULL) return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->mutex);
+
+	// worker 0 is the calling thread, it is never spawned
+	for (uint32_t i = 1; i < pool->thread_count; i++) {
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->work_ready);
+	pthread_cond_destroy(&pool->work_done);
+	free(pool->workers);
+	free(pool);
+}
+
+// returns NULL on failure
+static raycast_thread_pool_t* raycast_thread_pool_create(uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	raycast_thread_pool_t *pool = (raycast_thread_pool_t *) calloc(1, sizeof(raycast_thread_pool_t));
+	if (pool == NULL) return NULL;
+
+	pool->workers = (pthread_t *) malloc(thread_count * sizeof(pthread_t));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+
+	// count up as threads start so a failure part way through only joins the threads that exist
+	pool->thread_count = 1;
+
+	for (uint32_t i = 1; i < thread_count; i++) {
+		raycast_worker_arg_t *arg = (raycast_worker_arg_t *) malloc(sizeof(raycast_worker_arg_t));
+		if (arg == NULL) {
+			raycast_thread_pool_free(pool);
+			return NULL;
+		}
+		arg->pool = pool;
+		arg->index = i;
+
+		if (pthread_create(pool->workers + i, NULL, raycast_worker_main, arg) != 0) {
+			free(arg);
+			raycast_thread_pool_free(pool);
+			return NULL;
+		}
+		pool->thread_count++;
+	}
+
+	return pool;
+}
+
+// runs task over every band, splitting the bands between the pool's threads, returns once all bands are done
+static void raycast_thread_pool_run(raycast_thread_pool_t* pool, raycast_task_t task, void* data, uint32_t band_count) {
+	if (pool == NULL || pool->thread_count == 1 || band_count <= 1) {
+		for (uint32_t band = 0; band < band_count; band++) {
+			task(data, band, band_count);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->data = data;
+	pool->band_count = band_count;
+	pool->busy_workers = pool->thread_count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->mutex);
+
+	raycast_thread_pool_run_bands(pool, 0);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy_workers != 0) {
+		pthread_cond_wait(&pool->work_done, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
 // utility functions
 void raycast_uint32_to_color(uint32_t num, raycast_color_t* color) {
 	color->r = (num & 0xFF000000) >> 24;
@@ -18,16 +344,19 @@ uint32_t raycast_color_to_uint32(raycast_color_t* color) {
 
 // init functions
 
-void raycast_object_init(raycast_object_t* object, int id, double x, double y) {
+void raycast_object_init(raycast_object_t* object, int id, raycast_real_t x, raycast_real_t y) {
 	object->id = id;
 	object->position.x = x;
 	object->position.y = y;
 	object->size = 1;
 	object->height = 0;
+	object->texture = -1;
+	object->translucent = 0;
 }
 
 void raycast_scene_init(raycast_scene_t* scene, uint8_t *world_map, uint32_t world_width, uint32_t world_height, raycast_object_t *objects, uint32_t object_count) {
 	scene->world_map = world_map;
+	scene->tiled_map = NULL;
 	scene->world_width = world_width;
 	scene->world_height = world_height;
 
@@ -37,9 +366,52 @@ void raycast_scene_init(raycast_scene_t* scene, uint8_t *world_map, uint32_t wor
 	scene->wall_height = 1;
 	scene->top_height = 1;
 	scene->bottom_height = 0;
+
+	scene->cell_heights = NULL;
+	scene->height_scale = (raycast_real_t)1 / 16;
+
+	scene->textures = NULL;
+	scene->lightmap = NULL;
+	scene->visibility = NULL;
+}
+
+void raycast_scene_set_tiled_map(raycast_scene_t* scene, raycast_tiled_map_t* map) {
+	scene->tiled_map = map;
+
+	if (map != NULL) {
+		scene->world_width = map->width;
+		scene->world_height = map->height;
+	}
+}
+
+int raycast_texture_atlas_init(raycast_texture_atlas_t* atlas, uint32_t texel_capacity, uint32_t texture_capacity) {
+	atlas->texels = (uint32_t *) malloc(texel_capacity * sizeof(uint32_t));
+	atlas->textures = (raycast_texture_t *) malloc(texture_capacity * sizeof(raycast_texture_t));
+
+	if (atlas->texels == NULL || atlas->textures == NULL) {
+		raycast_texture_atlas_free(atlas);
+		return -1;
+	}
+
+	atlas->texel_count = 0;
+	atlas->texel_capacity = texel_capacity;
+	atlas->texture_count = 0;
+	atlas->texture_capacity = texture_capacity;
+
+	for (int i = 0; i < 256; i++) {
+		for (int face = 0; face < 4; face++) {
+			atlas->wall_textures[i][face] = -1;
+		}
+	}
+
+	atlas->floor_map = NULL;
+	atlas->ceiling_map = NULL;
+	atlas->floor_texture = -1;
+	atlas->ceiling_texture = -1;
+	return 0;
 }
 
-void raycast_camera_init(raycast_camera_t* camera, raycast_renderer_t *renderer, double x, double y) {
+void raycast_camera_init(raycast_camera_t* camera, raycast_renderer_t *renderer, raycast_real_t x, raycast_real_t y) {
 	camera->position.x = x;
 	camera->position.y = y;
 
@@ -55,17 +427,23 @@ void raycast_camera_init(raycast_camera_t* camera, raycast_renderer_t *renderer,
 	camera->focal_length = 1;
 }
 
-int raycast_renderer_init(raycast_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel) {
+// no walls until the first frame is drawn
+static void raycast_clear_walls(raycast_renderer_t* renderer) {
+	for (uint32_t x = 0; x < renderer->screen_width; x++) {
+		renderer->wall_depths[x] = RAYCAST_DEPTH_CLEAR;
+		renderer->wall_starts[x] = 0;
+		renderer->wall_ends[x] = 0;
+	}
+}
+
+// the settings every renderer starts with, no buffers are set yet
+static void raycast_renderer_defaults(raycast_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel) {
 	renderer->pixel_data = pixel_data;
 	renderer->screen_width = screen_width;
 	renderer->screen_height = screen_height;
-	renderer->aspect_ratio = (double) screen_width / screen_height;
-
-	renderer->depth_buffer = (double *) malloc(screen_width * screen_height * sizeof(double));
+	renderer->aspect_ratio = (raycast_real_t) screen_width / screen_height;
 
-	if (renderer->depth_buffer == NULL) {
-		return -1;
-	}
+	renderer->column_depth = 0;
 
 	renderer->render_top_bottom = 1;
 	renderer->render_top = 1;
@@ -73,428 +451,5409 @@ int raycast_renderer_init(raycast_renderer_t* renderer, uint32_t *pixel_data, ui
 	renderer->render_walls = 1;
 	renderer->render_sprites = 1;
 
+	renderer->scale_x = 1;
+	renderer->scale_y = 1;
+	renderer->linear_upscale = 0;
+	renderer->target_frame_time = 0;
+	renderer->scale_time = 0;
+	renderer->max_scale = 1;
+	renderer->scale_frames = 0;
+
 	renderer->surface_pixel = surface_pixel;
 	renderer->sprite_pixel = sprite_pixel;
-	return 0;
-}
-
-// de-init functions
-
-void raycast_renderer_free(raycast_renderer_t* renderer) {
-	free(renderer->depth_buffer);
-}
-
-// camera movement functions
-
-void raycast_camera_set_dir(raycast_camera_t* camera, double x, double y) {
-	double length = sqrt(x * x + y * y);
-	if (length == 0) return;
-	camera->direction.x = x / length;
-	camera->direction.y = y / length;
 
-	camera->plane.x = -(camera->direction.y) * camera->plane_length;
-	camera->plane.y = camera->direction.x * camera->plane_length;
-}
+	renderer->surface_span = NULL;
+	renderer->sprite_span = NULL;
 
-void raycast_camera_rotate(raycast_camera_t* camera, double angle) {
-	double i_x = cos(angle);
-	double i_y = sin(angle);
-	double j_x = -i_y;
-	double j_y = i_x;
+	renderer->depth_buffer = NULL;
+	renderer->wall_depths = NULL;
+	renderer->wall_starts = NULL;
+	renderer->wall_ends = NULL;
+	renderer->row_table = NULL;
+	renderer->wall_pixels = NULL;
+	renderer->scaled_pixels = NULL;
+	renderer->frame_cache = NULL;
+	renderer->distance_field = NULL;
+	renderer->object_views = NULL;
+	renderer->object_view_bit = 0;
 
-	double x = camera->direction.x;
-	double y = camera->direction.y;
+	renderer->sprites = NULL;
+	renderer->sprite_count = 0;
+	renderer->sprite_capacity = 0;
+	renderer->sprites_drawn = 0;
+	renderer->sprites_culled = 0;
 
-	camera->direction.x = x * i_x + y * j_x;
-	camera->direction.y = x * i_y + y * j_y;
+	renderer->thread_count = 0;
+	renderer->thread_pool = NULL;
+	renderer->scratch = NULL;
+	renderer->memory = NULL;
 
-	camera->plane.x = -(camera->direction.y) * camera->plane_length;
-	camera->plane.y = camera->direction.x * camera->plane_length;
+	memset(&renderer->stats, 0, sizeof(raycast_frame_stats_t));
 }
 
-void raycast_camera_set_rotation(raycast_camera_t* camera, double angle) {
-	camera->direction.x = cos(angle);
-	camera->direction.y = sin(angle);
-
-	camera->plane.x = -(camera->direction.y) * camera->plane_length;
-	camera->plane.y = camera->direction.x * camera->plane_length;
-}
+int raycast_renderer_init(raycast_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel) {
+	raycast_renderer_defaults(renderer, pixel_data, screen_width, screen_height, surface_pixel, sprite_pixel);
 
-// cast ray functions
+	renderer->depth_buffer = (raycast_depth_t *) malloc(screen_width * screen_height * sizeof(raycast_depth_t));
 
-void raycast_DDA(raycast_hit_info_t* hit_info, raycast_scene_t* scene, double pos_x, double pos_y, double dir_x, double dir_y, double initial_ray_length) {
-	int map_x = (int)pos_x;
-	int map_y = (int)pos_y;
+	renderer->wall_depths = (raycast_depth_t *) malloc(screen_width * sizeof(raycast_depth_t));
+	renderer->wall_starts = (int *) malloc(screen_width * sizeof(int));
+	renderer->wall_ends = (int *) malloc(screen_width * sizeof(int));
 
-	double side_dist_x;
-	double side_dist_y;
+	// one block for the table and both of its arrays
+	renderer->row_table = (raycast_row_table_t *) malloc(sizeof(raycast_row_table_t) + screen_height * (sizeof(raycast_real_t) + sizeof(raycast_depth_t)));
 
-	int step_x;
-	int step_y;
+	if (renderer->depth_buffer == NULL || renderer->wall_depths == NULL || renderer->wall_starts == NULL || renderer->wall_ends == NULL || renderer->row_table == NULL) {
+		free(renderer->depth_buffer);
+		free(renderer->wall_depths);
+		free(renderer->wall_starts);
+		free(renderer->wall_ends);
+		free(renderer->row_table);
+		return -1;
+	}
 
-	double delta_dist_x = dir_x == 0 ? 1e30 : fabs(initial_ray_length / dir_x);
-	double delta_dist_y = dir_y == 0 ? 1e30 : fabs(initial_ray_length / dir_y);
+	renderer->row_table->distances = (raycast_real_t *)(renderer->row_table + 1);
+	renderer->row_table->depths = (raycast_depth_t *)(renderer->row_table->distances + screen_height);
+	renderer->row_table->valid = 0;
 
-	uint8_t hit = 0;
-	uint8_t side = 0;
+	raycast_clear_walls(renderer);
 
-	// DDA setup step directions and initial side distances
-	if (dir_x < 0) {
-		step_x = -1;
-		side_dist_x = (pos_x - map_x) * delta_dist_x;
-	} else {
-		step_x = 1;
-		side_dist_x = (map_x + 1.0 - pos_x) * delta_dist_x;
-	}
-	if (dir_y < 0) {
-		step_y = -1;
-		side_dist_y = (pos_y - map_y) * delta_dist_y;
-	} else {
-		step_y = 1;
-		side_dist_y = (map_y + 1.0 - pos_y) * delta_dist_y;
+	if (raycast_renderer_set_thread_count(renderer, RAYCAST_DEFAULT_THREAD_COUNT) != 0) {
+		raycast_renderer_free(renderer);
+		return -1;
 	}
+	return 0;
+}
 
-	// perform DDA
-	while (hit == 0) {
-		// increment ray position
-		if (side_dist_x > side_dist_y) {
-			map_y += step_y;
-			side_dist_y += delta_dist_y;
-			side = 1;
-		} else {
-			map_x += step_x;
-			side_dist_x += delta_dist_x;
-			side = 0;
-		}
+// scratch functions
 
-		// check if ray is out of map bounds, manually stop casting if so
-		if (map_x < 0 || map_y < 0 || map_x >= scene->world_width || map_y >= scene->world_height) {
-			break;
-		}
-		hit = scene->world_map[map_x + scene->world_width * map_y];
-	}
+static void raycast_scratch_free(raycast_scratch_t* scratch, uint32_t count) {
+	if (scratch == NULL) return;
 
-	// calculate distance the ray traveled
-	if (side == 0) {
-		hit_info->distance = side_dist_x - delta_dist_x;
-	} else {
-		hit_info->distance = side_dist_y - delta_dist_y;
+	for (uint32_t i = 0; i < count; i++) {
+		free(scratch[i].block);
 	}
+	free(scratch);
+}
 
-	// set other info in hit_info struct
-	hit_info->hit_point.x = map_x;
-	hit_info->hit_point.y = map_y;
+// makes count scratch slots big enough for the renderers screen, returns NULL on failure
+static raycast_scratch_t* raycast_scratch_create(raycast_renderer_t* renderer, uint32_t count) {
+	size_t length = renderer->screen_width > renderer->screen_height ? renderer->screen_width : renderer->screen_height;
 
-	hit_info->wall_type = hit;
+	raycast_scratch_t *scratch = (raycast_scratch_t *) calloc(count, sizeof(raycast_scratch_t));
+	if (scratch == NULL) return NULL;
 
-	// calculate face hit
-	if (side == 0) {
-		if (dir_x > 0) {
-			hit_info->face = raycast_east;
-		} else {
-			hit_info->face = raycast_west;
-		}
-	} else {
-		if (dir_y > 0) {
-			hit_info->face = raycast_south;
-		} else {
-			hit_info->face = raycast_north;
+	for (uint32_t i = 0; i < count; i++) {
+		// reals and pointers first so every array stays aligned
+		char *block = (char *) malloc(length * (3 * sizeof(raycast_real_t) + sizeof(uint32_t *) + sizeof(uint32_t) + 2 * sizeof(int) + sizeof(uint8_t)));
+		if (block == NULL) {
+			raycast_scratch_free(scratch, count);
+			return NULL;
 		}
+
+		scratch[i].block = block;
+		scratch[i].unit_x = (raycast_real_t *) block;
+		scratch[i].unit_y = scratch[i].unit_x + length;
+		scratch[i].depth = scratch[i].unit_y + length;
+		scratch[i].pixels = (uint32_t **)(scratch[i].depth + length);
+		scratch[i].locations = (uint32_t *)(scratch[i].pixels + length);
+		scratch[i].map_x = (int *)(scratch[i].locations + length);
+		scratch[i].map_y = scratch[i].map_x + length;
+		scratch[i].light = (uint8_t *)(scratch[i].map_y + length);
 	}
-}
 
-void raycast_cast_ray(raycast_hit_info_t* hit_info, raycast_scene_t* scene, double pos_x, double pos_y, double dir_x, double dir_y) {
-	double initial_ray_length = sqrt(dir_x * dir_x + dir_y * dir_y);
+	return scratch;
+}
 
-	// cast ray
-	raycast_DDA(hit_info, scene, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+// memory block functions
 
-	// calculate the floating point location of where the ray hit
-	hit_info->hit_point.x = pos_x + dir_x / initial_ray_length * hit_info->distance;
-	hit_info->hit_point.y = pos_y + dir_y / initial_ray_length * hit_info->distance;
+// next piece of the arena, every piece starts on its own cache line so no two threads ever share one
+static void* raycast_arena_take(raycast_arena_t* arena, size_t size) {
+	size_t offset = (arena->used + RAYCAST_MEMORY_ALIGNMENT - 1) & ~(size_t)(RAYCAST_MEMORY_ALIGNMENT - 1);
+	arena->used = offset + size;
+	return arena->base == NULL ? NULL : arena->base + offset;
 }
 
-int raycast_check_obstruction(raycast_scene_t* scene, double start_x, double start_y, double end_x, double end_y) {
-	// set up variables for DDA function
-	double dir_x = end_x - start_x;
-	double dir_y = end_y - start_y;
+/*
+lays every buffer of a renderer out in the arena, with no base nothing is written and only the size is counted,
+so raycast_renderer_memory_size and the carving can't disagree, returns the memory struct at the start of the block
+*/
+static raycast_renderer_memory_t* raycast_memory_carve(raycast_arena_t* arena, uint32_t screen_width, uint32_t screen_height, const raycast_renderer_features_t* features) {
+	size_t pixel_count = (size_t)screen_width * screen_height;
+	size_t length = screen_width > screen_height ? screen_width : screen_height;
+	uint32_t thread_count = features->thread_count == 0 ? 1 : features->thread_count;
 
-	double between_length = sqrt(dir_x * dir_x + dir_y * dir_y);
+	raycast_renderer_memory_t *memory = (raycast_renderer_memory_t *) raycast_arena_take(arena, sizeof(raycast_renderer_memory_t));
+	raycast_depth_t *depth_buffer = features->depth_buffer ? (raycast_depth_t *) raycast_arena_take(arena, pixel_count * sizeof(raycast_depth_t)) : NULL;
+	raycast_depth_t *wall_depths = (raycast_depth_t *) raycast_arena_take(arena, screen_width * sizeof(raycast_depth_t));
+	int *wall_starts = (int *) raycast_arena_take(arena, screen_width * sizeof(int));
+	int *wall_ends = (int *) raycast_arena_take(arena, screen_width * sizeof(int));
+	uint32_t *wall_pixels = features->transposed_walls ? (uint32_t *) raycast_arena_take(arena, pixel_count * sizeof(uint32_t)) : NULL;
+	uint32_t *scaled_pixels = features->render_scale ? (uint32_t *) raycast_arena_take(arena, pixel_count * sizeof(uint32_t)) : NULL;
 
-	raycast_hit_info_t hit_info;
+	raycast_row_table_t *row_table = (raycast_row_table_t *) raycast_arena_take(arena, sizeof(raycast_row_table_t));
+	raycast_real_t *row_distances = (raycast_real_t *) raycast_arena_take(arena, screen_height * sizeof(raycast_real_t));
+	raycast_depth_t *row_depths = (raycast_depth_t *) raycast_arena_take(arena, screen_height * sizeof(raycast_depth_t));
 
-	//cast ray
-	raycast_DDA(&hit_info, scene, start_x, start_y, dir_x, dir_y, between_length);
+	raycast_frame_cache_t *cache = NULL;
+	raycast_hit_info_t *cache_hits = NULL;
+	uint8_t *cache_dirty = NULL;
 
-	// check if ray hit end point
-	if (hit_info.distance < between_length) {
-		return 1;
-	} else {
-		return 0;
+	if (features->frame_cache) {
+		cache = (raycast_frame_cache_t *) raycast_arena_take(arena, sizeof(raycast_frame_cache_t));
+		cache_hits = (raycast_hit_info_t *) raycast_arena_take(arena, screen_width * sizeof(raycast_hit_info_t));
+		cache_dirty = (uint8_t *) raycast_arena_take(arena, screen_width);
 	}
-}
-
-// render functions
 
-void raycast_render_walls(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
-	int w = renderer->screen_width;
-	int h = renderer->screen_height;
+	raycast_sprite_t *sprites = (raycast_sprite_t *) raycast_arena_take(arena, features->sprite_capacity * sizeof(raycast_sprite_t));
+	raycast_scratch_t *scratch = (raycast_scratch_t *) raycast_arena_take(arena, thread_count * sizeof(raycast_scratch_t));
 
-	for (int x = 0; x < w; x++) {
-		// ranges from -0.5 to 0.5 depending on x
-		double camera_x = (x / (double)w * 2 - 1) / 2;
+	// each array of each thread's scratch gets its own cache lines
+	for (uint32_t i = 0; i < thread_count; i++) {
+		raycast_scratch_t slot;
+		memset(&slot, 0, sizeof(slot));
 
-		// ray directions
-		double ray_dir_x = camera->direction.x * camera->focal_length + camera->plane.x * camera_x;
-		double ray_dir_y = camera->direction.y * camera->focal_length + camera->plane.y * camera_x;
+		slot.unit_x = (raycast_real_t *) raycast_arena_take(arena, length * sizeof(raycast_real_t));
+		slot.unit_y = (raycast_real_t *) raycast_arena_take(arena, length * sizeof(raycast_real_t));
+		slot.depth = (raycast_real_t *) raycast_arena_take(arena, length * sizeof(raycast_real_t));
+		slot.pixels = (uint32_t **) raycast_arena_take(arena, length * sizeof(uint32_t *));
+		slot.locations = (uint32_t *) raycast_arena_take(arena, length * sizeof(uint32_t));
+		slot.map_x = (int *) raycast_arena_take(arena, length * sizeof(int));
+		slot.map_y = (int *) raycast_arena_take(arena, length * sizeof(int));
+		slot.light = (uint8_t *) raycast_arena_take(arena, length);
 
-		/*
-		hit information of ray will be located in this struct,
-		some names will not match what the variable represents
-		*/
-		raycast_hit_info_t hit_info;
+		if (scratch != NULL) scratch[i] = slot;
+	}
 
-		// cast ray, assume ray length is 1 for faster performance and to calculate perpendicular distance instead of euclidean
-		raycast_DDA(&hit_info, scene, camera->position.x, camera->position.y, ray_dir_x, ray_dir_y, 1);
+	if (memory == NULL) return NULL;
 
-		// if we hit out of the map, don't do anything
-		if (hit_info.wall_type == 0) continue;
+	row_table->distances = row_distances;
+	row_table->depths = row_depths;
+	row_table->valid = 0;
 
-		//calculate value of wall_x
-		double wall_x; //where exactly the wall was hit
-		if (hit_info.face == raycast_east || hit_info.face == raycast_west) {
-			wall_x = camera->position.y + hit_info.distance * ray_dir_y;
-		} else {
-			wall_x = camera->position.x + hit_info.distance * ray_dir_x;
-		}
-		wall_x -= floor(wall_x);
+	if (cache != NULL) {
+		memset(cache, 0, sizeof(raycast_frame_cache_t));
+		cache->hits = cache_hits;
+		cache->dirty = cache_dirty;
+	}
 
-		// the height of the vertical column
-		int line_height = (int)(h / hit_info.distance);
+	memory->features = *features;
+	memory->features.thread_count = thread_count;
+	memory->size = arena->used;
+	memory->depth_buffer = depth_buffer;
+	memory->wall_depths = wall_depths;
+	memory->wall_starts = wall_starts;
+	memory->wall_ends = wall_ends;
+	memory->wall_pixels = wall_pixels;
+	memory->scaled_pixels = scaled_pixels;
+	memory->frame_cache = cache;
+	memory->row_table = row_table;
+	memory->sprites = sprites;
+	memory->scratch = scratch;
+	return memory;
+}
 
-		// where to offset endpoints from
-		int column_center = h / 2 + camera->pitch + (int)(h * camera->height / hit_info.distance);
+// nothing has been cast into a cache yet
+static void raycast_frame_cache_reset(raycast_frame_cache_t* cache, uint32_t screen_width) {
+	memset(cache->dirty, 1, screen_width);
+	cache->hit_width = screen_width;
+	cache->frame_valid = 0;
+}
 
-		// calculate the starting and ending pixel coordinates of the column to draw
-		int draw_start = column_center - (int)(line_height * scene->wall_height - (double)line_height / 2);
-		int draw_end = column_center + line_height / 2;
+// points the renderer at freshly carved memory, the optional buffers that were in use stay in use
+static void raycast_memory_attach(raycast_renderer_t* renderer, raycast_renderer_memory_t* memory) {
+	renderer->memory = memory;
 
-		// How much to increase the texture coordinate per screen pixel
-		double step = 1.0 / (draw_end - draw_start);
+	renderer->depth_buffer = renderer->column_depth ? NULL : memory->depth_buffer;
+	renderer->wall_depths = memory->wall_depths;
+	renderer->wall_starts = memory->wall_starts;
+	renderer->wall_ends = memory->wall_ends;
+	renderer->row_table = memory->row_table;
+	renderer->wall_pixels = renderer->wall_pixels != NULL ? memory->wall_pixels : NULL;
+	renderer->scaled_pixels = renderer->scaled_pixels != NULL ? memory->scaled_pixels : NULL;
+	renderer->frame_cache = renderer->frame_cache != NULL ? memory->frame_cache : NULL;
 
-		//Starting texture coordinate
-		double wall_y = draw_start < 0 ? abs(draw_start) * step : 0;
+	if (renderer->frame_cache != NULL) raycast_frame_cache_reset(renderer->frame_cache, renderer->screen_width);
 
-		// constrain draw_start and draw_end to be within the range 0 - screen_height
-		if (draw_start < 0) draw_start = 0;
-		if (draw_end >= h) draw_end = h;
+	renderer->sprites = memory->sprites;
+	renderer->sprite_capacity = memory->features.sprite_capacity;
+	renderer->sprite_count = 0;
+	renderer->scratch = memory->scratch;
 
-		raycast_screen_pixel_t pixel;
+	raycast_clear_walls(renderer);
+}
 
-		for (int y = draw_start; y < draw_end; y++) {
-			int index = x + w * y;
+size_t raycast_renderer_memory_size(uint32_t screen_width, uint32_t screen_height, const raycast_renderer_features_t* features) {
+	raycast_arena_t arena = {NULL, 0};
+	raycast_memory_carve(&arena, screen_width, screen_height, features);
+	return arena.used;
+}
 
-			if (renderer->depth_buffer[index] > hit_info.distance) {
-				raycast_uint32_to_color(renderer->pixel_data[index], &(pixel.color));
+int raycast_renderer_init_memory(raycast_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel, const raycast_renderer_features_t* features, void *memory, size_t size) {
+	raycast_renderer_defaults(renderer, pixel_data, screen_width, screen_height, surface_pixel, sprite_pixel);
 
-				pixel.location = index;
+	if (((uintptr_t)memory & (RAYCAST_MEMORY_ALIGNMENT - 1)) != 0 || size < raycast_renderer_memory_size(screen_width, screen_height, features)) return -1;
 
-				renderer->surface_pixel(&pixel, hit_info.hit_point.x, hit_info.hit_point.y, wall_x, wall_y, hit_info.face, hit_info.distance);
+	raycast_arena_t arena = {(char *)memory, 0};
+	raycast_renderer_memory_t *carved = raycast_memory_carve(&arena, screen_width, screen_height, features);
+	carved->size = size;
 
-				renderer->pixel_data[index] = raycast_color_to_uint32(&(pixel.color));
-				renderer->depth_buffer[index] = hit_info.distance;
-			}
+	// without a depth buffer the renderer can only draw in column depth mode
+	renderer->column_depth = !features->depth_buffer;
+	raycast_memory_attach(renderer, carved);
 
-			wall_y += step;
-		}
+	if (raycast_renderer_set_thread_count(renderer, carved->features.thread_count) != 0) {
+		raycast_renderer_free(renderer);
+		return -1;
 	}
+	return 0;
 }
 
-/*
-LATER: add different height floor / ceiling functionality
-*/
-void raycast_render_top_bottom(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
-	int w = renderer->screen_width;
-	int h = renderer->screen_height;
-	int half_h = h / 2;
+int raycast_renderer_resize_memory(raycast_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height) {
+	raycast_renderer_memory_t *memory = renderer->memory;
+	if (memory == NULL) return -1;
 
-	int y_start = renderer->render_top ? 0 : half_h;
-	int y_end = renderer->render_bottom ? h : half_h;
+	// the memory struct is carved again at the start of the block, keep what it knows first
+	raycast_renderer_features_t features = memory->features;
+	size_t size = memory->size;
 
-	for (int y = y_start; y < y_end; y++) {
-		int is_floor = y > half_h + camera->pitch;
+	if (raycast_renderer_memory_size(screen_width, screen_height, &features) > size) return -1;
 
-		// rayDir for leftmost ray (x = 0) and rightmost ray (x = w)
-		double ray_dir_x0 = camera->direction.x * camera->focal_length - camera->plane.x / 2;
-		double ray_dir_y0 = camera->direction.y * camera->focal_length - camera->plane.y / 2;
-		double ray_dir_x1 = camera->direction.x * camera->focal_length + camera->plane.x / 2;
-		double ray_dir_y1 = camera->direction.y * camera->focal_length + camera->plane.y / 2;
+	raycast_arena_t arena = {(char *)memory, 0};
+	memory = raycast_memory_carve(&arena, screen_width, screen_height, &features);
+	memory->size = size;
 
-		// Current y position compared to the center of the screen (the horizon)
-		int p = y - (half_h + camera->pitch);
+	renderer->pixel_data = pixel_data;
+	renderer->screen_width = screen_width;
+	renderer->screen_height = screen_height;
+	renderer->aspect_ratio = (raycast_real_t) screen_width / screen_height;
 
-		// Vertical position of the camera.
-		double pos_z = is_floor ? (camera->height + 1.0 / 2 - scene->bottom_height) * h : (scene->top_height - (camera->height + 1.0 / 2)) * h;
+	raycast_memory_attach(renderer, memory);
+	return 0;
+}
 
-		// Horizontal distance from the camera to the floor for the current row.
-		// 0.5 is the z position exactly in the middle between floor and ceiling.
-		double row_distance = p == 0 ? 1e9 : fabs(pos_z / p);
+// de-init functions
 
-		// calculate the real world step vector we have to add for each x (parallel to camera plane)
-		// adding step by step avoids multiplications with a weight in the inner loop
-		double floor_step_x = row_distance * (ray_dir_x1 - ray_dir_x0) / w;
-		double floor_step_y = row_distance * (ray_dir_y1 - ray_dir_y0) / w;
+void raycast_renderer_free(raycast_renderer_t* renderer) {
+	raycast_thread_pool_free(renderer->thread_pool);
+	renderer->thread_pool = NULL;
 
-		// real world coordinates of the leftmost column. This will be updated as we step to the right.
-		double floor_x = camera->position.x + row_distance * ray_dir_x0;
-		double floor_y = camera->position.y + row_distance * ray_dir_y0;
+	// everything else is in the caller's block
+	if (renderer->memory != NULL) {
+		renderer->memory = NULL;
+		renderer->scratch = NULL;
+		renderer->depth_buffer = NULL;
+		renderer->wall_depths = NULL;
+		renderer->wall_starts = NULL;
+		renderer->wall_ends = NULL;
+		renderer->wall_pixels = NULL;
+		renderer->scaled_pixels = NULL;
+		renderer->row_table = NULL;
+		renderer->frame_cache = NULL;
+		renderer->sprites = NULL;
+		renderer->sprite_capacity = 0;
+		return;
+	}
 
-		for (int x = 0; x < w; ++x) {
-			// the cell coord is simply got from the integer parts of floor_x and floor_y
-			int cell_x = (int)floor_x;
-			int cell_y = (int)floor_y;
+	raycast_scratch_free(renderer->scratch, renderer->thread_count);
+	renderer->scratch = NULL;
 
-			// the floating point coordinates within the cell, ranges between 0 - 1
-			double unit_x = floor_x - cell_x;
-			double unit_y = floor_y - cell_y;
+	free(renderer->depth_buffer);
+	free(renderer->wall_depths);
+	free(renderer->wall_starts);
+	free(renderer->wall_ends);
+	renderer->depth_buffer = NULL;
+	renderer->wall_depths = NULL;
+	renderer->wall_starts = NULL;
+	renderer->wall_ends = NULL;
 
-			raycast_screen_pixel_t pixel;
+	free(renderer->wall_pixels);
+	renderer->wall_pixels = NULL;
 
-			int index = y * w + x;
+	free(renderer->scaled_pixels);
+	renderer->scaled_pixels = NULL;
 
-			if (renderer->depth_buffer[index] > row_distance) {
-				raycast_face_t face;
+	free(renderer->row_table);
+	renderer->row_table = NULL;
 
-				raycast_uint32_to_color(renderer->pixel_data[index], &(pixel.color));
+	raycast_renderer_set_frame_cache(renderer, 0);
 
-				pixel.location = index;
+	free(renderer->sprites);
+	renderer->sprites = NULL;
+	renderer->sprite_capacity = 0;
+}
 
-				// we are drawing the ceiling
-				if (is_floor) {
-					face = raycast_bottom;
-				} else {
-					// we are drawing the floor
-					face = raycast_top;
-				}
+int raycast_renderer_set_column_depth(raycast_renderer_t* renderer, char enabled) {
+	raycast_renderer_memory_t *memory = renderer->memory;
 
-				renderer->surface_pixel(&pixel, cell_x, cell_y, fabs(unit_x), fabs(unit_y), face, row_distance);
-				renderer->pixel_data[index] = raycast_color_to_uint32(&(pixel.color));
-				renderer->depth_buffer[index] = row_distance;
-			}
+	if (enabled) {
+		if (memory == NULL) free(renderer->depth_buffer);
+		renderer->depth_buffer = NULL;
+		renderer->column_depth = 1;
+		return 0;
+	}
 
-			floor_x += floor_step_x;
-			floor_y += floor_step_y;
-		}
+	if (memory != NULL) {
+		if (memory->depth_buffer == NULL) return -1;
+		renderer->depth_buffer = memory->depth_buffer;
+	} else if (renderer->depth_buffer == NULL) {
+		renderer->depth_buffer = (raycast_depth_t *) malloc(renderer->screen_width * renderer->screen_height * sizeof(raycast_depth_t));
+		if (renderer->depth_buffer == NULL) return -1;
 	}
-}
 
-void raycast_render_sprites(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
-	int w = renderer->screen_width;
-	int h = renderer->screen_height;
+	renderer->column_depth = 0;
+	return 0;
+}
 
-	double camera_i_x = camera->plane.x / 2;
-	double camera_i_y = camera->plane.y / 2;
+int raycast_renderer_set_transposed_walls(raycast_renderer_t* renderer, char enabled) {
+	raycast_renderer_memory_t *memory = renderer->memory;
 
-	double camera_j_x = camera->direction.x * camera->focal_length;
-	double camera_j_y = camera->direction.y * camera->focal_length;
+	if (!enabled) {
+		if (memory == NULL) free(renderer->wall_pixels);
+		renderer->wall_pixels = NULL;
+		return 0;
+	}
 
-	for (int i = 0; i < scene->object_count; i++) {
-		raycast_object_t *object = scene->objects + i;
+	if (memory != NULL) {
+		if (memory->wall_pixels == NULL) return -1;
+		renderer->wall_pixels = memory->wall_pixels;
+	} else if (renderer->wall_pixels == NULL) {
+		renderer->wall_pixels = (uint32_t *) malloc(renderer->screen_width * renderer->screen_height * sizeof(uint32_t));
+		if (renderer->wall_pixels == NULL) return -1;
+	}
 
-		//translate sprite position to relative to camera
-		double sprite_x = object->position.x - camera->position.x;
-		double sprite_y = object->position.y - camera->position.y;
+	return 0;
+}
 
-		//transform sprite with the inverse camera matrix
-		double inv_det = 1.0 / (camera_i_x * camera_j_y - camera_j_x * camera_i_y);
+int raycast_renderer_set_frame_cache(raycast_renderer_t* renderer, char enabled) {
+	raycast_frame_cache_t *cache = renderer->frame_cache;
+	raycast_renderer_memory_t *memory = renderer->memory;
 
-		// sprites coordinates relative to the camera, y coordinate used as depth (z-axis)
-		double transform_x = inv_det * (camera_j_y * sprite_x - camera_j_x * sprite_y);
-		double transform_y = inv_det * (-camera_i_y * sprite_x + camera_i_x * sprite_y);
+	if (!enabled) {
+		if (cache != NULL && memory == NULL) {
+			free(cache->hits);
+			free(cache->dirty);
+			free(cache);
+		}
+		renderer->frame_cache = NULL;
+		return 0;
+	}
 
-		// if the sprite is behind us, don't draw it
-		if (transform_y < 0) continue;
+	if (cache != NULL) return 0;
 
-		// screen coordinates of the sprite's center
-		int sprite_screen_x = (int)((1 + transform_x / transform_y) / 2 * w);
-		int sprite_screen_y = (int)((1 - object->height / transform_y) / 2 * h) + camera->pitch + (int)(h * camera->height / transform_y);
+	if (memory != NULL) {
+		if (memory->frame_cache == NULL) return -1;
+		raycast_frame_cache_reset(memory->frame_cache, renderer->screen_width);
+		renderer->frame_cache = memory->frame_cache;
+		return 0;
+	}
 
-		//calculate height of the sprite on screen
-		int sprite_height = abs((int)(h * (object->size / transform_y)));
-		//calculate lowest and highest pixel to fill in current stripe
-		int draw_start_y = sprite_screen_y - sprite_height / 2;
-		int draw_end_y = sprite_screen_y + sprite_height / 2;
+	cache = (raycast_frame_cache_t *) calloc(1, sizeof(raycast_frame_cache_t));
+	if (cache == NULL) return -1;
 
-		//calculate width of the sprite
-		int sprite_width = sprite_height; // same as height of sprite, given that it's square
-		int draw_start_x = sprite_screen_x - sprite_width / 2;
-		int draw_end_x = sprite_screen_x + sprite_width / 2;
+	cache->hits = (raycast_hit_info_t *) malloc(renderer->screen_width * sizeof(raycast_hit_info_t));
+	cache->dirty = (uint8_t *) malloc(renderer->screen_width);
 
-		// how much to increase percent variables per pixel
-		double step = 1.0 / sprite_height;
+	if (cache->hits == NULL || cache->dirty == NULL) {
+		free(cache->hits);
+		free(cache->dirty);
+		free(cache);
+		return -1;
+	}
+
+	raycast_frame_cache_reset(cache, renderer->screen_width);
+
+	renderer->frame_cache = cache;
+	return 0;
+}
+
+void raycast_renderer_invalidate(raycast_renderer_t* renderer) {
+	raycast_frame_cache_t *cache = renderer->frame_cache;
+	if (cache == NULL) return;
+
+	memset(cache->dirty, 1, renderer->screen_width);
+	cache->frame_valid = 0;
+}
+
+// 1 if the segment from (x, y) to (x + dx, y + dy) touches the cell, grown by a little so rounding can't miss it
+static int raycast_segment_touches_cell(raycast_real_t x, raycast_real_t y, raycast_real_t dx, raycast_real_t dy, uint32_t cell_x, uint32_t cell_y) {
+	raycast_real_t margin = (raycast_real_t)1 / 1024;
+	raycast_real_t low[2] = {cell_x - margin, cell_y - margin};
+	raycast_real_t start[2] = {x, y};
+	raycast_real_t delta[2] = {dx, dy};
+
+	raycast_real_t t_min = 0, t_max = 1;
+
+	for (int axis = 0; axis < 2; axis++) {
+		raycast_real_t high = low[axis] + 1 + 2 * margin;
+
+		if (delta[axis] == 0) {
+			if (start[axis] < low[axis] || start[axis] > high) return 0;
+			continue;
+		}
+
+		raycast_real_t t0 = (low[axis] - start[axis]) / delta[axis];
+		raycast_real_t t1 = (high - start[axis]) / delta[axis];
+
+		if (t0 > t1) {
+			raycast_real_t swap = t0;
+			t0 = t1;
+			t1 = swap;
+		}
+
+		if (t0 > t_min) t_min = t0;
+		if (t1 < t_max) t_max = t1;
+	}
+
+	return t_min <= t_max;
+}
+
+/*
+a cell can only change what a column shows if the column's ray passed through it or stopped on it,
+so only columns whose cached ray touches the cell are recast
+*/
+void raycast_renderer_invalidate_cell(raycast_renderer_t* renderer, uint32_t x, uint32_t y) {
+	raycast_frame_cache_t *cache = renderer->frame_cache;
+	if (cache == NULL) return;
+
+	cache->frame_valid = 0;
+
+	const raycast_camera_t *camera = &cache->hit_camera;
+	int w = cache->hit_width;
+
+	for (int column = 0; column < w; column++) {
+		if (cache->dirty[column]) continue;
+
+		// same ray direction as the wall pass
+		raycast_real_t camera_x = (column / (raycast_real_t)w * 2 - 1) / 2;
+		raycast_real_t ray_dir_x = camera->direction.x * camera->focal_length + camera->plane.x * camera_x;
+		raycast_real_t ray_dir_y = camera->direction.y * camera->focal_length + camera->plane.y * camera_x;
+
+		raycast_real_t distance = cache->hits[column].distance;
+
+		if (raycast_segment_touches_cell(camera->position.x, camera->position.y, ray_dir_x * distance, ray_dir_y * distance, x, y)) {
+			cache->dirty[column] = 1;
+		}
+	}
+}
+
+int raycast_renderer_set_thread_count(raycast_renderer_t* renderer, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	// the scratch of every thread a block was carved for is already there, only the pool changes
+	if (renderer->memory != NULL) {
+		if (thread_count > renderer->memory->features.thread_count) return -1;
+
+		raycast_thread_pool_free(renderer->thread_pool);
+		renderer->thread_pool = raycast_thread_pool_create(thread_count);
+		renderer->thread_count = renderer->thread_pool == NULL ? 1 : thread_count;
+		return renderer->thread_pool == NULL ? -1 : 0;
+	}
+
+	raycast_thread_pool_free(renderer->thread_pool);
+	raycast_scratch_free(renderer->scratch, renderer->thread_count);
+
+	renderer->thread_pool = raycast_thread_pool_create(thread_count);
+	renderer->scratch = raycast_scratch_create(renderer, thread_count);
+
+	if (renderer->thread_pool == NULL || renderer->scratch == NULL) {
+		// keep the renderer usable, a NULL pool renders on the calling thread
+		raycast_thread_pool_free(renderer->thread_pool);
+		raycast_scratch_free(renderer->scratch, thread_count);
+
+		renderer->thread_pool = NULL;
+		renderer->scratch = raycast_scratch_create(renderer, 1);
+		renderer->thread_count = 1;
+		return -1;
+	}
+
+	renderer->thread_count = thread_count;
+	return 0;
+}
+
+int raycast_renderer_set_render_scale(raycast_renderer_t* renderer, uint32_t scale_x, uint32_t scale_y) {
+	if (scale_x == 0 || scale_y == 0) return -1;
+
+	raycast_renderer_memory_t *memory = renderer->memory;
+
+	if (scale_x == 1 && scale_y == 1) {
+		if (memory == NULL) free(renderer->scaled_pixels);
+		renderer->scaled_pixels = NULL;
+	} else if (memory != NULL) {
+		if (memory->scaled_pixels == NULL) return -1;
+		renderer->scaled_pixels = memory->scaled_pixels;
+	} else if (renderer->scaled_pixels == NULL) {
+		// sized for the whole screen so the scale can change without reallocating
+		renderer->scaled_pixels = (uint32_t *) malloc(renderer->screen_width * renderer->screen_height * sizeof(uint32_t));
+		if (renderer->scaled_pixels == NULL) return -1;
+	}
+
+	renderer->scale_x = scale_x;
+	renderer->scale_y = scale_y;
+	return 0;
+}
+
+void raycast_renderer_set_linear_upscale(raycast_renderer_t* renderer, char enabled) {
+	renderer->linear_upscale = enabled;
+}
+
+void raycast_renderer_set_target_frame_time(raycast_renderer_t* renderer, double frame_time, uint32_t max_scale) {
+	renderer->target_frame_time = frame_time;
+	renderer->max_scale = max_scale == 0 ? 1 : max_scale;
+
+	// start timing from scratch
+	renderer->scale_time = 0;
+	renderer->scale_frames = 0;
+}
+
+void raycast_renderer_set_span_functions(raycast_renderer_t* renderer, surface_span_t surface_span, sprite_span_t sprite_span) {
+	renderer->surface_span = surface_span;
+	renderer->sprite_span = sprite_span;
+}
+
+void raycast_renderer_set_distance_field(raycast_renderer_t* renderer, const raycast_distance_field_t* field) {
+	renderer->distance_field = field;
+}
+
+void raycast_texture_atlas_free(raycast_texture_atlas_t* atlas) {
+	free(atlas->texels);
+	free(atlas->textures);
+	atlas->texels = NULL;
+	atlas->textures = NULL;
+}
+
+// texture functions
+
+// returns log2 of a power of two, or -1 if value isn't one
+static int raycast_log2(uint32_t value) {
+	if (value == 0 || (value & (value - 1)) != 0) return -1;
+
+	int shift = 0;
+	while ((1u << shift) != value) shift++;
+	return shift;
+}
+
+int raycast_texture_atlas_add(raycast_texture_atlas_t* atlas, const uint32_t *texels, uint32_t width, uint32_t height) {
+	int width_shift = raycast_log2(width);
+	int height_shift = raycast_log2(height);
+
+	// the floor stepping keeps 16 bits of fraction, larger textures can't be addressed
+	if (width_shift < 0 || height_shift < 0 || width_shift > 16 || height_shift > 16) return -1;
+	if (atlas->texture_count == atlas->texture_capacity) return -1;
+	if ((uint64_t)atlas->texel_count + (uint64_t)width * height > atlas->texel_capacity) return -1;
+
+	raycast_texture_t *texture = atlas->textures + atlas->texture_count;
+	texture->offset = atlas->texel_count;
+	texture->width_shift = width_shift;
+	texture->height_shift = height_shift;
+
+	// store column by column, texel (u, v) lives at offset + (u << height_shift) + v
+	uint32_t *dest = atlas->texels + texture->offset;
+	for (uint32_t u = 0; u < width; u++) {
+		for (uint32_t v = 0; v < height; v++) {
+			*dest++ = texels[u + v * width];
+		}
+	}
+
+	atlas->texel_count = (uint32_t)((uint64_t)atlas->texel_count + (uint64_t)width * height);
+	return atlas->texture_count++;
+}
+
+void raycast_texture_atlas_set_wall(raycast_texture_atlas_t* atlas, uint8_t wall_type, raycast_face_t face, int texture) {
+	if (face > raycast_west) return;
+	atlas->wall_textures[wall_type][face] = texture;
+}
+
+// camera movement functions
+
+void raycast_camera_set_dir(raycast_camera_t* camera, raycast_real_t x, raycast_real_t y) {
+	raycast_real_t length = raycast_sqrt(x * x + y * y);
+	if (length == 0) return;
+	camera->direction.x = x / length;
+	camera->direction.y = y / length;
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+void raycast_camera_rotate(raycast_camera_t* camera, raycast_real_t angle) {
+	raycast_real_t i_x = raycast_cos(angle);
+	raycast_real_t i_y = raycast_sin(angle);
+	raycast_real_t j_x = -i_y;
+	raycast_real_t j_y = i_x;
+
+	raycast_real_t x = camera->direction.x;
+	raycast_real_t y = camera->direction.y;
+
+	camera->direction.x = x * i_x + y * j_x;
+	camera->direction.y = x * i_y + y * j_y;
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+void raycast_camera_set_rotation(raycast_camera_t* camera, raycast_real_t angle) {
+	camera->direction.x = raycast_cos(angle);
+	camera->direction.y = raycast_sin(angle);
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+// cast ray functions
+
+/*
+one ray walking the grid, the single ray and packet DDA share the setup, step and finish
+code below so a ray lands on exactly the same cell and distance whichever way it is cast
+*/
+typedef struct {
+	int map_x, map_y;
+	int step_x, step_y;
+	raycast_dda_t side_dist_x, side_dist_y;
+	raycast_dda_t delta_dist_x, delta_dist_y;
+	raycast_real_t dir_x, dir_y;
+	uint8_t side;
+} raycast_ray_t;
+
+static inline void raycast_ray_setup(raycast_ray_t* ray, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t initial_ray_length) {
+	ray->map_x = (int)pos_x;
+	ray->map_y = (int)pos_y;
+
+	ray->dir_x = dir_x;
+	ray->dir_y = dir_y;
+
+	raycast_real_t real_delta_x = dir_x == 0 ? 1e30 : raycast_fabs(initial_ray_length / dir_x);
+	raycast_real_t real_delta_y = dir_y == 0 ? 1e30 : raycast_fabs(initial_ray_length / dir_y);
+
+	ray->delta_dist_x = raycast_to_dda(real_delta_x);
+	ray->delta_dist_y = raycast_to_dda(real_delta_y);
+
+	ray->side = 0;
+
+	// DDA setup step directions and initial side distances
+	if (dir_x < 0) {
+		ray->step_x = -1;
+		ray->side_dist_x = raycast_to_dda((pos_x - ray->map_x) * real_delta_x);
+	} else {
+		ray->step_x = 1;
+		ray->side_dist_x = raycast_to_dda((ray->map_x + 1 - pos_x) * real_delta_x);
+	}
+	if (dir_y < 0) {
+		ray->step_y = -1;
+		ray->side_dist_y = raycast_to_dda((pos_y - ray->map_y) * real_delta_y);
+	} else {
+		ray->step_y = 1;
+		ray->side_dist_y = raycast_to_dda((ray->map_y + 1 - pos_y) * real_delta_y);
+	}
+}
+
+/*
+moves the ray into the next cell, written with selects instead of branches so a packet
+of rays heading in different directions doesn't mispredict on every step
+*/
+static inline void raycast_ray_step(raycast_ray_t* ray) {
+	uint8_t side = ray->side_dist_x > ray->side_dist_y;
+
+	ray->map_x += side ? 0 : ray->step_x;
+	ray->map_y += side ? ray->step_y : 0;
+	ray->side_dist_x += side ? 0 : ray->delta_dist_x;
+	ray->side_dist_y += side ? ray->delta_dist_y : 0;
+	ray->side = side;
+}
+
+// one cell of a layer of a tiled map, the cell has to be on the map and the layer in the file
+static inline uint8_t raycast_tiled_cell(const raycast_tiled_map_t* map, uint32_t layer, uint32_t x, uint32_t y) {
+	uint32_t shift = map->chunk_shift;
+	uint32_t mask = (1u << shift) - 1;
+	const uint8_t *chunk = map->file + map->chunk_offsets[(x >> shift) + map->chunks_x * (y >> shift)];
+
+	return chunk[(((layer << shift) + (y & mask)) << shift) + (x & mask)];
+}
+
+// one wall cell of the scene, from its tiled map if it has one, the cell has to be on the map
+static inline uint8_t raycast_world_cell(const raycast_scene_t* scene, uint32_t x, uint32_t y) {
+	if (scene->tiled_map != NULL) return raycast_tiled_cell(scene->tiled_map, raycast_layer_walls, x, y);
+
+	return scene->world_map[x + scene->world_width * y];
+}
+
+// height of the top of a cell, walls without a height of their own reach wall_height
+static inline raycast_real_t raycast_cell_top(const raycast_scene_t* scene, uint8_t wall_type, uint32_t x, uint32_t y) {
+	uint8_t height = scene->cell_heights[x + scene->world_width * y];
+
+	if (wall_type != 0 && height == 0) return scene->wall_height;
+	return scene->bottom_height + height * scene->height_scale;
+}
+
+// returns 1 if the ray left the map, the ray stops there without hitting anything
+static inline int raycast_ray_outside(const raycast_ray_t* ray, const raycast_scene_t* scene) {
+	return ray->map_x < 0 || ray->map_y < 0 || ray->map_x >= scene->world_width || ray->map_y >= scene->world_height;
+}
+
+// distance the ray traveled to the edge of the cell it is in
+static inline raycast_real_t raycast_ray_distance(const raycast_ray_t* ray) {
+	if (ray->side == 0) {
+		return raycast_from_dda(ray->side_dist_x - ray->delta_dist_x);
+	} else {
+		return raycast_from_dda(ray->side_dist_y - ray->delta_dist_y);
+	}
+}
+
+static inline void raycast_ray_finish(raycast_hit_info_t* hit_info, const raycast_ray_t* ray, uint8_t hit) {
+	hit_info->distance = raycast_ray_distance(ray);
+
+	// set other info in hit_info struct
+	hit_info->hit_point.x = ray->map_x;
+	hit_info->hit_point.y = ray->map_y;
+
+	hit_info->wall_type = hit;
+
+	// calculate face hit
+	if (ray->side == 0) {
+		if (ray->dir_x > 0) {
+			hit_info->face = raycast_east;
+		} else {
+			hit_info->face = raycast_west;
+		}
+	} else {
+		if (ray->dir_y > 0) {
+			hit_info->face = raycast_south;
+		} else {
+			hit_info->face = raycast_north;
+		}
+	}
+}
+
+void raycast_DDA(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t initial_ray_length) {
+	raycast_ray_t ray;
+	raycast_ray_setup(&ray, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+
+	uint8_t hit = 0;
+
+	// perform DDA
+	while (hit == 0) {
+		raycast_ray_step(&ray);
+
+		// check if ray is out of map bounds, manually stop casting if so
+		if (raycast_ray_outside(&ray, scene)) break;
+
+		hit = raycast_world_cell(scene, ray.map_x, ray.map_y);
+	}
+
+	raycast_ray_finish(hit_info, &ray, hit);
+}
+
+/*
+walks up to RAYCAST_PACKET_SIZE set up rays through the grid in lock step, every round moves each
+live ray one cell, so the map reads of neighbouring rays are issued together and mostly hit the same
+cache lines, rays that stop are swapped out of the live list so the rest keep going without them,
+this is the fallback of the vector kernels below, fixed point builds always use it
+*/
+static void raycast_DDA_rays_scalar(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_ray_t* rays, uint32_t count) {
+	uint8_t live[RAYCAST_PACKET_SIZE];
+	uint32_t live_count = count;
+
+	for (uint32_t i = 0; i < count; i++) {
+		live[i] = i;
+	}
+
+	while (live_count != 0) {
+		for (uint32_t i = 0; i < live_count; i++) {
+			raycast_ray_step(rays + live[i]);
+		}
+
+		for (uint32_t i = 0; i < live_count;) {
+			raycast_ray_t *ray = rays + live[i];
+			uint8_t hit = 0;
+
+			if (raycast_ray_outside(ray, scene) || (hit = raycast_world_cell(scene, ray->map_x, ray->map_y)) != 0) {
+				raycast_ray_finish(hit_info + live[i], ray, hit);
+				live[i] = live[--live_count];
+			} else {
+				i++;
+			}
+		}
+	}
+}
+
+typedef void (*raycast_rays_kernel_t)(raycast_hit_info_t*, raycast_scene_t*, raycast_ray_t*, uint32_t);
+
+// the SIMD kernels are picked once from what the cpu supports, see raycast_select_kernels
+static pthread_once_t raycast_kernels_once = PTHREAD_ONCE_INIT;
+static void raycast_select_kernels(void);
+
+#if defined(RAYCAST_X86_SIMD) && !defined(RAYCAST_PRECISION_FIXED)
+#define RAYCAST_SIMD_DDA
+
+/*
+vector packet DDA, every field of a group of rays is kept in lanes of raycast_real_t, map coordinates and
+step directions too, they stay whole numbers so stepping them is exact, every round compares the side
+distances of all lanes at once and moves each ray along x or y by masking its step and delta instead of
+branching, the adds and compares are the scalar DDA's so every ray stops on the same cell with the same
+side distances, every lane steps every round whether its ray stopped or not, and the map cell, side
+distances and side of each lane are kept from the round it first stopped in, so the steps never wait on
+a cell read and the reads of several rounds are in flight at once, the group ends when every lane stopped
+*/
+#ifdef RAYCAST_PRECISION_FLOAT
+typedef __m128 raycast_lanes_sse2_t;
+#define RAYCAST_LANES_SSE2 4
+#define raycast_lanes_set1_sse2 _mm_set1_ps
+#define raycast_lanes_load_sse2 _mm_loadu_ps
+#define raycast_lanes_store_sse2 _mm_storeu_ps
+#define raycast_lanes_add_sse2 _mm_add_ps
+#define raycast_lanes_and_sse2 _mm_and_ps
+#define raycast_lanes_andnot_sse2 _mm_andnot_ps
+#define raycast_lanes_or_sse2 _mm_or_ps
+#define raycast_lanes_gt_sse2 _mm_cmpgt_ps
+#define raycast_lanes_lt_sse2 _mm_cmplt_ps
+#define raycast_lanes_ge_sse2 _mm_cmpge_ps
+#define raycast_lanes_movemask_sse2 _mm_movemask_ps
+#define raycast_lanes_blend_sse2(a, b, mask) _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b))
+
+typedef __m256 raycast_lanes_avx2_t;
+#define RAYCAST_LANES_AVX2 8
+#define raycast_lanes_set1_avx2 _mm256_set1_ps
+#define raycast_lanes_load_avx2 _mm256_loadu_ps
+#define raycast_lanes_store_avx2 _mm256_storeu_ps
+#define raycast_lanes_add_avx2 _mm256_add_ps
+#define raycast_lanes_and_avx2 _mm256_and_ps
+#define raycast_lanes_andnot_avx2 _mm256_andnot_ps
+#define raycast_lanes_or_avx2 _mm256_or_ps
+#define raycast_lanes_gt_avx2(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define raycast_lanes_lt_avx2(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define raycast_lanes_ge_avx2(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define raycast_lanes_movemask_avx2 _mm256_movemask_ps
+#define raycast_lanes_blend_avx2 _mm256_blendv_ps
+#else
+typedef __m128d raycast_lanes_sse2_t;
+#define RAYCAST_LANES_SSE2 2
+#define raycast_lanes_set1_sse2 _mm_set1_pd
+#define raycast_lanes_load_sse2 _mm_loadu_pd
+#define raycast_lanes_store_sse2 _mm_storeu_pd
+#define raycast_lanes_add_sse2 _mm_add_pd
+#define raycast_lanes_and_sse2 _mm_and_pd
+#define raycast_lanes_andnot_sse2 _mm_andnot_pd
+#define raycast_lanes_or_sse2 _mm_or_pd
+#define raycast_lanes_gt_sse2 _mm_cmpgt_pd
+#define raycast_lanes_lt_sse2 _mm_cmplt_pd
+#define raycast_lanes_ge_sse2 _mm_cmpge_pd
+#define raycast_lanes_movemask_sse2 _mm_movemask_pd
+#define raycast_lanes_blend_sse2(a, b, mask) _mm_or_pd(_mm_andnot_pd(mask, a), _mm_and_pd(mask, b))
+
+typedef __m256d raycast_lanes_avx2_t;
+#define RAYCAST_LANES_AVX2 4
+#define raycast_lanes_set1_avx2 _mm256_set1_pd
+#define raycast_lanes_load_avx2 _mm256_loadu_pd
+#define raycast_lanes_store_avx2 _mm256_storeu_pd
+#define raycast_lanes_add_avx2 _mm256_add_pd
+#define raycast_lanes_and_avx2 _mm256_and_pd
+#define raycast_lanes_andnot_avx2 _mm256_andnot_pd
+#define raycast_lanes_or_avx2 _mm256_or_pd
+#define raycast_lanes_gt_avx2(a, b) _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define raycast_lanes_lt_avx2(a, b) _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define raycast_lanes_ge_avx2(a, b) _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+#define raycast_lanes_movemask_avx2 _mm256_movemask_pd
+#define raycast_lanes_blend_avx2 _mm256_blendv_pd
+#endif
+
+// the widest group of lanes any kernel walks, the arrays below hold one group
+#define RAYCAST_LANES_MAX 8
+
+// one group of rays split into arrays of lanes, lanes past the end of the group start out stopped
+typedef struct {
+	raycast_real_t lane[RAYCAST_LANES_MAX];
+	raycast_real_t map_x[RAYCAST_LANES_MAX], map_y[RAYCAST_LANES_MAX];
+	raycast_real_t step_x[RAYCAST_LANES_MAX], step_y[RAYCAST_LANES_MAX];
+	raycast_real_t side_dist_x[RAYCAST_LANES_MAX], side_dist_y[RAYCAST_LANES_MAX];
+	raycast_real_t delta_dist_x[RAYCAST_LANES_MAX], delta_dist_y[RAYCAST_LANES_MAX];
+	raycast_real_t cells[RAYCAST_LANES_MAX];
+} raycast_lanes_t;
+
+static void raycast_lanes_load(raycast_lanes_t* lanes, const raycast_ray_t* rays, uint32_t count, uint32_t width) {
+	for (uint32_t i = 0; i < width; i++) {
+		const raycast_ray_t *ray = rays + (i < count ? i : 0);
+
+		lanes->lane[i] = (raycast_real_t)i;
+		lanes->map_x[i] = (raycast_real_t)ray->map_x;
+		lanes->map_y[i] = (raycast_real_t)ray->map_y;
+		lanes->step_x[i] = (raycast_real_t)ray->step_x;
+		lanes->step_y[i] = (raycast_real_t)ray->step_y;
+		lanes->side_dist_x[i] = ray->side_dist_x;
+		lanes->side_dist_y[i] = ray->side_dist_y;
+		lanes->delta_dist_x[i] = ray->delta_dist_x;
+		lanes->delta_dist_y[i] = ray->delta_dist_y;
+	}
+}
+
+// puts the stopped rays back into their structs and fills in their hits, side_bits has bit i set if lane i last stepped along y
+static void raycast_lanes_finish(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_ray_t* rays, const raycast_lanes_t* lanes, uint32_t count, int side_bits) {
+	for (uint32_t i = 0; i < count; i++) {
+		raycast_ray_t *ray = rays + i;
+
+		ray->map_x = (int)lanes->map_x[i];
+		ray->map_y = (int)lanes->map_y[i];
+		ray->side_dist_x = lanes->side_dist_x[i];
+		ray->side_dist_y = lanes->side_dist_y[i];
+		ray->side = (side_bits >> i) & 1;
+
+		raycast_ray_finish(hit_info + i, ray, raycast_ray_outside(ray, scene) ? 0 : raycast_world_cell(scene, ray->map_x, ray->map_y));
+	}
+}
+
+// reads the cells of the lanes in inside_bits into lanes->cells one by one, the rest read as 0
+static inline void raycast_lanes_read_cells(raycast_lanes_t* lanes, raycast_scene_t* scene, int inside_bits, uint32_t width) {
+	for (uint32_t i = 0; i < width; i++) {
+		lanes->cells[i] = (inside_bits >> i) & 1 ? raycast_world_cell(scene, (uint32_t)lanes->map_x[i], (uint32_t)lanes->map_y[i]) : 0;
+	}
+}
+
+/*
+reads the cells of the lanes in inside as a mask of the lanes that hit a wall, there is no gather before AVX2
+but the cell index of every lane is worked out in the lanes and every lane reads its cell without branching,
+lanes outside inside read the first cell and are masked off after
+*/
+__attribute__((target("sse2")))
+static inline raycast_lanes_sse2_t raycast_lanes_read_map_sse2(const raycast_scene_t* scene, raycast_lanes_sse2_t map_x, raycast_lanes_sse2_t map_y, raycast_lanes_sse2_t inside) {
+	const uint8_t *map = scene->world_map;
+
+#ifdef RAYCAST_PRECISION_FLOAT
+	__m128i cell = _mm_cvttps_epi32(_mm_and_ps(inside, _mm_add_ps(map_x, _mm_mul_ps(map_y, _mm_set1_ps((float)scene->world_width)))));
+	raycast_lanes_sse2_t walls = _mm_setr_ps(
+		map[_mm_cvtsi128_si32(cell)], map[_mm_cvtsi128_si32(_mm_srli_si128(cell, 4))],
+		map[_mm_cvtsi128_si32(_mm_srli_si128(cell, 8))], map[_mm_cvtsi128_si32(_mm_srli_si128(cell, 12))]);
+#else
+	__m128i cell = _mm_cvttpd_epi32(_mm_and_pd(inside, _mm_add_pd(map_x, _mm_mul_pd(map_y, _mm_set1_pd((double)scene->world_width)))));
+	raycast_lanes_sse2_t walls = _mm_setr_pd(map[_mm_cvtsi128_si32(cell)], map[_mm_cvtsi128_si32(_mm_srli_si128(cell, 4))]);
+#endif
+
+	return raycast_lanes_and_sse2(inside, raycast_lanes_gt_sse2(walls, raycast_lanes_set1_sse2(0)));
+}
+
+__attribute__((target("sse2")))
+static void raycast_DDA_rays_sse2(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_ray_t* rays, uint32_t count) {
+	raycast_lanes_t lanes;
+
+	raycast_lanes_sse2_t zero = raycast_lanes_set1_sse2(0);
+	raycast_lanes_sse2_t all = raycast_lanes_ge_sse2(zero, zero);
+	raycast_lanes_sse2_t width = raycast_lanes_set1_sse2((raycast_real_t)scene->world_width);
+	raycast_lanes_sse2_t height = raycast_lanes_set1_sse2((raycast_real_t)scene->world_height);
+
+	// cell indices are worked out in the lanes, they have to fit in 32 bits and in the mantissa of a float
+#ifdef RAYCAST_PRECISION_FLOAT
+	uint64_t cell_limit = (uint64_t)1 << 24;
+#else
+	uint64_t cell_limit = INT32_MAX;
+#endif
+	int plain = scene->tiled_map == NULL && (uint64_t)scene->world_width * scene->world_height <= cell_limit;
+
+	for (uint32_t first = 0; first < count; first += RAYCAST_LANES_SSE2) {
+		uint32_t group = count - first < RAYCAST_LANES_SSE2 ? count - first : RAYCAST_LANES_SSE2;
+		raycast_lanes_load(&lanes, rays + first, group, RAYCAST_LANES_SSE2);
+
+		raycast_lanes_sse2_t map_x = raycast_lanes_load_sse2(lanes.map_x);
+		raycast_lanes_sse2_t map_y = raycast_lanes_load_sse2(lanes.map_y);
+		raycast_lanes_sse2_t step_x = raycast_lanes_load_sse2(lanes.step_x);
+		raycast_lanes_sse2_t step_y = raycast_lanes_load_sse2(lanes.step_y);
+		raycast_lanes_sse2_t side_dist_x = raycast_lanes_load_sse2(lanes.side_dist_x);
+		raycast_lanes_sse2_t side_dist_y = raycast_lanes_load_sse2(lanes.side_dist_y);
+		raycast_lanes_sse2_t delta_dist_x = raycast_lanes_load_sse2(lanes.delta_dist_x);
+		raycast_lanes_sse2_t delta_dist_y = raycast_lanes_load_sse2(lanes.delta_dist_y);
+
+		// what each lane looked like the round it stopped, lanes past the group count as stopped from the start
+		raycast_lanes_sse2_t stopped = raycast_lanes_ge_sse2(raycast_lanes_load_sse2(lanes.lane), raycast_lanes_set1_sse2((raycast_real_t)group));
+		raycast_lanes_sse2_t stop_map_x = map_x, stop_map_y = map_y;
+		raycast_lanes_sse2_t stop_side_dist_x = side_dist_x, stop_side_dist_y = side_dist_y;
+		raycast_lanes_sse2_t stop_side = zero;
+
+		while (raycast_lanes_movemask_sse2(stopped) != (1 << RAYCAST_LANES_SSE2) - 1) {
+			// lanes whose next crossing is along y
+			raycast_lanes_sse2_t along_y = raycast_lanes_gt_sse2(side_dist_x, side_dist_y);
+
+			map_x = raycast_lanes_add_sse2(map_x, raycast_lanes_andnot_sse2(along_y, step_x));
+			map_y = raycast_lanes_add_sse2(map_y, raycast_lanes_and_sse2(along_y, step_y));
+			side_dist_x = raycast_lanes_add_sse2(side_dist_x, raycast_lanes_andnot_sse2(along_y, delta_dist_x));
+			side_dist_y = raycast_lanes_add_sse2(side_dist_y, raycast_lanes_and_sse2(along_y, delta_dist_y));
+
+			raycast_lanes_sse2_t outside = raycast_lanes_or_sse2(
+				raycast_lanes_or_sse2(raycast_lanes_lt_sse2(map_x, zero), raycast_lanes_ge_sse2(map_x, width)),
+				raycast_lanes_or_sse2(raycast_lanes_lt_sse2(map_y, zero), raycast_lanes_ge_sse2(map_y, height)));
+
+			raycast_lanes_sse2_t hit;
+			if (plain) {
+				hit = raycast_lanes_read_map_sse2(scene, map_x, map_y, raycast_lanes_andnot_sse2(outside, all));
+			} else {
+				// cells of a tiled map are found through its chunk index, they are read one by one for the lanes still going
+				raycast_lanes_store_sse2(lanes.map_x, map_x);
+				raycast_lanes_store_sse2(lanes.map_y, map_y);
+				raycast_lanes_read_cells(&lanes, scene, raycast_lanes_movemask_sse2(raycast_lanes_andnot_sse2(raycast_lanes_or_sse2(stopped, outside), all)), RAYCAST_LANES_SSE2);
+				hit = raycast_lanes_gt_sse2(raycast_lanes_load_sse2(lanes.cells), zero);
+			}
+
+			raycast_lanes_sse2_t stopping = raycast_lanes_andnot_sse2(stopped, raycast_lanes_or_sse2(outside, hit));
+			stop_map_x = raycast_lanes_blend_sse2(stop_map_x, map_x, stopping);
+			stop_map_y = raycast_lanes_blend_sse2(stop_map_y, map_y, stopping);
+			stop_side_dist_x = raycast_lanes_blend_sse2(stop_side_dist_x, side_dist_x, stopping);
+			stop_side_dist_y = raycast_lanes_blend_sse2(stop_side_dist_y, side_dist_y, stopping);
+			stop_side = raycast_lanes_blend_sse2(stop_side, along_y, stopping);
+			stopped = raycast_lanes_or_sse2(stopped, stopping);
+		}
+
+		raycast_lanes_store_sse2(lanes.map_x, stop_map_x);
+		raycast_lanes_store_sse2(lanes.map_y, stop_map_y);
+		raycast_lanes_store_sse2(lanes.side_dist_x, stop_side_dist_x);
+		raycast_lanes_store_sse2(lanes.side_dist_y, stop_side_dist_y);
+		raycast_lanes_finish(hit_info + first, scene, rays + first, &lanes, group, raycast_lanes_movemask_sse2(stop_side));
+	}
+}
+
+/*
+reads the cells of the lanes in inside as a mask of the lanes that hit a wall, the map is read with gathers,
+every lane reads the 4 bytes starting at its cell, or at the 4th last cell so nothing past the map is read,
+and shifts its cell down, lanes outside inside read nothing
+*/
+__attribute__((target("avx2")))
+static inline raycast_lanes_avx2_t raycast_lanes_gather_avx2(const raycast_scene_t* scene, raycast_lanes_avx2_t map_x, raycast_lanes_avx2_t map_y, raycast_lanes_avx2_t inside) {
+	const int *map = (const int *)scene->world_map;
+	int last_word = (int)(scene->world_width * scene->world_height - 4);
+
+#ifdef RAYCAST_PRECISION_FLOAT
+	__m256i cell = _mm256_add_epi32(_mm256_cvttps_epi32(map_x), _mm256_mullo_epi32(_mm256_cvttps_epi32(map_y), _mm256_set1_epi32(scene->world_width)));
+	__m256i word = _mm256_min_epi32(cell, _mm256_set1_epi32(last_word));
+	__m256i shift = _mm256_slli_epi32(_mm256_sub_epi32(cell, word), 3);
+
+	__m256i bytes = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), map, word, _mm256_castps_si256(inside), 1);
+	__m256i wall = _mm256_and_si256(_mm256_srlv_epi32(bytes, shift), _mm256_set1_epi32(0xFF));
+
+	return _mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpeq_epi32(wall, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+#else
+	// the 64 bit masks of the lanes are packed into 32 bits for the 32 bit gather
+	__m128i mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(inside), _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)));
+
+	__m128i cell = _mm_add_epi32(_mm256_cvttpd_epi32(map_x), _mm_mullo_epi32(_mm256_cvttpd_epi32(map_y), _mm_set1_epi32(scene->world_width)));
+	__m128i word = _mm_min_epi32(cell, _mm_set1_epi32(last_word));
+	__m128i shift = _mm_slli_epi32(_mm_sub_epi32(cell, word), 3);
+
+	__m128i bytes = _mm_mask_i32gather_epi32(_mm_setzero_si128(), map, word, mask, 1);
+	__m128i wall = _mm_and_si128(_mm_srlv_epi32(bytes, shift), _mm_set1_epi32(0xFF));
+
+	return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_andnot_si128(_mm_cmpeq_epi32(wall, _mm_setzero_si128()), _mm_set1_epi32(-1))));
+#endif
+}
+
+__attribute__((target("avx2")))
+static void raycast_DDA_rays_avx2(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_ray_t* rays, uint32_t count) {
+	raycast_lanes_t lanes;
+
+	raycast_lanes_avx2_t zero = raycast_lanes_set1_avx2(0);
+	raycast_lanes_avx2_t all = raycast_lanes_ge_avx2(zero, zero);
+	raycast_lanes_avx2_t width = raycast_lanes_set1_avx2((raycast_real_t)scene->world_width);
+	raycast_lanes_avx2_t height = raycast_lanes_set1_avx2((raycast_real_t)scene->world_height);
+
+	// the gather needs a plain map with at least one word in it whose cells all have 32 bit indices
+	uint64_t cell_count = (uint64_t)scene->world_width * scene->world_height;
+	int gather = scene->tiled_map == NULL && cell_count >= 4 && cell_count <= INT32_MAX;
+
+	for (uint32_t first = 0; first < count; first += RAYCAST_LANES_AVX2) {
+		uint32_t group = count - first < RAYCAST_LANES_AVX2 ? count - first : RAYCAST_LANES_AVX2;
+		raycast_lanes_load(&lanes, rays + first, group, RAYCAST_LANES_AVX2);
+
+		raycast_lanes_avx2_t map_x = raycast_lanes_load_avx2(lanes.map_x);
+		raycast_lanes_avx2_t map_y = raycast_lanes_load_avx2(lanes.map_y);
+		raycast_lanes_avx2_t step_x = raycast_lanes_load_avx2(lanes.step_x);
+		raycast_lanes_avx2_t step_y = raycast_lanes_load_avx2(lanes.step_y);
+		raycast_lanes_avx2_t side_dist_x = raycast_lanes_load_avx2(lanes.side_dist_x);
+		raycast_lanes_avx2_t side_dist_y = raycast_lanes_load_avx2(lanes.side_dist_y);
+		raycast_lanes_avx2_t delta_dist_x = raycast_lanes_load_avx2(lanes.delta_dist_x);
+		raycast_lanes_avx2_t delta_dist_y = raycast_lanes_load_avx2(lanes.delta_dist_y);
+
+		// what each lane looked like the round it stopped, lanes past the group count as stopped from the start
+		raycast_lanes_avx2_t stopped = raycast_lanes_ge_avx2(raycast_lanes_load_avx2(lanes.lane), raycast_lanes_set1_avx2((raycast_real_t)group));
+		raycast_lanes_avx2_t stop_map_x = map_x, stop_map_y = map_y;
+		raycast_lanes_avx2_t stop_side_dist_x = side_dist_x, stop_side_dist_y = side_dist_y;
+		raycast_lanes_avx2_t stop_side = zero;
+
+		while (raycast_lanes_movemask_avx2(stopped) != (1 << RAYCAST_LANES_AVX2) - 1) {
+			// lanes whose next crossing is along y
+			raycast_lanes_avx2_t along_y = raycast_lanes_gt_avx2(side_dist_x, side_dist_y);
+
+			map_x = raycast_lanes_add_avx2(map_x, raycast_lanes_andnot_avx2(along_y, step_x));
+			map_y = raycast_lanes_add_avx2(map_y, raycast_lanes_and_avx2(along_y, step_y));
+			side_dist_x = raycast_lanes_add_avx2(side_dist_x, raycast_lanes_andnot_avx2(along_y, delta_dist_x));
+			side_dist_y = raycast_lanes_add_avx2(side_dist_y, raycast_lanes_and_avx2(along_y, delta_dist_y));
+
+			raycast_lanes_avx2_t outside = raycast_lanes_or_avx2(
+				raycast_lanes_or_avx2(raycast_lanes_lt_avx2(map_x, zero), raycast_lanes_ge_avx2(map_x, width)),
+				raycast_lanes_or_avx2(raycast_lanes_lt_avx2(map_y, zero), raycast_lanes_ge_avx2(map_y, height)));
+
+			raycast_lanes_avx2_t hit;
+			if (gather) {
+				hit = raycast_lanes_gather_avx2(scene, map_x, map_y, raycast_lanes_andnot_avx2(outside, all));
+			} else {
+				// cells of a tiled map are found through its chunk index, they are read one by one for the lanes still going
+				raycast_lanes_store_avx2(lanes.map_x, map_x);
+				raycast_lanes_store_avx2(lanes.map_y, map_y);
+				raycast_lanes_read_cells(&lanes, scene, raycast_lanes_movemask_avx2(raycast_lanes_andnot_avx2(raycast_lanes_or_avx2(stopped, outside), all)), RAYCAST_LANES_AVX2);
+				hit = raycast_lanes_gt_avx2(raycast_lanes_load_avx2(lanes.cells), zero);
+			}
+
+			raycast_lanes_avx2_t stopping = raycast_lanes_andnot_avx2(stopped, raycast_lanes_or_avx2(outside, hit));
+			stop_map_x = raycast_lanes_blend_avx2(stop_map_x, map_x, stopping);
+			stop_map_y = raycast_lanes_blend_avx2(stop_map_y, map_y, stopping);
+			stop_side_dist_x = raycast_lanes_blend_avx2(stop_side_dist_x, side_dist_x, stopping);
+			stop_side_dist_y = raycast_lanes_blend_avx2(stop_side_dist_y, side_dist_y, stopping);
+			stop_side = raycast_lanes_blend_avx2(stop_side, along_y, stopping);
+			stopped = raycast_lanes_or_avx2(stopped, stopping);
+		}
+
+		raycast_lanes_store_avx2(lanes.map_x, stop_map_x);
+		raycast_lanes_store_avx2(lanes.map_y, stop_map_y);
+		raycast_lanes_store_avx2(lanes.side_dist_x, stop_side_dist_x);
+		raycast_lanes_store_avx2(lanes.side_dist_y, stop_side_dist_y);
+		int side_bits = raycast_lanes_movemask_avx2(stop_side);
+
+		// raycast_lanes_finish is SSE code, clearing the upper halves first saves a state transition on every call
+		_mm256_zeroupper();
+		raycast_lanes_finish(hit_info + first, scene, rays + first, &lanes, group, side_bits);
+	}
+}
+
+#endif
+
+// the packet kernel used by raycast_DDA_packet and raycast_cast_rays
+static raycast_rays_kernel_t raycast_rays_kernel = raycast_DDA_rays_scalar;
+
+static void raycast_DDA_rays(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_ray_t* rays, uint32_t count) {
+	pthread_once(&raycast_kernels_once, raycast_select_kernels);
+	raycast_rays_kernel(hit_info, scene, rays, count);
+}
+
+void raycast_DDA_packet(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_real_t pos_x, raycast_real_t pos_y, const raycast_vector_t* directions, raycast_real_t initial_ray_length, uint32_t count) {
+	raycast_ray_t rays[RAYCAST_PACKET_SIZE];
+
+	for (uint32_t first = 0; first < count; first += RAYCAST_PACKET_SIZE) {
+		uint32_t lanes = count - first < RAYCAST_PACKET_SIZE ? count - first : RAYCAST_PACKET_SIZE;
+
+		for (uint32_t i = 0; i < lanes; i++) {
+			raycast_ray_setup(rays + i, pos_x, pos_y, directions[first + i].x, directions[first + i].y, initial_ray_length);
+		}
+
+		raycast_DDA_rays(hit_info + first, scene, rays, lanes);
+	}
+}
+
+void raycast_cast_ray(raycast_hit_info_t* hit_info, raycast_scene_t* scene, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y) {
+	raycast_real_t initial_ray_length = raycast_sqrt(dir_x * dir_x + dir_y * dir_y);
+
+	// cast ray
+	raycast_DDA(hit_info, scene, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+
+	// calculate the floating point location of where the ray hit
+	hit_info->hit_point.x = pos_x + dir_x / initial_ray_length * hit_info->distance;
+	hit_info->hit_point.y = pos_y + dir_y / initial_ray_length * hit_info->distance;
+}
+
+void raycast_cast_rays(raycast_hit_info_t* hit_info, raycast_scene_t* scene, const raycast_point_t* positions, const raycast_vector_t* directions, uint32_t count) {
+	raycast_ray_t rays[RAYCAST_PACKET_SIZE];
+	raycast_real_t lengths[RAYCAST_PACKET_SIZE];
+
+	for (uint32_t first = 0; first < count; first += RAYCAST_PACKET_SIZE) {
+		uint32_t lanes = count - first < RAYCAST_PACKET_SIZE ? count - first : RAYCAST_PACKET_SIZE;
+
+		for (uint32_t i = 0; i < lanes; i++) {
+			const raycast_vector_t *dir = directions + first + i;
+
+			lengths[i] = raycast_sqrt(dir->x * dir->x + dir->y * dir->y);
+			raycast_ray_setup(rays + i, positions[first + i].x, positions[first + i].y, dir->x, dir->y, lengths[i]);
+		}
+
+		raycast_DDA_rays(hit_info + first, scene, rays, lanes);
+
+		// calculate the floating point location of where each ray hit
+		for (uint32_t i = 0; i < lanes; i++) {
+			raycast_hit_info_t *hit = hit_info + first + i;
+			const raycast_vector_t *dir = directions + first + i;
+
+			hit->hit_point.x = positions[first + i].x + dir->x / lengths[i] * hit->distance;
+			hit->hit_point.y = positions[first + i].y + dir->y / lengths[i] * hit->distance;
+		}
+	}
+}
+
+int raycast_check_obstruction(raycast_scene_t* scene, raycast_real_t start_x, raycast_real_t start_y, raycast_real_t end_x, raycast_real_t end_y) {
+	// set up variables for DDA function
+	raycast_real_t dir_x = end_x - start_x;
+	raycast_real_t dir_y = end_y - start_y;
+
+	raycast_real_t between_length = raycast_sqrt(dir_x * dir_x + dir_y * dir_y);
+
+	raycast_ray_t ray;
+	raycast_ray_setup(&ray, start_x, start_y, dir_x, dir_y, between_length);
+
+	/*
+	walks like raycast_DDA but only up to the end point, the distance to every cell the ray enters only grows,
+	so once a cell is entered past the end point no wall after it can be in the way, without this a check on
+	an open map walks all the way to the far edge
+	*/
+	while (1) {
+		raycast_ray_step(&ray);
+
+		if (!(raycast_ray_distance(&ray) < between_length)) return 0;
+		if (raycast_ray_outside(&ray, scene)) return 1;
+		if (raycast_world_cell(scene, ray.map_x, ray.map_y) != 0) return 1;
+	}
+}
+
+// distance field functions
+
+int raycast_distance_field_init(raycast_distance_field_t* field, raycast_scene_t* scene) {
+	field->distances = NULL;
+	field->width = 0;
+	field->height = 0;
+
+	field->thread_count = 1;
+	field->thread_pool = NULL;
+
+	return raycast_distance_field_build(field, scene);
+}
+
+void raycast_distance_field_free(raycast_distance_field_t* field) {
+	raycast_thread_pool_free(field->thread_pool);
+	free(field->distances);
+
+	field->thread_pool = NULL;
+	field->thread_count = 1;
+	field->distances = NULL;
+	field->width = 0;
+	field->height = 0;
+}
+
+// distance of a neighbour plus one, cells off the map are walls and saturated distances stay saturated
+static inline uint8_t raycast_field_next(const raycast_distance_field_t* field, int x, int y) {
+	if (x < 0 || y < 0 || x >= (int)field->width || y >= (int)field->height) return 1;
+
+	uint8_t distance = field->distances[x + field->width * y];
+	return distance == 255 ? 255 : distance + 1;
+}
+
+static inline void raycast_field_relax(raycast_distance_field_t* field, int x, int y, int dx, int dy) {
+	uint8_t *distance = field->distances + x + field->width * y;
+	uint8_t next = raycast_field_next(field, x + dx, y + dy);
+
+	if (next < *distance) *distance = next;
+}
+
+/*
+two pass chessboard distance transform, the forward pass pulls distances from the
+row above and the cell to the left, the backward pass from the row below and the right
+*/
+int raycast_distance_field_build(raycast_distance_field_t* field, raycast_scene_t* scene) {
+	uint32_t cell_count = scene->world_width * scene->world_height;
+
+	uint8_t *distances = (uint8_t *) realloc(field->distances, cell_count + 1);
+	if (distances == NULL) return -1;
+
+	field->distances = distances;
+	field->width = scene->world_width;
+	field->height = scene->world_height;
+
+	for (uint32_t y = 0; y < field->height; y++) {
+		for (uint32_t x = 0; x < field->width; x++) {
+			distances[x + field->width * y] = raycast_world_cell(scene, x, y) == 0 ? 255 : 0;
+		}
+	}
+
+	for (int y = 0; y < (int)field->height; y++) {
+		for (int x = 0; x < (int)field->width; x++) {
+			raycast_field_relax(field, x, y, -1, -1);
+			raycast_field_relax(field, x, y, 0, -1);
+			raycast_field_relax(field, x, y, 1, -1);
+			raycast_field_relax(field, x, y, -1, 0);
+		}
+	}
+
+	for (int y = (int)field->height - 1; y >= 0; y--) {
+		for (int x = (int)field->width - 1; x >= 0; x--) {
+			raycast_field_relax(field, x, y, 1, 1);
+			raycast_field_relax(field, x, y, 0, 1);
+			raycast_field_relax(field, x, y, -1, 1);
+			raycast_field_relax(field, x, y, 1, 0);
+		}
+	}
+
+	return 0;
+}
+
+int raycast_distance_field_set_thread_count(raycast_distance_field_t* field, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	raycast_thread_pool_free(field->thread_pool);
+	field->thread_pool = raycast_thread_pool_create(thread_count);
+
+	if (field->thread_pool == NULL) {
+		field->thread_count = 1;
+		return -1;
+	}
+
+	field->thread_count = thread_count;
+	return 0;
+}
+
+// number of steps in [0, limit] a jump can take along one axis, NaN and negative counts become 0
+static inline int raycast_jump_count(raycast_real_t count, int limit) {
+	if (!(count > 0)) return 0;
+	if (count > limit) return limit;
+	return (int)count;
+}
+
+/*
+every cell within reach - 1 cells (chessboard distance) of the ray's cell is empty, so the ray moves
+straight to the last of those cells it would pass through, the axis that leaves the square first takes
+all of its steps and the other axis takes one step fewer than it could so rounding never lets it pass a
+crossing the DDA wouldn't have, the steps it is short are taken by the normal DDA inside the empty square
+*/
+static inline void raycast_ray_jump(raycast_ray_t* ray, int reach) {
+	int steps = reach - 1;
+
+	raycast_real_t side_x = raycast_from_dda(ray->side_dist_x);
+	raycast_real_t side_y = raycast_from_dda(ray->side_dist_y);
+	raycast_real_t delta_x = raycast_from_dda(ray->delta_dist_x);
+	raycast_real_t delta_y = raycast_from_dda(ray->delta_dist_y);
+
+	// side distances of the crossings that would leave the square on each axis
+	raycast_real_t exit_x = side_x + steps * delta_x;
+	raycast_real_t exit_y = side_y + steps * delta_y;
+
+	int steps_x, steps_y;
+	if (exit_x > exit_y) {
+		steps_y = steps;
+		steps_x = raycast_jump_count(raycast_floor((exit_y - side_x) / delta_x), steps);
+	} else {
+		steps_x = steps;
+		steps_y = raycast_jump_count(raycast_floor((exit_x - side_y) / delta_y), steps);
+	}
+
+	ray->map_x += steps_x * ray->step_x;
+	ray->map_y += steps_y * ray->step_y;
+	ray->side_dist_x += steps_x * ray->delta_dist_x;
+	ray->side_dist_y += steps_y * ray->delta_dist_y;
+}
+
+// returns 1 if the field was built from a map the size of the scene's, a field built from another map would let rays jump through walls
+static inline int raycast_field_fits(const raycast_distance_field_t* field, const raycast_scene_t* scene) {
+	return field != NULL && field->distances != NULL && field->width == scene->world_width && field->height == scene->world_height;
+}
+
+void raycast_DDA_field(raycast_hit_info_t* hit_info, raycast_scene_t* scene, const raycast_distance_field_t* field, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t initial_ray_length) {
+	if (!raycast_field_fits(field, scene)) {
+		raycast_DDA(hit_info, scene, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+		return;
+	}
+
+	raycast_ray_t ray;
+	raycast_ray_setup(&ray, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+
+	uint8_t hit = 0;
+
+	// a ray starting off the map takes normal steps until it stops
+	uint8_t reach = raycast_ray_outside(&ray, scene) ? 0 : field->distances[ray.map_x + field->width * ray.map_y];
+
+	while (1) {
+		if (reach > 1) raycast_ray_jump(&ray, reach);
+
+		raycast_ray_step(&ray);
+
+		if (raycast_ray_outside(&ray, scene)) break;
+
+		hit = raycast_world_cell(scene, ray.map_x, ray.map_y);
+		if (hit != 0) break;
+
+		reach = field->distances[ray.map_x + field->width * ray.map_y];
+	}
+
+	raycast_ray_finish(hit_info, &ray, hit);
+}
+
+void raycast_cast_ray_field(raycast_hit_info_t* hit_info, raycast_scene_t* scene, const raycast_distance_field_t* field, raycast_real_t pos_x, raycast_real_t pos_y, raycast_real_t dir_x, raycast_real_t dir_y) {
+	raycast_real_t initial_ray_length = raycast_sqrt(dir_x * dir_x + dir_y * dir_y);
+
+	raycast_DDA_field(hit_info, scene, field, pos_x, pos_y, dir_x, dir_y, initial_ray_length);
+
+	hit_info->hit_point.x = pos_x + dir_x / initial_ray_length * hit_info->distance;
+	hit_info->hit_point.y = pos_y + dir_y / initial_ray_length * hit_info->distance;
+}
+
+// arguments shared by every band of a batch of line of sight checks
+typedef struct {
+	const raycast_distance_field_t *field;
+	raycast_scene_t *scene;
+	const raycast_point_t *starts, *ends;
+	uint8_t *obstructed;
+	uint32_t count;
+} raycast_sight_job_t;
+
+static void raycast_check_obstructions_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_sight_job_t *job = (raycast_sight_job_t *)data;
+
+	uint32_t start = (uint32_t)((uint64_t)job->count * band / band_count);
+	uint32_t end = (uint32_t)((uint64_t)job->count * (band + 1) / band_count);
+
+	for (uint32_t i = start; i < end; i++) {
+		raycast_real_t dir_x = job->ends[i].x - job->starts[i].x;
+		raycast_real_t dir_y = job->ends[i].y - job->starts[i].y;
+
+		raycast_real_t between_length = raycast_sqrt(dir_x * dir_x + dir_y * dir_y);
+
+		raycast_hit_info_t hit_info;
+		raycast_DDA_field(&hit_info, job->scene, job->field, job->starts[i].x, job->starts[i].y, dir_x, dir_y, between_length);
+
+		job->obstructed[i] = hit_info.distance < between_length;
+	}
+}
+
+void raycast_check_obstructions(raycast_distance_field_t* field, raycast_scene_t* scene, const raycast_point_t* starts, const raycast_point_t* ends, uint8_t* obstructed, uint32_t count) {
+	raycast_sight_job_t job = {field, scene, starts, ends, obstructed, count};
+
+	// a few checks per band at least, tiny batches aren't worth waking the workers for
+	uint32_t band_count = field->thread_pool == NULL ? 1 : field->thread_count;
+	if (band_count > count / 16) band_count = count / 16 > 0 ? count / 16 : 1;
+
+	raycast_thread_pool_run(field->thread_pool, raycast_check_obstructions_task, &job, band_count);
+}
+
+// tiled map functions
+
+// bytes of the header at the start of a tiled map file, the index follows it
+#define RAYCAST_TILED_MAP_HEADER_SIZE 32
+
+// rounds a file offset up to where the next chunk can start
+static inline uint64_t raycast_tiled_map_align(uint64_t offset) {
+	return (offset + RAYCAST_TILED_MAP_ALIGNMENT - 1) / RAYCAST_TILED_MAP_ALIGNMENT * RAYCAST_TILED_MAP_ALIGNMENT;
+}
+
+// copies one chunk of every layer into chunk, cells past the edge of the map are 0, returns 1 if every cell is 0
+static int raycast_tiled_map_gather(uint8_t* chunk, const uint8_t* const* layers, uint32_t layer_count, uint32_t width, uint32_t height, uint32_t chunk_shift, uint32_t chunk_x, uint32_t chunk_y) {
+	uint32_t size = 1u << chunk_shift;
+	int empty = 1;
+
+	for (uint32_t layer = 0; layer < layer_count; layer++) {
+		for (uint32_t y = 0; y < size; y++) {
+			uint8_t *row = chunk + (((layer << chunk_shift) + y) << chunk_shift);
+			uint32_t map_y = (chunk_y << chunk_shift) + y;
+
+			for (uint32_t x = 0; x < size; x++) {
+				uint32_t map_x = (chunk_x << chunk_shift) + x;
+
+				row[x] = layers[layer] != NULL && map_x < width && map_y < height ? layers[layer][map_x + width * map_y] : 0;
+				if (row[x] != 0) empty = 0;
+			}
+		}
+	}
+
+	return empty;
+}
+
+/*
+the chunks are written as they are gathered, then the index is written over the gap
+left for it, so the map is only read once and only one chunk is held at a time
+*/
+int raycast_tiled_map_write(const char* path, const uint8_t* world_map, const uint8_t* floor_map, const uint8_t* ceiling_map, uint32_t width, uint32_t height, uint32_t chunk_shift) {
+	if (chunk_shift == 0 || chunk_shift > 12 || world_map == NULL || width == 0 || height == 0) return -1;
+
+	const uint8_t *layers[3] = {world_map, floor_map, ceiling_map};
+	uint32_t layer_count = ceiling_map != NULL ? 3 : floor_map != NULL ? 2 : 1;
+
+	uint32_t size = 1u << chunk_shift;
+	uint32_t chunks_x = (width + size - 1) >> chunk_shift;
+	uint32_t chunks_y = (height + size - 1) >> chunk_shift;
+	uint64_t chunk_count = (uint64_t)chunks_x * chunks_y;
+	uint64_t chunk_bytes = (uint64_t)layer_count << (2 * chunk_shift);
+	uint64_t chunk_stride = raycast_tiled_map_align(chunk_bytes);
+
+	uint64_t *offsets = (uint64_t *) malloc(chunk_count * sizeof(uint64_t));
+	uint8_t *chunk = (uint8_t *) calloc(chunk_stride, 1);
+	FILE *file = fopen(path, "wb");
+
+	int failed = offsets == NULL || chunk == NULL || file == NULL;
+
+	uint32_t header[8] = {RAYCAST_TILED_MAP_MAGIC, RAYCAST_TILED_MAP_VERSION, width, height, layer_count, chunk_shift, chunks_x, chunks_y};
+
+	// the empty chunk comes first, every chunk with only zero cells points at it
+	uint64_t empty_offset = raycast_tiled_map_align(RAYCAST_TILED_MAP_HEADER_SIZE + chunk_count * sizeof(uint64_t));
+	uint64_t next_offset = empty_offset + chunk_stride;
+
+	if (!failed) failed = fseeko(file, (off_t)empty_offset, SEEK_SET) != 0 || fwrite(chunk, 1, chunk_stride, file) != chunk_stride;
+
+	for (uint32_t chunk_y = 0; !failed && chunk_y < chunks_y; chunk_y++) {
+		for (uint32_t chunk_x = 0; !failed && chunk_x < chunks_x; chunk_x++) {
+			uint64_t *offset = offsets + chunk_x + (uint64_t)chunks_x * chunk_y;
+
+			if (raycast_tiled_map_gather(chunk, layers, layer_count, width, height, chunk_shift, chunk_x, chunk_y)) {
+				*offset = empty_offset;
+				continue;
+			}
+
+			*offset = next_offset;
+			next_offset += chunk_stride;
+			failed = fwrite(chunk, 1, chunk_stride, file) != chunk_stride;
+		}
+	}
+
+	if (!failed) {
+		failed = fseeko(file, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, file) != 1 ||
+			fwrite(offsets, sizeof(uint64_t), chunk_count, file) != chunk_count;
+	}
+
+	if (file != NULL && fclose(file) != 0) failed = 1;
+
+	free(offsets);
+	free(chunk);
+
+	return failed ? -1 : 0;
+}
+
+// checks the header and that every chunk the index points at is whole and aligned, returns -1 if not
+static int raycast_tiled_map_check(raycast_tiled_map_t* map) {
+	const uint32_t *header = (const uint32_t *)map->file;
+
+	if (header[0] != RAYCAST_TILED_MAP_MAGIC || header[1] != RAYCAST_TILED_MAP_VERSION) return -1;
+
+	map->width = header[2];
+	map->height = header[3];
+	map->layer_count = header[4];
+	map->chunk_shift = header[5];
+	map->chunks_x = header[6];
+	map->chunks_y = header[7];
+
+	uint32_t shift = map->chunk_shift;
+	if (map->width == 0 || map->height == 0 || map->layer_count == 0 || map->layer_count > 3 || shift == 0 || shift > 12) return -1;
+	if (map->chunks_x != (map->width + (1u << shift) - 1) >> shift || map->chunks_y != (map->height + (1u << shift) - 1) >> shift) return -1;
+
+	uint64_t chunk_count = (uint64_t)map->chunks_x * map->chunks_y;
+	uint64_t chunk_bytes = (uint64_t)map->layer_count << (2 * shift);
+	if (RAYCAST_TILED_MAP_HEADER_SIZE + chunk_count * sizeof(uint64_t) > map->file_size) return -1;
+
+	map->chunk_offsets = (const uint64_t *)(map->file + RAYCAST_TILED_MAP_HEADER_SIZE);
+
+	for (uint64_t i = 0; i < chunk_count; i++) {
+		uint64_t offset = map->chunk_offsets[i];
+		if (offset % RAYCAST_TILED_MAP_ALIGNMENT != 0 || offset > map->file_size || map->file_size - offset < chunk_bytes) return -1;
+	}
+
+	return 0;
+}
+
+int raycast_tiled_map_open(raycast_tiled_map_t* map, const char* path, uint32_t cache_size) {
+	map->file = NULL;
+	map->file_size = 0;
+	map->chunk_offsets = NULL;
+	map->width = 0;
+	map->height = 0;
+	map->layer_count = 0;
+	map->cache = NULL;
+	map->cache_frames = NULL;
+	map->cache_size = cache_size;
+	map->cache_count = 0;
+	map->frame = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return -1;
+
+	// the mapping keeps the file open on its own
+	struct stat info;
+	void *file = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size >= RAYCAST_TILED_MAP_HEADER_SIZE) file = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (file == MAP_FAILED) return -1;
+
+	map->file = (const uint8_t *)file;
+	map->file_size = info.st_size;
+
+	if (cache_size != 0) {
+		map->cache = (uint64_t *) malloc(cache_size * sizeof(uint64_t));
+		map->cache_frames = (uint32_t *) malloc(cache_size * sizeof(uint32_t));
+	}
+
+	if (raycast_tiled_map_check(map) != 0 || (cache_size != 0 && (map->cache == NULL || map->cache_frames == NULL))) {
+		raycast_tiled_map_close(map);
+		return -1;
+	}
+
+	// rays read cells all over the map, read ahead would load whole neighbourhoods of chunks nothing looks at
+	madvise(file, map->file_size, MADV_RANDOM);
+
+	return 0;
+}
+
+void raycast_tiled_map_close(raycast_tiled_map_t* map) {
+	if (map->file != NULL) munmap((void *)map->file, map->file_size);
+	free(map->cache);
+	free(map->cache_frames);
+
+	map->file = NULL;
+	map->file_size = 0;
+	map->chunk_offsets = NULL;
+	map->width = 0;
+	map->height = 0;
+	map->layer_count = 0;
+	map->cache = NULL;
+	map->cache_frames = NULL;
+	map->cache_size = 0;
+	map->cache_count = 0;
+}
+
+uint8_t raycast_tiled_map_cell(const raycast_tiled_map_t* map, raycast_layer_t layer, uint32_t x, uint32_t y) {
+	if (x >= map->width || y >= map->height || (uint32_t)layer >= map->layer_count) return 0;
+
+	return raycast_tiled_cell(map, layer, x, y);
+}
+
+// asks the system to load the pages of one chunk in the background, a page the chunk shares with a neighbour is loaded with it
+static void raycast_tiled_map_load(const raycast_tiled_map_t* map, uint64_t offset) {
+	uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+	uint64_t start = offset / page * page;
+	uint64_t end = (offset + ((uint64_t)map->layer_count << (2 * map->chunk_shift)) + page - 1) / page * page;
+
+	madvise((void *)(map->file + start), end - start, MADV_WILLNEED);
+}
+
+/*
+keeps the chunk at a world point resident for this frame, evicting the chunk that has gone longest without being
+kept when the cache is full, returns -1 if every chunk in the cache is already kept this frame so nothing is evicted
+*/
+static int raycast_tiled_map_keep(raycast_tiled_map_t* map, double x, double y) {
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height) return 0;
+
+	uint64_t offset = map->chunk_offsets[((uint32_t)x >> map->chunk_shift) + map->chunks_x * ((uint32_t)y >> map->chunk_shift)];
+	uint32_t oldest = 0;
+
+	for (uint32_t i = 0; i < map->cache_count; i++) {
+		if (map->cache[i] == offset) {
+			map->cache_frames[i] = map->frame;
+			return 0;
+		}
+
+		if (map->cache_frames[i] < map->cache_frames[oldest]) oldest = i;
+	}
+
+	uint32_t slot = map->cache_count;
+
+	if (map->cache_count < map->cache_size) {
+		map->cache_count++;
+	} else {
+		if (map->cache_frames[oldest] == map->frame) return -1;
+
+		// the chunk's pages go with the next raycast_tiled_map_drop
+		slot = oldest;
+	}
+
+	map->cache[slot] = offset;
+	map->cache_frames[slot] = map->frame;
+	raycast_tiled_map_load(map, offset);
+
+	return 0;
+}
+
+/*
+the chunks around the camera are kept first so turning around finds them loaded, then the view is walked
+outwards in rows across it half a chunk apart, with points half a chunk apart along each row, so no chunk
+the view passes over is missed and nearer chunks win when the cache can't hold the whole view
+*/
+static void raycast_tiled_map_keep_view(raycast_tiled_map_t* map, raycast_camera_t* camera, raycast_real_t distance) {
+	double chunk_size = 1u << map->chunk_shift;
+	double half_chunk = chunk_size / 2;
+	double x = camera->position.x;
+	double y = camera->position.y;
+
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			if (raycast_tiled_map_keep(map, x + dx * chunk_size, y + dy * chunk_size) == -1) return;
+		}
+	}
+
+	double focal_length = camera->focal_length;
+	double plane_x = camera->plane.x / focal_length;
+	double plane_y = camera->plane.y / focal_length;
+
+	for (double forward = half_chunk; forward <= distance; forward += half_chunk) {
+		int steps = (int)(camera->plane_length * forward / focal_length / half_chunk) + 1;
+
+		for (int i = 0; i <= steps; i++) {
+			double across = ((double)i / steps - 0.5) * forward;
+			double point_x = x + camera->direction.x * forward + plane_x * across;
+			double point_y = y + camera->direction.y * forward + plane_y * across;
+
+			if (raycast_tiled_map_keep(map, point_x, point_y) == -1) return;
+		}
+	}
+}
+
+/*
+drops every page of the file but the header, the index and the chunks in the cache, rays read cells all over the
+map, not only in the view, and each chunk they read stays paged in until dropped, the cache is kept sorted by file
+offset so the pages between its chunks go in one call per gap, it barely moves from frame to frame so sorting it
+by insertion is cheap
+*/
+static void raycast_tiled_map_drop(raycast_tiled_map_t* map) {
+	for (uint32_t i = 1; i < map->cache_count; i++) {
+		uint64_t offset = map->cache[i];
+		uint32_t frame = map->cache_frames[i];
+		uint32_t j = i;
+
+		for (; j > 0 && map->cache[j - 1] > offset; j--) {
+			map->cache[j] = map->cache[j - 1];
+			map->cache_frames[j] = map->cache_frames[j - 1];
+		}
+
+		map->cache[j] = offset;
+		map->cache_frames[j] = frame;
+	}
+
+	uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+	uint64_t chunk_bytes = (uint64_t)map->layer_count << (2 * map->chunk_shift);
+	uint64_t index_end = RAYCAST_TILED_MAP_HEADER_SIZE + (uint64_t)map->chunks_x * map->chunks_y * sizeof(uint64_t);
+	uint64_t start = (index_end + page - 1) / page * page;
+
+	for (uint32_t i = 0; i <= map->cache_count; i++) {
+		// pages a kept chunk shares with the gap stay
+		uint64_t end = i < map->cache_count ? map->cache[i] / page * page : (map->file_size + page - 1) / page * page;
+		if (start < end) madvise((void *)(map->file + start), end - start, MADV_DONTNEED);
+
+		if (i < map->cache_count) {
+			uint64_t next = (map->cache[i] + chunk_bytes + page - 1) / page * page;
+			if (next > start) start = next;
+		}
+	}
+}
+
+void raycast_tiled_map_stream(raycast_tiled_map_t* map, raycast_camera_t* camera, raycast_real_t distance) {
+	if (map->file == NULL || map->cache_size == 0) return;
+
+	map->frame++;
+
+	raycast_tiled_map_keep_view(map, camera, distance);
+	raycast_tiled_map_drop(map);
+}
+
+// visibility functions
+
+// the scene's visibility set if it has a built one that matches its map, NULL if nothing is culled with it
+static inline const raycast_visibility_t* raycast_scene_visibility(const raycast_scene_t* scene) {
+	const raycast_visibility_t *visibility = scene->visibility;
+
+	if (visibility == NULL || visibility->data == NULL) return NULL;
+	if (visibility->width != scene->world_width || visibility->height != scene->world_height) return NULL;
+
+	return visibility;
+}
+
+// 1 if a cell hides everything behind it, with cell heights only cells whose top reaches top_height do
+static inline int raycast_visibility_blocks(const raycast_scene_t* scene, uint32_t x, uint32_t y) {
+	uint8_t cell = raycast_world_cell(scene, x, y);
+
+	if (scene->cell_heights == NULL) return cell != 0;
+	return raycast_cell_top(scene, cell, x, y) >= scene->top_height;
+}
+
+// the set of a cell on the map, NULL if the cell blocked sight when it was built and sees everything
+static inline const uint32_t* raycast_visibility_set(const raycast_visibility_t* visibility, uint32_t x, uint32_t y) {
+	size_t cell = (size_t)x + (size_t)visibility->width * y;
+
+	if (visibility->offsets[cell] == visibility->offsets[cell + 1]) return NULL;
+	return visibility->data + visibility->offsets[cell];
+}
+
+// 1 if a set holds the cell (x, y), the unsigned subtractions send rows and words before the first ones past the end
+static inline int raycast_visibility_sees(const uint32_t* set, uint32_t x, uint32_t y) {
+	uint32_t row = y - set[0];
+	if (row >= set[1]) return 0;
+
+	const uint32_t *span = set + 2 + 3 * row;
+	uint32_t word = (x >> 5) - span[0];
+	if (word >= span[1]) return 0;
+
+	return (set[span[2] + word] >> (x & 31)) & 1;
+}
+
+// 1 if a set holds the cell of a point, points off the map might be seen
+static inline int raycast_visibility_sees_point(const raycast_visibility_t* visibility, const uint32_t* set, raycast_real_t x, raycast_real_t y) {
+	if (!(x >= 0 && y >= 0 && x < visibility->width && y < visibility->height)) return 1;
+
+	return raycast_visibility_sees(set, (uint32_t)x, (uint32_t)y);
+}
+
+// 1 if a set holds any cell under an object's sprite, which is size wide so it can reach out of the object's own cell
+static int raycast_visibility_sees_object(const raycast_visibility_t* visibility, const uint32_t* set, const raycast_object_t* object) {
+	raycast_real_t half_size = raycast_fabs(object->size) / 2;
+
+	raycast_real_t min_x = object->position.x - half_size;
+	raycast_real_t min_y = object->position.y - half_size;
+	raycast_real_t max_x = object->position.x + half_size;
+	raycast_real_t max_y = object->position.y + half_size;
+
+	if (!(min_x >= 0 && min_y >= 0 && max_x < visibility->width && max_y < visibility->height)) return 1;
+
+	for (uint32_t y = (uint32_t)min_y; y <= (uint32_t)max_y; y++) {
+		for (uint32_t x = (uint32_t)min_x; x <= (uint32_t)max_x; x++) {
+			if (raycast_visibility_sees(set, x, y)) return 1;
+		}
+	}
+
+	return 0;
+}
+
+// the set of the cell a camera stands in, NULL if it stands off the map or in a blocking cell and sees everything
+static const uint32_t* raycast_visibility_camera_set(const raycast_visibility_t* visibility, const raycast_camera_t* camera) {
+	if (!(camera->position.x >= 0 && camera->position.y >= 0 && camera->position.x < visibility->width && camera->position.y < visibility->height)) return NULL;
+
+	return raycast_visibility_set(visibility, (uint32_t)camera->position.x, (uint32_t)camera->position.y);
+}
+
+void raycast_visibility_init(raycast_visibility_t* visibility) {
+	visibility->data = NULL;
+	visibility->offsets = NULL;
+	visibility->width = 0;
+	visibility->height = 0;
+
+	visibility->max_distance = 0;
+
+	visibility->version = 0;
+	visibility->thread_count = 1;
+	visibility->thread_pool = NULL;
+}
+
+void raycast_visibility_free(raycast_visibility_t* visibility) {
+	raycast_thread_pool_free(visibility->thread_pool);
+	free(visibility->data);
+	free(visibility->offsets);
+
+	visibility->data = NULL;
+	visibility->offsets = NULL;
+	visibility->width = 0;
+	visibility->height = 0;
+
+	visibility->thread_count = 1;
+	visibility->thread_pool = NULL;
+}
+
+int raycast_visibility_set_thread_count(raycast_visibility_t* visibility, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	raycast_thread_pool_free(visibility->thread_pool);
+	visibility->thread_pool = raycast_thread_pool_create(thread_count);
+
+	if (visibility->thread_pool == NULL) {
+		visibility->thread_count = 1;
+		return -1;
+	}
+
+	visibility->thread_count = thread_count;
+	return 0;
+}
+
+// the sets a band of map rows builds, back to back, offsets of its cells are into them until they are joined
+typedef struct {
+	uint32_t *data;
+	size_t size, capacity;
+	int failed;
+} raycast_visibility_band_t;
+
+typedef struct {
+	raycast_visibility_t *visibility;
+	raycast_scene_t *scene;
+	int radius;
+	raycast_visibility_band_t *bands;
+} raycast_visibility_job_t;
+
+// makes room for count more words in a band's sets, returns NULL on failure
+static uint32_t* raycast_visibility_grow(raycast_visibility_band_t* band, size_t count) {
+	if (band->size + count > band->capacity) {
+		size_t capacity = band->capacity * 2 > band->size + count ? band->capacity * 2 : band->size + count + 1024;
+
+		uint32_t *data = (uint32_t *) realloc(band->data, capacity * sizeof(uint32_t));
+		if (data == NULL) return NULL;
+
+		band->data = data;
+		band->capacity = capacity;
+	}
+
+	uint32_t *words = band->data + band->size;
+	band->size += count;
+	return words;
+}
+
+// one side of a wedge of sight lines, the line through the cell corners (x0, y0) and (x1, y1) of a quadrant
+typedef struct {
+	int x0, y0, x1, y1;
+} raycast_sight_line_t;
+
+// a wall corner a sight line was bent around, parent is the one it was bent around before or -1
+typedef struct {
+	int x, y, parent;
+} raycast_sight_bump_t;
+
+// a wedge of sight lines still open, from its shallow line to its steep one, the bumps are the last ones of each line or -1
+typedef struct {
+	raycast_sight_line_t shallow, steep;
+	int shallow_bump, steep_bump;
+} raycast_sight_view_t;
+
+// memory of the sweeps of one band, it only grows and is kept from cell to cell
+typedef struct {
+	raycast_sight_view_t *views;
+	raycast_sight_bump_t *bumps;
+	uint32_t view_count, view_capacity;
+	uint32_t bump_count, bump_capacity;
+} raycast_visibility_scratch_t;
+
+// positive if corner (x, y) is on the steep side of a line, 0 if on it and negative if on the shallow side
+static inline int64_t raycast_sight_line_side(const raycast_sight_line_t* line, int x, int y) {
+	return (int64_t)(line->y1 - line->y0) * (line->x1 - x) - (int64_t)(line->x1 - line->x0) * (line->y1 - y);
+}
+
+// makes room for the view and two bumps a wall can add, returns -1 on failure to allocate
+static int raycast_visibility_reserve(raycast_visibility_scratch_t* scratch) {
+	if (scratch->view_count + 1 > scratch->view_capacity) {
+		uint32_t capacity = scratch->view_capacity * 2 + 16;
+
+		raycast_sight_view_t *views = (raycast_sight_view_t *) realloc(scratch->views, capacity * sizeof(raycast_sight_view_t));
+		if (views == NULL) return -1;
+
+		scratch->views = views;
+		scratch->view_capacity = capacity;
+	}
+
+	if (scratch->bump_count + 2 > scratch->bump_capacity) {
+		uint32_t capacity = scratch->bump_capacity * 2 + 32;
+
+		raycast_sight_bump_t *bumps = (raycast_sight_bump_t *) realloc(scratch->bumps, capacity * sizeof(raycast_sight_bump_t));
+		if (bumps == NULL) return -1;
+
+		scratch->bumps = bumps;
+		scratch->bump_capacity = capacity;
+	}
+
+	return 0;
+}
+
+// bends the shallow line of a view up to wall corner (x, y), then back down past the corners its steep line was bent around
+static void raycast_visibility_shallow_bump(raycast_visibility_scratch_t* scratch, uint32_t index, int x, int y) {
+	raycast_sight_view_t *view = scratch->views + index;
+	view->shallow.x1 = x;
+	view->shallow.y1 = y;
+
+	scratch->bumps[scratch->bump_count] = (raycast_sight_bump_t){x, y, view->shallow_bump};
+	view->shallow_bump = (int)scratch->bump_count++;
+
+	for (int i = view->steep_bump; i != -1; i = scratch->bumps[i].parent) {
+		if (raycast_sight_line_side(&view->shallow, scratch->bumps[i].x, scratch->bumps[i].y) < 0) {
+			view->shallow.x0 = scratch->bumps[i].x;
+			view->shallow.y0 = scratch->bumps[i].y;
+		}
+	}
+}
+
+// the other way round, bends the steep line of a view down to wall corner (x, y)
+static void raycast_visibility_steep_bump(raycast_visibility_scratch_t* scratch, uint32_t index, int x, int y) {
+	raycast_sight_view_t *view = scratch->views + index;
+	view->steep.x1 = x;
+	view->steep.y1 = y;
+
+	scratch->bumps[scratch->bump_count] = (raycast_sight_bump_t){x, y, view->steep_bump};
+	view->steep_bump = (int)scratch->bump_count++;
+
+	for (int i = view->shallow_bump; i != -1; i = scratch->bumps[i].parent) {
+		if (raycast_sight_line_side(&view->steep, scratch->bumps[i].x, scratch->bumps[i].y) > 0) {
+			view->steep.x0 = scratch->bumps[i].x;
+			view->steep.y0 = scratch->bumps[i].y;
+		}
+	}
+}
+
+// drops a view whose lines were bent onto each other through a corner of the source cell, returns 0 if it was dropped
+static int raycast_visibility_check_view(raycast_visibility_scratch_t* scratch, uint32_t index) {
+	raycast_sight_view_t *view = scratch->views + index;
+
+	int collinear = raycast_sight_line_side(&view->shallow, view->steep.x0, view->steep.y0) == 0 && raycast_sight_line_side(&view->shallow, view->steep.x1, view->steep.y1) == 0;
+	if (!collinear) return 1;
+	if (raycast_sight_line_side(&view->shallow, 0, 1) != 0 && raycast_sight_line_side(&view->shallow, 1, 0) != 0) return 1;
+
+	memmove(view, view + 1, (scratch->view_count - index - 1) * sizeof(raycast_sight_view_t));
+	scratch->view_count--;
+	return 0;
+}
+
+/*
+marks the cells of one quadrant of the window that a straight line from anywhere in cell (x, y) reaches without
+passing through a blocking cell (touching its corner or side is fine), a precise permissive field of view, the quadrant
+is mirrored so its cells lie at (dx, dy) >= 0 with their corners on whole numbers, each is visited once in rows of
+growing dx + dy against the list of wedges of lines still open, a wall in a wedge bends the side it cuts into around
+its corner, or splits the wedge in two if it cuts neither, returns the furthest step on either axis to a marked cell
+or -1 on failure to allocate
+*/
+static int raycast_visibility_sweep(const raycast_visibility_job_t* job, raycast_visibility_scratch_t* scratch, uint8_t* marks, int x, int y, int min_x, int min_y, int window_width, int sign_x, int sign_y, int extent_x, int extent_y) {
+	raycast_real_t max_distance = job->visibility->max_distance;
+	int reach = 0;
+
+	// the first wedge holds every line out of the cell, its sides start on the cell's far corners and end past the window
+	int far = (extent_x > extent_y ? extent_x : extent_y) + 1;
+
+	scratch->view_count = 0;
+	if (raycast_visibility_reserve(scratch) == -1) return -1;
+
+	scratch->views[0] = (raycast_sight_view_t){{0, 1, far, 0}, {1, 0, 0, far}, -1, -1};
+	scratch->view_count = 1;
+	scratch->bump_count = 0;
+
+	for (int i = 1; i <= extent_x + extent_y && scratch->view_count > 0; i++) {
+		int first_j = i - extent_x > 0 ? i - extent_x : 0;
+		int last_j = i < extent_y ? i : extent_y;
+
+		for (int j = first_j; j <= last_j && scratch->view_count > 0; j++) {
+			int dx = i - j;
+			int dy = j;
+
+			// the wedge the cell's far corner on the shallow side is in, cells between two wedges are hidden
+			uint32_t index = 0;
+			while (index < scratch->view_count && raycast_sight_line_side(&scratch->views[index].steep, dx + 1, dy) >= 0) index++;
+			if (index == scratch->view_count || raycast_sight_line_side(&scratch->views[index].shallow, dx, dy + 1) <= 0) continue;
+
+			int cell_x = x + sign_x * dx;
+			int cell_y = y + sign_y * dy;
+
+			if (max_distance <= 0 || dx * dx + dy * dy <= max_distance * max_distance) {
+				marks[(cell_x - min_x) + window_width * (cell_y - min_y)] = 1;
+
+				int step = dx > dy ? dx : dy;
+				if (step > reach) reach = step;
+			}
+
+			if (!raycast_visibility_blocks(job->scene, cell_x, cell_y)) continue;
+			if (raycast_visibility_reserve(scratch) == -1) return -1;
+
+			raycast_sight_view_t *view = scratch->views + index;
+			int cuts_shallow = raycast_sight_line_side(&view->shallow, dx + 1, dy) < 0;
+			int cuts_steep = raycast_sight_line_side(&view->steep, dx, dy + 1) > 0;
+
+			if (cuts_shallow && cuts_steep) {
+				memmove(view, view + 1, (scratch->view_count - index - 1) * sizeof(raycast_sight_view_t));
+				scratch->view_count--;
+			} else if (cuts_shallow) {
+				raycast_visibility_shallow_bump(scratch, index, dx, dy + 1);
+				raycast_visibility_check_view(scratch, index);
+			} else if (cuts_steep) {
+				raycast_visibility_steep_bump(scratch, index, dx + 1, dy);
+				raycast_visibility_check_view(scratch, index);
+			} else {
+				// the wall splits the wedge, the copy at index keeps the shallow side and the one after it the steep side
+				memmove(view + 1, view, (scratch->view_count - index) * sizeof(raycast_sight_view_t));
+				scratch->view_count++;
+
+				uint32_t steep_index = index + 1;
+
+				raycast_visibility_steep_bump(scratch, index, dx + 1, dy);
+				if (!raycast_visibility_check_view(scratch, index)) steep_index--;
+
+				raycast_visibility_shallow_bump(scratch, steep_index, dx, dy + 1);
+				raycast_visibility_check_view(scratch, steep_index);
+			}
+		}
+	}
+
+	return reach;
+}
+
+// marks the cells seen from cell (x, y) in its window of marks, returns the furthest step on either axis to a marked one or -1 on failure
+static int raycast_visibility_mark(const raycast_visibility_job_t* job, raycast_visibility_scratch_t* scratch, uint8_t* marks, int x, int y, int min_x, int min_y, int window_width, int window_height) {
+	marks[(x - min_x) + window_width * (y - min_y)] = 1;
+
+	int max_x = min_x + window_width - 1;
+	int max_y = min_y + window_height - 1;
+	int reach = 0;
+
+	// the quadrants overlap on the rows and columns through (x, y), which are seen from either side alike
+	for (int quadrant = 0; quadrant < 4; quadrant++) {
+		int sign_x = (quadrant & 1) ? -1 : 1;
+		int sign_y = (quadrant & 2) ? -1 : 1;
+		int extent_x = sign_x > 0 ? max_x - x : x - min_x;
+		int extent_y = sign_y > 0 ? max_y - y : y - min_y;
+
+		int quadrant_reach = raycast_visibility_sweep(job, scratch, marks, x, y, min_x, min_y, window_width, sign_x, sign_y, extent_x, extent_y);
+		if (quadrant_reach == -1) return -1;
+		if (quadrant_reach > reach) reach = quadrant_reach;
+	}
+
+	// only the box of cells up to one step past the furthest seen one can be marked, the rest of the window is left alone
+	int reach_seen = reach + 1;
+	int first_column = x - min_x - reach_seen > 0 ? x - min_x - reach_seen : 0;
+	int first_row = y - min_y - reach_seen > 0 ? y - min_y - reach_seen : 0;
+	int last_column = x - min_x + reach_seen < window_width - 1 ? x - min_x + reach_seen : window_width - 1;
+	int last_row = y - min_y + reach_seen < window_height - 1 ? y - min_y + reach_seen : window_height - 1;
+
+	/*
+	the renderer's rays are rounded, so one grazing a wall corner can end up in a cell next to a seen one, those are
+	counted as seen too, marked 2 at first so the margin doesn't spread from cells it added
+	*/
+	for (int row = first_row; row <= last_row; row++) {
+		for (int column = first_column; column <= last_column; column++) {
+			uint8_t *mark = marks + column + window_width * row;
+			if (*mark != 0) continue;
+
+			for (int dy = -1; dy <= 1 && *mark == 0; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					int next_x = column + dx;
+					int next_y = row + dy;
+
+					if (next_x >= 0 && next_y >= 0 && next_x < window_width && next_y < window_height && marks[next_x + window_width * next_y] == 1) {
+						*mark = 2;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	for (int row = first_row; row <= last_row; row++) {
+		for (int column = first_column; column <= last_column; column++) {
+			if (marks[column + window_width * row] == 2) marks[column + window_width * row] = 1;
+		}
+	}
+
+	return reach_seen;
+}
+
+// appends the set of the cell the marks were made for to a band, rows of marks are stride apart, returns -1 on failure to allocate
+static int raycast_visibility_encode(raycast_visibility_band_t* band, const uint8_t* marks, size_t stride, int min_x, int min_y, int window_width, int window_height) {
+	int first_row = window_height;
+	int last_row = -1;
+
+	for (int row = 0; row < window_height; row++) {
+		if (memchr(marks + stride * row, 1, window_width) == NULL) continue;
+
+		if (row < first_row) first_row = row;
+		last_row = row;
+	}
+
+	uint32_t row_count = (uint32_t)(last_row - first_row + 1);
+	size_t start = band->size;
+
+	uint32_t *header = raycast_visibility_grow(band, 2 + 3 * (size_t)row_count);
+	if (header == NULL) return -1;
+
+	header[0] = (uint32_t)(min_y + first_row);
+	header[1] = row_count;
+
+	for (uint32_t i = 0; i < row_count; i++) {
+		const uint8_t *row = marks + stride * (first_row + i);
+		int first = window_width;
+		int last = -1;
+
+		for (int column = 0; column < window_width; column++) {
+			if (!row[column]) continue;
+
+			if (column < first) first = column;
+			last = column;
+		}
+
+		// the band can move while it grows, so the header is found again from its start every time
+		uint32_t first_word = last < 0 ? 0 : (uint32_t)(min_x + first) >> 5;
+		uint32_t word_count = last < 0 ? 0 : ((uint32_t)(min_x + last) >> 5) - first_word + 1;
+		uint32_t offset = (uint32_t)(band->size - start);
+
+		uint32_t *words = raycast_visibility_grow(band, word_count);
+		if (words == NULL) return -1;
+
+		memset(words, 0, word_count * sizeof(uint32_t));
+		for (int column = first; column <= last; column++) {
+			uint32_t map_x = (uint32_t)(min_x + column);
+			if (row[column]) words[(map_x >> 5) - first_word] |= 1u << (map_x & 31);
+		}
+
+		uint32_t *span = band->data + start + 2 + 3 * i;
+		span[0] = first_word;
+		span[1] = word_count;
+		span[2] = offset;
+	}
+
+	return 0;
+}
+
+static void raycast_visibility_task(void* data, uint32_t band_index, uint32_t band_count) {
+	raycast_visibility_job_t *job = (raycast_visibility_job_t *)data;
+	raycast_visibility_t *visibility = job->visibility;
+	raycast_visibility_band_t *band = job->bands + band_index;
+
+	int width = (int)visibility->width;
+	int height = (int)visibility->height;
+	int radius = job->radius;
+
+	int start = (int)((int64_t)height * band_index / band_count);
+	int end = (int)((int64_t)height * (band_index + 1) / band_count);
+
+	int window_side_x = 2 * radius + 1 < width ? 2 * radius + 1 : width;
+	int window_side_y = 2 * radius + 1 < height ? 2 * radius + 1 : height;
+
+	// every cell's marks are cleared again after it is encoded, so only the cells it saw are touched
+	uint8_t *marks = (uint8_t *) calloc((size_t)window_side_x * window_side_y, 1);
+	raycast_visibility_scratch_t scratch = {NULL, NULL, 0, 0, 0, 0};
+
+	if (marks == NULL) {
+		band->failed = 1;
+		return;
+	}
+
+	for (int y = start; y < end && !band->failed; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t cell = (size_t)x + (size_t)width * y;
+			visibility->offsets[cell] = band->size;
+
+			// blocking cells see everything, which an empty set stands for
+			if (raycast_visibility_blocks(job->scene, x, y)) continue;
+
+			int min_x = x - radius > 0 ? x - radius : 0;
+			int min_y = y - radius > 0 ? y - radius : 0;
+			int window_width = (x + radius < width ? x + radius : width - 1) - min_x + 1;
+			int window_height = (y + radius < height ? y + radius : height - 1) - min_y + 1;
+
+			int reach = raycast_visibility_mark(job, &scratch, marks, x, y, min_x, min_y, window_width, window_height);
+			if (reach == -1) {
+				band->failed = 1;
+				break;
+			}
+
+			// the box of the window the marks went in
+			int box_min_x = x - reach > min_x ? x - reach : min_x;
+			int box_min_y = y - reach > min_y ? y - reach : min_y;
+			int box_width = (x + reach < min_x + window_width - 1 ? x + reach : min_x + window_width - 1) - box_min_x + 1;
+			int box_height = (y + reach < min_y + window_height - 1 ? y + reach : min_y + window_height - 1) - box_min_y + 1;
+			uint8_t *box = marks + (box_min_x - min_x) + (size_t)window_width * (box_min_y - min_y);
+
+			if (raycast_visibility_encode(band, box, window_width, box_min_x, box_min_y, box_width, box_height) == -1) {
+				band->failed = 1;
+				break;
+			}
+
+			for (int row = 0; row < box_height; row++) {
+				memset(box + (size_t)window_width * row, 0, box_width);
+			}
+		}
+	}
+
+	free(scratch.views);
+	free(scratch.bumps);
+	free(marks);
+}
+
+int raycast_visibility_build(raycast_visibility_t* visibility, raycast_scene_t* scene) {
+	free(visibility->data);
+	free(visibility->offsets);
+
+	visibility->data = NULL;
+	visibility->offsets = NULL;
+	visibility->width = scene->world_width;
+	visibility->height = scene->world_height;
+	visibility->version++;
+
+	if (scene->world_map == NULL && scene->tiled_map == NULL) return -1;
+
+	size_t cell_count = (size_t)scene->world_width * scene->world_height;
+
+	uint32_t band_count = visibility->thread_pool == NULL ? 1 : visibility->thread_count;
+	if (band_count > scene->world_height) band_count = scene->world_height > 0 ? scene->world_height : 1;
+
+	visibility->offsets = (uint64_t *) malloc((cell_count + 1) * sizeof(uint64_t));
+	raycast_visibility_band_t *bands = (raycast_visibility_band_t *) calloc(band_count, sizeof(raycast_visibility_band_t));
+
+	if (visibility->offsets == NULL || bands == NULL) {
+		free(bands);
+		free(visibility->offsets);
+		visibility->offsets = NULL;
+		return -1;
+	}
+
+	// with no max_distance the window around every cell covers the whole map
+	uint32_t side = scene->world_width > scene->world_height ? scene->world_width : scene->world_height;
+	int radius = (int)side;
+	if (visibility->max_distance > 0 && visibility->max_distance < side) radius = (int)visibility->max_distance + 1;
+
+	raycast_visibility_job_t job = {visibility, scene, radius, bands};
+	raycast_thread_pool_run(visibility->thread_pool, raycast_visibility_task, &job, band_count);
+
+	// join the bands into one block, the cells of a band move by the size of the bands before it
+	size_t total = 0;
+	int failed = 0;
+
+	for (uint32_t i = 0; i < band_count; i++) {
+		total += bands[i].size;
+		failed |= bands[i].failed;
+	}
+
+	uint32_t *data = failed ? NULL : (uint32_t *) malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+
+	if (data != NULL) {
+		size_t base = 0;
+
+		for (uint32_t i = 0; i < band_count; i++) {
+			size_t start = (size_t)scene->world_width * (size_t)((uint64_t)scene->world_height * i / band_count);
+			size_t end = (size_t)scene->world_width * (size_t)((uint64_t)scene->world_height * (i + 1) / band_count);
+
+			for (size_t cell = start; cell < end; cell++) {
+				visibility->offsets[cell] += base;
+			}
+
+			if (bands[i].size != 0) memcpy(data + base, bands[i].data, bands[i].size * sizeof(uint32_t));
+			base += bands[i].size;
+		}
+
+		visibility->offsets[cell_count] = total;
+	}
+
+	for (uint32_t i = 0; i < band_count; i++) {
+		free(bands[i].data);
+	}
+	free(bands);
+
+	if (data == NULL) {
+		free(visibility->offsets);
+		visibility->offsets = NULL;
+		return -1;
+	}
+
+	visibility->data = data;
+	return 0;
+}
+
+int raycast_visibility_query(const raycast_visibility_t* visibility, raycast_real_t from_x, raycast_real_t from_y, raycast_real_t to_x, raycast_real_t to_y) {
+	if (visibility->data == NULL) return 1;
+	if (!(from_x >= 0 && from_y >= 0 && from_x < visibility->width && from_y < visibility->height)) return 1;
+
+	const uint32_t *set = raycast_visibility_set(visibility, (uint32_t)from_x, (uint32_t)from_y);
+	if (set == NULL) return 1;
+
+	return raycast_visibility_sees_point(visibility, set, to_x, to_y);
+}
+
+uint32_t raycast_visibility_filter(const raycast_visibility_t* visibility, raycast_real_t x, raycast_real_t y, const raycast_point_t* points, uint32_t count, uint32_t* results) {
+	const uint32_t *set = NULL;
+
+	if (visibility->data != NULL && x >= 0 && y >= 0 && x < visibility->width && y < visibility->height) {
+		set = raycast_visibility_set(visibility, (uint32_t)x, (uint32_t)y);
+	}
+
+	uint32_t found = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (set == NULL || raycast_visibility_sees_point(visibility, set, points[i].x, points[i].y)) results[found++] = i;
+	}
+
+	return found;
+}
+
+// lightmap functions
+
+// the scene's lightmap if it has one that matches its map, NULL if surfaces are drawn unlit
+static inline const raycast_lightmap_t* raycast_scene_lightmap(const raycast_scene_t* scene) {
+	const raycast_lightmap_t *lightmap = scene->lightmap;
+
+	if (lightmap == NULL || lightmap->values == NULL) return NULL;
+	if (lightmap->width != scene->world_width || lightmap->height != scene->world_height) return NULL;
+
+	return lightmap;
+}
+
+// a light level of 0 - 1 as a lightmap value
+static inline uint8_t raycast_light_value(raycast_real_t light) {
+	if (!(light > 0)) return 0;
+	if (light >= 1) return 255;
+
+	return (uint8_t)(light * 255 + (raycast_real_t)0.5);
+}
+
+// light of one face of a cell, cells off the map only get the ambient light, 255 without a lightmap
+static inline uint8_t raycast_light_at(const raycast_lightmap_t* lightmap, int64_t x, int64_t y, raycast_face_t face) {
+	if (lightmap == NULL) return 255;
+	if (x < 0 || y < 0 || x >= lightmap->width || y >= lightmap->height) return raycast_light_value(lightmap->ambient);
+
+	return lightmap->values[6 * ((size_t)x + (size_t)lightmap->width * (size_t)y) + face];
+}
+
+// darkens a packed texel by a light value, red and blue are scaled together in one multiply, alpha is kept
+static inline uint32_t raycast_shade(uint32_t texel, uint8_t light) {
+	uint32_t scale = (uint32_t)light + 1;
+	uint32_t red_blue = ((((texel >> 8) & 0x00ff00ff) * scale) >> 8) & 0x00ff00ff;
+	uint32_t green = (((texel >> 16) & 0xff) * scale) >> 8;
+
+	return red_blue << 8 | green << 16 | (texel & 0xff);
+}
+
+int raycast_lightmap_init(raycast_lightmap_t* lightmap, raycast_scene_t* scene) {
+	size_t cell_count = (size_t)scene->world_width * scene->world_height;
+
+	lightmap->values = (uint8_t *) malloc(cell_count * 6);
+	if (lightmap->values == NULL) return -1;
+	memset(lightmap->values, 255, cell_count * 6);
+
+	lightmap->width = scene->world_width;
+	lightmap->height = scene->world_height;
+
+	lightmap->lights = NULL;
+	lightmap->light_count = 0;
+	lightmap->ambient = 1;
+	lightmap->sun_direction.x = 0;
+	lightmap->sun_direction.y = 0;
+	lightmap->sun_intensity = 0;
+
+	lightmap->version = 0;
+	lightmap->thread_count = 1;
+	lightmap->thread_pool = NULL;
+
+	return 0;
+}
+
+void raycast_lightmap_free(raycast_lightmap_t* lightmap) {
+	raycast_thread_pool_free(lightmap->thread_pool);
+	free(lightmap->values);
+
+	lightmap->values = NULL;
+	lightmap->width = 0;
+	lightmap->height = 0;
+
+	lightmap->thread_count = 1;
+	lightmap->thread_pool = NULL;
+}
+
+int raycast_lightmap_set_thread_count(raycast_lightmap_t* lightmap, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	raycast_thread_pool_free(lightmap->thread_pool);
+	lightmap->thread_pool = raycast_thread_pool_create(thread_count);
+
+	if (lightmap->thread_pool == NULL) {
+		lightmap->thread_count = 1;
+		return -1;
+	}
+
+	lightmap->thread_count = thread_count;
+	return 0;
+}
+
+/*
+returns 1 if nothing stands between a light and a sample point in cell (cell_x, cell_y), the walk stopping in the
+sample's own cell counts as reaching it, so the tops of raised cells and faces seen across lower cells are lit too
+*/
+static int raycast_light_reaches(raycast_scene_t* scene, raycast_real_t from_x, raycast_real_t from_y, raycast_real_t to_x, raycast_real_t to_y, raycast_real_t length, int cell_x, int cell_y) {
+	raycast_hit_info_t hit_info;
+	raycast_DDA(&hit_info, scene, from_x, from_y, to_x - from_x, to_y - from_y, length);
+
+	if (hit_info.distance >= length) return 1;
+
+	return hit_info.wall_type != 0 && (int)hit_info.hit_point.x == cell_x && (int)hit_info.hit_point.y == cell_y;
+}
+
+/*
+light from the point lights at a sample point in cell (cell_x, cell_y), a face passes its outward normal
+to only take light from in front of it, floors and ceilings pass a normal of 0 and take all of it
+*/
+static raycast_real_t raycast_light_points(const raycast_lightmap_t* lightmap, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, int cell_x, int cell_y, raycast_real_t normal_x, raycast_real_t normal_y) {
+	int facing = normal_x != 0 || normal_y != 0;
+	raycast_real_t light = 0;
+
+	// lights in cells the sample's cell can't see are skipped without casting towards them
+	const raycast_visibility_t *visibility = raycast_scene_visibility(scene);
+	const uint32_t *set = visibility == NULL ? NULL : raycast_visibility_set(visibility, cell_x, cell_y);
+
+	for (uint32_t i = 0; i < lightmap->light_count; i++) {
+		const raycast_light_t *point_light = lightmap->lights + i;
+
+		raycast_real_t to_x = point_light->position.x - x;
+		raycast_real_t to_y = point_light->position.y - y;
+		raycast_real_t distance = raycast_sqrt(to_x * to_x + to_y * to_y);
+
+		if (!(distance < point_light->radius)) continue;
+		if (set != NULL && !raycast_visibility_sees_point(visibility, set, point_light->position.x, point_light->position.y)) continue;
+
+		raycast_real_t strength = point_light->intensity * (1 - distance / point_light->radius);
+
+		// a light right on the sample lights it fully from every side
+		if (distance > (raycast_real_t)1e-4) {
+			if (facing) {
+				raycast_real_t lambert = (to_x * normal_x + to_y * normal_y) / distance;
+				if (!(lambert > 0)) continue;
+				strength *= lambert;
+			}
+
+			if (!raycast_light_reaches(scene, point_light->position.x, point_light->position.y, x, y, distance, cell_x, cell_y)) continue;
+		}
+
+		light += strength;
+	}
+
+	return light;
+}
+
+// light from the sun at a sample point, normals work like they do for raycast_light_points
+static raycast_real_t raycast_light_sun(const raycast_lightmap_t* lightmap, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, raycast_real_t normal_x, raycast_real_t normal_y) {
+	raycast_real_t sun_x = lightmap->sun_direction.x;
+	raycast_real_t sun_y = lightmap->sun_direction.y;
+	raycast_real_t length = raycast_sqrt(sun_x * sun_x + sun_y * sun_y);
+
+	if (!(lightmap->sun_intensity > 0) || !(length > 0)) return 0;
+
+	raycast_real_t lambert = 1;
+	if (normal_x != 0 || normal_y != 0) lambert = (sun_x * normal_x + sun_y * normal_y) / length;
+	if (!(lambert > 0)) return 0;
+
+	raycast_hit_info_t hit_info;
+	raycast_DDA(&hit_info, scene, x, y, sun_x, sun_y, length);
+
+	// the sun is past the edge of the map, so only a ray leaving the map sees it
+	if (hit_info.wall_type != 0) return 0;
+
+	return lightmap->sun_intensity * lambert;
+}
+
+/*
+neighbour each wall face looks out into and its outward normal, in raycast_face_t order, a ray moving
+towards +y stops on the south face of a cell, so the south face looks towards -y and so on
+*/
+static const int raycast_face_normals[4][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+
+static void raycast_lightmap_bake_cell(raycast_lightmap_t* lightmap, raycast_scene_t* scene, int x, int y) {
+	uint8_t *values = lightmap->values + 6 * ((size_t)x + (size_t)lightmap->width * (size_t)y);
+	raycast_real_t ambient = lightmap->ambient;
+	uint8_t cell = raycast_world_cell(scene, x, y);
+
+	raycast_real_t center_x = x + (raycast_real_t)0.5;
+	raycast_real_t center_y = y + (raycast_real_t)0.5;
+
+	// point lights fall on the floor and ceiling alike, the sun only on the floor
+	raycast_real_t ceiling = ambient + raycast_light_points(lightmap, scene, center_x, center_y, x, y, 0, 0);
+	raycast_real_t floor = ceiling + raycast_light_sun(lightmap, scene, center_x, center_y, 0, 0);
+
+	values[raycast_top] = raycast_light_value(ceiling);
+	values[raycast_bottom] = raycast_light_value(floor);
+
+	for (int face = 0; face < 4; face++) {
+		int normal_x = raycast_face_normals[face][0];
+		int normal_y = raycast_face_normals[face][1];
+		int next_x = x + normal_x;
+		int next_y = y + normal_y;
+
+		// empty cells only have sides with cell heights, and faces on the edge of the map are never seen
+		if ((cell == 0 && scene->cell_heights == NULL) || next_x < 0 || next_y < 0 || next_x >= (int)lightmap->width || next_y >= (int)lightmap->height) {
+			values[face] = raycast_light_value(ambient);
+			continue;
+		}
+
+		// the middle of the face, just inside the cell it looks into
+		raycast_real_t sample_x = center_x + normal_x * (raycast_real_t)0.51;
+		raycast_real_t sample_y = center_y + normal_y * (raycast_real_t)0.51;
+
+		raycast_real_t light = raycast_light_points(lightmap, scene, sample_x, sample_y, next_x, next_y, normal_x, normal_y);
+		light += raycast_light_sun(lightmap, scene, sample_x, sample_y, normal_x, normal_y);
+
+		values[face] = raycast_light_value(ambient + light);
+	}
+}
+
+typedef struct {
+	raycast_lightmap_t *lightmap;
+	raycast_scene_t *scene;
+	int min_x, min_y, max_x, max_y;
+} raycast_bake_job_t;
+
+static void raycast_lightmap_bake_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_bake_job_t *job = (raycast_bake_job_t *)data;
+
+	int rows = job->max_y - job->min_y + 1;
+	int start = job->min_y + (int)((int64_t)rows * band / band_count);
+	int end = job->min_y + (int)((int64_t)rows * (band + 1) / band_count);
+
+	for (int y = start; y < end; y++) {
+		for (int x = job->min_x; x <= job->max_x; x++) {
+			raycast_lightmap_bake_cell(job->lightmap, job->scene, x, y);
+		}
+	}
+}
+
+void raycast_lightmap_bake_rect(raycast_lightmap_t* lightmap, raycast_scene_t* scene, int min_x, int min_y, int max_x, int max_y) {
+	if (lightmap->values == NULL || lightmap->width != scene->world_width || lightmap->height != scene->world_height) return;
+	if (scene->world_map == NULL && scene->tiled_map == NULL) return;
+
+	if (min_x < 0) min_x = 0;
+	if (min_y < 0) min_y = 0;
+	if (max_x >= (int)lightmap->width) max_x = (int)lightmap->width - 1;
+	if (max_y >= (int)lightmap->height) max_y = (int)lightmap->height - 1;
+	if (min_x > max_x || min_y > max_y) return;
+
+	raycast_bake_job_t job = {lightmap, scene, min_x, min_y, max_x, max_y};
+
+	// every band gets a few rows of a few hundred cells at least, small rebakes run on the calling thread
+	uint32_t rows = (uint32_t)(max_y - min_y + 1);
+	uint64_t cells = (uint64_t)rows * (uint32_t)(max_x - min_x + 1);
+	uint32_t band_count = lightmap->thread_pool == NULL ? 1 : lightmap->thread_count;
+	if (band_count > rows) band_count = rows;
+	if (band_count > cells / 256) band_count = cells / 256 > 0 ? (uint32_t)(cells / 256) : 1;
+
+	raycast_thread_pool_run(lightmap->thread_pool, raycast_lightmap_bake_task, &job, band_count);
+
+	lightmap->version++;
+}
+
+int raycast_lightmap_bake(raycast_lightmap_t* lightmap, raycast_scene_t* scene) {
+	if (lightmap->values == NULL || lightmap->width != scene->world_width || lightmap->height != scene->world_height) {
+		size_t cell_count = (size_t)scene->world_width * scene->world_height;
+
+		uint8_t *values = (uint8_t *) realloc(lightmap->values, cell_count * 6);
+		if (values == NULL) return -1;
+
+		lightmap->values = values;
+		lightmap->width = scene->world_width;
+		lightmap->height = scene->world_height;
+	}
+
+	raycast_lightmap_bake_rect(lightmap, scene, 0, 0, (int)lightmap->width - 1, (int)lightmap->height - 1);
+	return 0;
+}
+
+// rebakes every cell with a face a light can reach, faces sit in the cell next to the one they are lit from
+static void raycast_lightmap_bake_light(raycast_lightmap_t* lightmap, raycast_scene_t* scene, const raycast_light_t* light) {
+	raycast_real_t reach = light->radius + 1;
+
+	raycast_lightmap_bake_rect(lightmap, scene, (int)raycast_floor(light->position.x - reach), (int)raycast_floor(light->position.y - reach), (int)(light->position.x + reach), (int)(light->position.y + reach));
+}
+
+void raycast_lightmap_update_light(raycast_lightmap_t* lightmap, raycast_scene_t* scene, const raycast_light_t* before, const raycast_light_t* after) {
+	if (before != NULL) raycast_lightmap_bake_light(lightmap, scene, before);
+	if (after != NULL) raycast_lightmap_bake_light(lightmap, scene, after);
+}
+
+/*
+a cell changing can change its own faces and its neighbours', and the shadows it casts, for the lights reaching it
+their whole area is rebaked, for the sun the cells whose ray to the sun passes through it, which lie against the
+sun from it, a ray from any point of a cell passes within one cell of the ray walked back from its middle
+*/
+void raycast_lightmap_update_cell(raycast_lightmap_t* lightmap, raycast_scene_t* scene, uint32_t x, uint32_t y) {
+	if (lightmap->values == NULL || x >= lightmap->width || y >= lightmap->height) return;
+
+	raycast_lightmap_bake_rect(lightmap, scene, (int)x - 1, (int)y - 1, (int)x + 1, (int)y + 1);
+
+	raycast_real_t center_x = x + (raycast_real_t)0.5;
+	raycast_real_t center_y = y + (raycast_real_t)0.5;
+
+	for (uint32_t i = 0; i < lightmap->light_count; i++) {
+		const raycast_light_t *light = lightmap->lights + i;
+
+		raycast_real_t to_x = light->position.x - center_x;
+		raycast_real_t to_y = light->position.y - center_y;
+		raycast_real_t reach = light->radius + 1;
+
+		if (to_x * to_x + to_y * to_y < reach * reach) raycast_lightmap_bake_light(lightmap, scene, light);
+	}
+
+	raycast_real_t sun_x = lightmap->sun_direction.x;
+	raycast_real_t sun_y = lightmap->sun_direction.y;
+	raycast_real_t length = raycast_sqrt(sun_x * sun_x + sun_y * sun_y);
+
+	if (!(lightmap->sun_intensity > 0) || !(length > 0)) return;
+
+	raycast_ray_t ray;
+	raycast_ray_setup(&ray, center_x, center_y, -sun_x, -sun_y, length);
+
+	for (;;) {
+		raycast_ray_step(&ray);
+		if (raycast_ray_outside(&ray, scene)) break;
+
+		raycast_lightmap_bake_rect(lightmap, scene, ray.map_x - 1, ray.map_y - 1, ray.map_x + 1, ray.map_y + 1);
+	}
+}
+
+// object index functions
+
+// the list of objects outside the world map comes after the list of every cell
+static inline uint32_t raycast_index_outside(const raycast_object_index_t* index) {
+	return index->width * index->height;
+}
+
+// list an object belongs in, objects are bucketed by the cell their position falls in
+static uint32_t raycast_index_bucket(const raycast_object_index_t* index, const raycast_object_t* object) {
+	raycast_real_t x = object->position.x;
+	raycast_real_t y = object->position.y;
+
+	if (!(x >= 0 && y >= 0 && x < index->width && y < index->height)) return raycast_index_outside(index);
+
+	return (uint32_t)y * index->width + (uint32_t)x;
+}
+
+static void raycast_index_link(raycast_object_index_t* index, uint32_t object, uint32_t bucket) {
+	int32_t head = index->cell_heads[bucket];
+
+	index->prev[object] = -1;
+	index->next[object] = head;
+	if (head >= 0) index->prev[head] = object;
+
+	index->cell_heads[bucket] = object;
+	index->cells[object] = bucket;
+}
+
+static void raycast_index_unlink(raycast_object_index_t* index, uint32_t object) {
+	int32_t prev = index->prev[object];
+	int32_t next = index->next[object];
+
+	if (prev >= 0) {
+		index->next[prev] = next;
+	} else {
+		index->cell_heads[index->cells[object]] = next;
+	}
+	if (next >= 0) index->prev[next] = prev;
+}
+
+// resizes one array of the index, leaves it untouched on failure
+static int raycast_index_resize(int32_t** array, uint32_t count) {
+	int32_t *resized = (int32_t *) realloc(*array, (count + 1) * sizeof(int32_t));
+	if (resized == NULL) return -1;
+
+	*array = resized;
+	return 0;
+}
+
+int raycast_object_index_init(raycast_object_index_t* index, raycast_scene_t* scene) {
+	index->width = 0;
+	index->height = 0;
+	index->object_count = 0;
+
+	index->cell_heads = NULL;
+	index->next = NULL;
+	index->prev = NULL;
+	index->cells = NULL;
+
+	return raycast_object_index_build(index, scene);
+}
+
+void raycast_object_index_free(raycast_object_index_t* index) {
+	free(index->cell_heads);
+	free(index->next);
+	free(index->prev);
+	free(index->cells);
+
+	index->cell_heads = NULL;
+	index->next = NULL;
+	index->prev = NULL;
+	index->cells = NULL;
+
+	index->width = 0;
+	index->height = 0;
+	index->object_count = 0;
+}
+
+int raycast_object_index_build(raycast_object_index_t* index, raycast_scene_t* scene) {
+	uint32_t object_count = scene->object_count;
+
+	if (raycast_index_resize(&index->cell_heads, scene->world_width * scene->world_height) == -1 ||
+		raycast_index_resize(&index->next, object_count) == -1 ||
+		raycast_index_resize(&index->prev, object_count) == -1 ||
+		raycast_index_resize(&index->cells, object_count) == -1) {
+		raycast_object_index_free(index);
+		return -1;
+	}
+
+	index->width = scene->world_width;
+	index->height = scene->world_height;
+	index->object_count = object_count;
+
+	for (uint32_t i = 0; i <= raycast_index_outside(index); i++) {
+		index->cell_heads[i] = -1;
+	}
+
+	// linked back to front so every list holds its objects in array order
+	for (uint32_t i = object_count; i-- > 0;) {
+		raycast_index_link(index, i, raycast_index_bucket(index, &scene->objects[i]));
+	}
+
+	return 0;
+}
+
+void raycast_object_index_update(raycast_object_index_t* index, raycast_scene_t* scene, uint32_t object) {
+	if (object >= index->object_count) return;
+
+	uint32_t bucket = raycast_index_bucket(index, &scene->objects[object]);
+	if ((int32_t)bucket == index->cells[object]) return;
+
+	raycast_index_unlink(index, object);
+	raycast_index_link(index, object, bucket);
+}
+
+// shape of a query, each filter only reads the fields it needs
+typedef struct {
+	raycast_real_t x, y;
+	raycast_real_t min_x, min_y, max_x, max_y;
+	raycast_real_t range_sq;
+	raycast_real_t dir_x, dir_y, cos_angle;
+} raycast_index_query_t;
+
+typedef int (*raycast_index_filter_t)(raycast_scene_t*, const raycast_object_t*, const raycast_index_query_t*);
+
+static int raycast_index_in_rect(raycast_scene_t* scene, const raycast_object_t* object, const raycast_index_query_t* query) {
+	raycast_real_t x = object->position.x;
+	raycast_real_t y = object->position.y;
+
+	return x >= query->min_x && x <= query->max_x && y >= query->min_y && y <= query->max_y;
+}
+
+static int raycast_index_in_radius(raycast_scene_t* scene, const raycast_object_t* object, const raycast_index_query_t* query) {
+	raycast_real_t dx = object->position.x - query->x;
+	raycast_real_t dy = object->position.y - query->y;
+
+	return dx * dx + dy * dy <= query->range_sq;
+}
+
+// the direction is normalized, so the angle test is a dot product against the distance
+static int raycast_index_in_cone(raycast_scene_t* scene, const raycast_object_t* object, const raycast_index_query_t* query) {
+	raycast_real_t dx = object->position.x - query->x;
+	raycast_real_t dy = object->position.y - query->y;
+	raycast_real_t distance_sq = dx * dx + dy * dy;
+
+	if (distance_sq > query->range_sq) return 0;
+
+	return dx * query->dir_x + dy * query->dir_y >= query->cos_angle * raycast_sqrt(distance_sq);
+}
+
+// the cheap radius test runs first, only objects in range cast a ray
+static int raycast_index_visible(raycast_scene_t* scene, const raycast_object_t* object, const raycast_index_query_t* query) {
+	if (!raycast_index_in_radius(scene, object, query)) return 0;
+	if (object->position.x == query->x && object->position.y == query->y) return 1;
+
+	return !raycast_check_obstruction(scene, query->x, query->y, object->position.x, object->position.y);
+}
+
+/*
+clips the inclusive range [low, high] of world coordinates to the cells of one axis,
+returns 0 if none of its cells are on the map
+*/
+static int raycast_index_cells(raycast_real_t low, raycast_real_t high, uint32_t size, int* start, int* end) {
+	if (!(high >= 0 && low < size && low <= high)) return 0;
+
+	*start = low < 0 ? 0 : (int)low;
+	*end = high >= size ? (int)size - 1 : (int)high;
+	return 1;
+}
+
+static uint32_t raycast_index_gather_list(raycast_object_index_t* index, raycast_scene_t* scene, uint32_t bucket, raycast_index_filter_t filter, const raycast_index_query_t* query, uint32_t* results, uint32_t max_results, uint32_t found) {
+	for (int32_t i = index->cell_heads[bucket]; i >= 0; i = index->next[i]) {
+		if (!filter(scene, &scene->objects[i], query)) continue;
+
+		if (found < max_results) results[found] = i;
+		found++;
+	}
+
+	return found;
+}
+
+// runs the filter on every object in the cells the query's box touches and on every object off the map
+static uint32_t raycast_index_gather(raycast_object_index_t* index, raycast_scene_t* scene, raycast_index_filter_t filter, const raycast_index_query_t* query, uint32_t* results, uint32_t max_results) {
+	uint32_t found = 0;
+	int start_x, end_x, start_y, end_y;
+
+	if (raycast_index_cells(query->min_x, query->max_x, index->width, &start_x, &end_x) &&
+		raycast_index_cells(query->min_y, query->max_y, index->height, &start_y, &end_y)) {
+		for (int y = start_y; y <= end_y; y++) {
+			for (int x = start_x; x <= end_x; x++) {
+				found = raycast_index_gather_list(index, scene, y * index->width + x, filter, query, results, max_results, found);
+			}
+		}
+	}
+
+	return raycast_index_gather_list(index, scene, raycast_index_outside(index), filter, query, results, max_results, found);
+}
+
+// fills in a query for the circle of radius around (x, y) and its bounding box
+static void raycast_index_circle(raycast_index_query_t* query, raycast_real_t x, raycast_real_t y, raycast_real_t radius) {
+	query->x = x;
+	query->y = y;
+	query->min_x = x - radius;
+	query->min_y = y - radius;
+	query->max_x = x + radius;
+	query->max_y = y + radius;
+	query->range_sq = radius * radius;
+}
+
+uint32_t raycast_object_index_query_radius(raycast_object_index_t* index, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, raycast_real_t radius, uint32_t* results, uint32_t max_results) {
+	if (radius < 0) return 0;
+
+	raycast_index_query_t query;
+	raycast_index_circle(&query, x, y, radius);
+
+	return raycast_index_gather(index, scene, raycast_index_in_radius, &query, results, max_results);
+}
+
+uint32_t raycast_object_index_query_rect(raycast_object_index_t* index, raycast_scene_t* scene, raycast_real_t min_x, raycast_real_t min_y, raycast_real_t max_x, raycast_real_t max_y, uint32_t* results, uint32_t max_results) {
+	raycast_index_query_t query;
+	query.min_x = min_x;
+	query.min_y = min_y;
+	query.max_x = max_x;
+	query.max_y = max_y;
+
+	return raycast_index_gather(index, scene, raycast_index_in_rect, &query, results, max_results);
+}
+
+uint32_t raycast_object_index_query_cone(raycast_object_index_t* index, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, raycast_real_t dir_x, raycast_real_t dir_y, raycast_real_t half_angle, raycast_real_t range, uint32_t* results, uint32_t max_results) {
+	raycast_real_t dir_length = raycast_sqrt(dir_x * dir_x + dir_y * dir_y);
+	if (range < 0 || dir_length == 0) return 0;
+
+	raycast_index_query_t query;
+	raycast_index_circle(&query, x, y, range);
+	query.dir_x = dir_x / dir_length;
+	query.dir_y = dir_y / dir_length;
+	query.cos_angle = raycast_cos(half_angle);
+
+	return raycast_index_gather(index, scene, raycast_index_in_cone, &query, results, max_results);
+}
+
+uint32_t raycast_object_index_query_visible(raycast_object_index_t* index, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, raycast_real_t radius, uint32_t* results, uint32_t max_results) {
+	if (radius < 0) return 0;
+
+	raycast_index_query_t query;
+	raycast_index_circle(&query, x, y, radius);
+
+	return raycast_index_gather(index, scene, raycast_index_visible, &query, results, max_results);
+}
+
+// keeps the nearest object of one list, ties go to the object found first
+static void raycast_index_nearest_list(raycast_object_index_t* index, raycast_scene_t* scene, uint32_t bucket, raycast_real_t x, raycast_real_t y, int* nearest, raycast_real_t* nearest_sq) {
+	for (int32_t i = index->cell_heads[bucket]; i >= 0; i = index->next[i]) {
+		raycast_real_t dx = scene->objects[i].position.x - x;
+		raycast_real_t dy = scene->objects[i].position.y - y;
+		raycast_real_t distance_sq = dx * dx + dy * dy;
+
+		if (*nearest < 0 ? distance_sq <= *nearest_sq : distance_sq < *nearest_sq) {
+			*nearest = i;
+			*nearest_sq = distance_sq;
+		}
+	}
+}
+
+/*
+searches square rings of cells around the cell of (x, y), every cell of ring r is more than r - 1 away,
+so the search stops once a ring can't hold anything nearer than the best object so far
+*/
+int raycast_object_index_nearest(raycast_object_index_t* index, raycast_scene_t* scene, raycast_real_t x, raycast_real_t y, raycast_real_t max_distance) {
+	if (!(max_distance >= 0)) return -1;
+
+	int nearest = -1;
+	raycast_real_t nearest_sq = max_distance * max_distance;
+
+	raycast_index_nearest_list(index, scene, raycast_index_outside(index), x, y, &nearest, &nearest_sq);
+
+	if (index->width == 0 || index->height == 0) return nearest;
+
+	// clamped so far away points don't overflow, the rings still reach the map from there
+	raycast_real_t limit = (raycast_real_t)(1 << 30);
+	int64_t center_x = (int64_t)raycast_floor(x < -limit ? -limit : x > limit ? limit : x);
+	int64_t center_y = (int64_t)raycast_floor(y < -limit ? -limit : y > limit ? limit : y);
+
+	int64_t width = index->width;
+	int64_t height = index->height;
+
+	// first ring that touches the map
+	int64_t ring = 0;
+	if (-center_x > ring) ring = -center_x;
+	if (center_x - (width - 1) > ring) ring = center_x - (width - 1);
+	if (-center_y > ring) ring = -center_y;
+	if (center_y - (height - 1) > ring) ring = center_y - (height - 1);
+
+	for (;; ring++) {
+		raycast_real_t gap = (raycast_real_t)(ring - 1);
+		if (ring > 0 && gap * gap > nearest_sq) break;
+
+		int64_t left = center_x - ring, right = center_x + ring;
+		int64_t top = center_y - ring, bottom = center_y + ring;
+
+		// every later ring is off the map too
+		if (left < 0 && right >= width && top < 0 && bottom >= height) break;
+
+		int64_t start_x = left < 0 ? 0 : left;
+		int64_t end_x = right >= width ? width - 1 : right;
+		int64_t start_y = top + 1 < 0 ? 0 : top + 1;
+		int64_t end_y = bottom - 1 >= height ? height - 1 : bottom - 1;
+
+		for (int64_t i = start_x; i <= end_x; i++) {
+			if (top >= 0) raycast_index_nearest_list(index, scene, top * width + i, x, y, &nearest, &nearest_sq);
+			if (ring > 0 && bottom < height) raycast_index_nearest_list(index, scene, bottom * width + i, x, y, &nearest, &nearest_sq);
+		}
+
+		for (int64_t j = start_y; j <= end_y; j++) {
+			if (left >= 0) raycast_index_nearest_list(index, scene, j * width + left, x, y, &nearest, &nearest_sq);
+			if (ring > 0 && right < width) raycast_index_nearest_list(index, scene, j * width + right, x, y, &nearest, &nearest_sq);
+		}
+	}
+
+	return nearest;
+}
+
+// render functions
+
+/*
+arguments shared by every band of a render pass, bands split
+the screen into equal column or row ranges, one per band index
+*/
+typedef struct {
+	raycast_renderer_t *renderer;
+	raycast_scene_t *scene;
+	raycast_camera_t *camera;
+} raycast_render_job_t;
+
+// start of a band when splitting length into band_count ranges, band_count gives the end of the last band
+static int raycast_band_start(int length, uint32_t band, uint32_t band_count) {
+	return (int)((int64_t)length * band / band_count);
+}
+
+// number of bands a pass is split into, 1 when the renderer is single threaded
+static uint32_t raycast_band_count(raycast_renderer_t* renderer, int length) {
+	uint32_t bands = renderer->thread_pool == NULL ? 1 : renderer->thread_count;
+	if (bands > (uint32_t)length) bands = length > 0 ? length : 1;
+	return bands;
+}
+
+/*
+hands a finished span to the user, when only the pixel function is set
+this adapts the span back into one pixel function call per pixel
+*/
+static void raycast_emit_surface_span(raycast_renderer_t* renderer, raycast_surface_span_t* span) {
+	if (renderer->surface_span != NULL) {
+		renderer->surface_span(span);
+		return;
+	}
+
+	raycast_screen_pixel_t pixel;
+
+	for (uint32_t i = 0; i < span->count; i++) {
+		raycast_uint32_to_color(*span->pixels[i], &(pixel.color));
+
+		pixel.location = span->locations[i];
+		pixel.light = span->light[i];
+
+		renderer->surface_pixel(&pixel, span->map_x[i], span->map_y[i], span->unit_x[i], span->unit_y[i], span->face, span->depth[i]);
+
+		*span->pixels[i] = raycast_color_to_uint32(&(pixel.color));
+	}
+}
+
+static void raycast_emit_sprite_span(raycast_renderer_t* renderer, raycast_sprite_span_t* span) {
+	if (renderer->sprite_span != NULL) {
+		renderer->sprite_span(span);
+		return;
+	}
+
+	raycast_screen_pixel_t pixel;
+
+	for (uint32_t i = 0; i < span->count; i++) {
+		raycast_uint32_to_color(*span->pixels[i], &(pixel.color));
+
+		pixel.location = span->locations[i];
+		pixel.light = 255;
+
+		renderer->sprite_pixel(&pixel, span->id, span->unit_x[i], span->unit_y, span->depth);
+
+		*span->pixels[i] = raycast_color_to_uint32(&(pixel.color));
+	}
+}
+
+// points every array of the span at the scratch memory and empties it
+static void raycast_surface_span_init(raycast_surface_span_t* span, raycast_scratch_t* scratch, raycast_face_t face) {
+	span->count = 0;
+	span->face = face;
+	span->map_x = scratch->map_x;
+	span->map_y = scratch->map_y;
+	span->unit_x = scratch->unit_x;
+	span->unit_y = scratch->unit_y;
+	span->depth = scratch->depth;
+	span->pixels = scratch->pixels;
+	span->locations = scratch->locations;
+	span->light = scratch->light;
+}
+
+// texture lookups
+
+// returns the texture at an index of the atlas, or NULL for -1 and indexes past the end
+static const raycast_texture_t* raycast_atlas_texture(const raycast_texture_atlas_t* atlas, int texture) {
+	if (texture < 0 || (uint32_t)texture >= atlas->texture_count) return NULL;
+	return atlas->textures + texture;
+}
+
+// the atlas is only used for a pass when the user didn't give a function for it
+static int raycast_surfaces_textured(raycast_renderer_t* renderer, raycast_scene_t* scene) {
+	return scene->textures != NULL && renderer->surface_pixel == NULL && renderer->surface_span == NULL;
+}
+
+static int raycast_sprites_textured(raycast_renderer_t* renderer, raycast_scene_t* scene) {
+	return scene->textures != NULL && renderer->sprite_pixel == NULL && renderer->sprite_span == NULL;
+}
+
+/*
+draws one wall column straight from the atlas, the texture column is picked once
+and its texels are read in order with 16.16 fixed point stepping, walls are the
+first thing drawn so there is nothing in front of them to test against, texels
+are darkened by light unless it is full
+*/
+static void raycast_texture_column(raycast_renderer_t* renderer, const raycast_texture_atlas_t* atlas, const raycast_texture_t* texture, int x, int draw_start, int draw_end, raycast_real_t wall_x, raycast_real_t wall_y, raycast_real_t step, uint8_t light) {
+	int w = renderer->screen_width;
+
+	uint32_t width_mask = (1u << texture->width_shift) - 1;
+	uint32_t height_mask = (1u << texture->height_shift) - 1;
+
+	uint32_t u = (uint32_t)(wall_x * (1 << texture->width_shift)) & width_mask;
+	const uint32_t *column = atlas->texels + texture->offset + (u << texture->height_shift);
+
+	// through int64_t so 16 bit tall textures and negative positions wrap instead of overflowing
+	uint32_t v = (uint32_t)(int64_t)(wall_y * (1 << texture->height_shift) * 65536);
+	uint32_t v_step = (uint32_t)(int64_t)(step * (1 << texture->height_shift) * 65536);
+
+	// with a transposed wall target the column is contiguous, the resolve moves it to the screen
+	uint32_t *pixel = renderer->pixel_data + x + w * draw_start;
+	int stride = w;
+
+	if (renderer->wall_pixels != NULL) {
+		pixel = renderer->wall_pixels + renderer->screen_height * x + draw_start;
+		stride = 1;
+	}
+
+	if (light != 255) {
+		for (int y = draw_start; y < draw_end; y++) {
+			*pixel = raycast_shade(column[(v >> 16) & height_mask], light);
+
+			v += v_step;
+			pixel += stride;
+		}
+		return;
+	}
+
+	for (int y = draw_start; y < draw_end; y++) {
+		*pixel = column[(v >> 16) & height_mask];
+
+		v += v_step;
+		pixel += stride;
+	}
+}
+
+/*
+records the wall of a column, its depth and rows are kept for sprite culling and the depth buffer,
+the wall pass never writes the depth buffer itself, raycast_render_top_bottom writes it a row at a time
+from these arrays, so nothing strides down the depth buffer, draw_start == draw_end for columns without a wall
+*/
+static void raycast_set_column_wall(raycast_renderer_t* renderer, int x, int draw_start, int draw_end, raycast_depth_t depth) {
+	renderer->wall_depths[x] = depth;
+	renderer->wall_starts[x] = draw_start;
+	renderer->wall_ends[x] = draw_end;
+}
+
+// 1 if a floor / ceiling pixel of row y is covered by the wall of its column
+static inline int raycast_wall_covers(const raycast_renderer_t* renderer, int x, int y) {
+	return y >= renderer->wall_starts[x] && y < renderer->wall_ends[x];
+}
+
+// writes the depth of one row from the wall arrays, the wall's depth where a wall covers the row and the cleared value everywhere else
+static void raycast_fill_row_depth(raycast_renderer_t* renderer, int y) {
+	int w = renderer->screen_width;
+	raycast_depth_t *pixel_depth = renderer->depth_buffer + w * y;
+
+	for (int x = 0; x < w; x++) {
+		pixel_depth[x] = raycast_wall_covers(renderer, x, y) ? renderer->wall_depths[x] : RAYCAST_DEPTH_CLEAR;
+	}
+}
+
+// 1 if a sprite pixel at depth is behind the wall of its column, used in column depth mode
+static inline int raycast_wall_hides(const raycast_renderer_t* renderer, int x, int y, raycast_depth_t depth) {
+	return renderer->wall_depths[x] <= depth && raycast_wall_covers(renderer, x, y);
+}
+
+/*
+one floor or ceiling row drawn from a single texture, x and y are the low 32 bits of the 16.16 world
+position and wrap freely, only the fraction picks the texel so they land on the same texel as the full value,
+depths is NULL in column depth mode, the pixels are then only drawn where the wall of their column doesn't cover screen_y
+*/
+typedef struct {
+	uint32_t *pixels;
+	raycast_depth_t *depths;
+	int count;
+	raycast_depth_t depth;
+	uint32_t x, y, step_x, step_y;
+	const uint32_t *texels;
+	int width_shift, height_shift;
+	const int *wall_starts, *wall_ends;
+	int screen_y;
+} raycast_row_t;
+
+typedef void (*raycast_row_kernel_t)(const raycast_row_t*);
+
+// draws the pixels of a row from start onwards, the SIMD kernels use it for the pixels past their last full vector
+static void raycast_texture_row_tail(const raycast_row_t* row, int start) {
+	uint32_t width_mask = (1u << row->width_shift) - 1;
+	uint32_t height_mask = (1u << row->height_shift) - 1;
+
+	uint32_t x = row->x + row->step_x * start;
+	uint32_t y = row->y + row->step_y * start;
+
+	for (int i = start; i < row->count; i++, x += row->step_x, y += row->step_y) {
+		if (row->depths == NULL) {
+			if (row->screen_y >= row->wall_starts[i] && row->screen_y < row->wall_ends[i]) continue;
+		} else if (row->depths[i] <= row->depth) {
+			continue;
+		}
+
+		uint32_t u = (x >> (16 - row->width_shift)) & width_mask;
+		uint32_t v = (y >> (16 - row->height_shift)) & height_mask;
+
+		row->pixels[i] = row->texels[(u << row->height_shift) + v];
+		if (row->depths != NULL) row->depths[i] = row->depth;
+	}
+}
+
+static void raycast_texture_row_scalar(const raycast_row_t* row) {
+	raycast_texture_row_tail(row, 0);
+}
+
+/*
+one floor or ceiling row whose texture or light changes from cell to cell, x and y are the full 64 bit 16.16 world
+position since cells off the map are skipped, texture covers every cell when there is no map of them (the atlas'
+floor_map or ceiling_map, or the tiled map's layer), with a lightmap every texel is shaded by its cell's light
+*/
+typedef struct {
+	raycast_row_t row;
+	int64_t x, y, step_x, step_y;
+	const raycast_texture_atlas_t *atlas;
+	const raycast_texture_t *texture;
+	const uint8_t *cell_textures;
+	const raycast_tiled_map_t *tiled;
+	uint32_t layer;
+	uint32_t world_width, world_height;
+	const raycast_lightmap_t *lightmap;
+	raycast_face_t face;
+} raycast_cell_row_t;
+
+typedef void (*raycast_cell_row_kernel_t)(const raycast_cell_row_t*);
+
+// texture and light of a cell of the row, NULL if nothing is drawn there, one texture covers the ground off the map too, a map of them only the cells on it
+static inline const raycast_texture_t* raycast_cell_row_fetch(const raycast_cell_row_t* row, int64_t cell_x, int64_t cell_y, uint8_t* light) {
+	const raycast_texture_t *texture = row->texture;
+
+	if (row->cell_textures != NULL || row->tiled != NULL) {
+		if (cell_x < 0 || cell_y < 0 || cell_x >= row->world_width || cell_y >= row->world_height) return NULL;
+
+		texture = raycast_atlas_texture(row->atlas, row->tiled != NULL ? raycast_tiled_cell(row->tiled, row->layer, cell_x, cell_y) : row->cell_textures[cell_x + row->world_width * cell_y]);
+		if (texture == NULL) return NULL;
+	}
+
+	*light = raycast_light_at(row->lightmap, cell_x, cell_y, row->face);
+	return texture;
+}
+
+// draws the pixels of a cell row from start onwards, the SIMD kernels use it for the pixels past their last full vector
+static void raycast_texture_cell_row_tail(const raycast_cell_row_t* cell_row, int start) {
+	const raycast_row_t *row = &cell_row->row;
+	const uint32_t *texels = cell_row->atlas->texels;
+
+	int64_t x = cell_row->x + cell_row->step_x * start;
+	int64_t y = cell_row->y + cell_row->step_y * start;
+
+	for (int i = start; i < row->count; i++, x += cell_row->step_x, y += cell_row->step_y) {
+		if (row->depths == NULL) {
+			if (row->screen_y >= row->wall_starts[i] && row->screen_y < row->wall_ends[i]) continue;
+		} else if (row->depths[i] <= row->depth) {
+			continue;
+		}
+
+		uint8_t light;
+		const raycast_texture_t *texture = raycast_cell_row_fetch(cell_row, x >> 16, y >> 16, &light);
+		if (texture == NULL) continue;
+
+		uint32_t u = (uint32_t)(x >> (16 - texture->width_shift)) & ((1u << texture->width_shift) - 1);
+		uint32_t v = (uint32_t)(y >> (16 - texture->height_shift)) & ((1u << texture->height_shift) - 1);
+		uint32_t texel = texels[texture->offset + (u << texture->height_shift) + v];
+
+		row->pixels[i] = cell_row->lightmap == NULL ? texel : raycast_shade(texel, light);
+		if (row->depths != NULL) row->depths[i] = row->depth;
+	}
+}
+
+static void raycast_texture_cell_row_scalar(const raycast_cell_row_t* row) {
+	raycast_texture_cell_row_tail(row, 0);
+}
+
+// 1 if the cells a row passes through fit the 32 bit lanes of the SIMD kernels, rows reaching far past the map near the horizon don't
+static int raycast_cell_row_fits(const raycast_cell_row_t* row) {
+	int64_t limit = (int64_t)1 << 45;
+	int64_t last = row->row.count > 0 ? row->row.count - 1 : 0;
+
+	int64_t end_x = row->x + row->step_x * last;
+	int64_t end_y = row->y + row->step_y * last;
+
+	return row->x > -limit && row->x < limit && end_x > -limit && end_x < limit &&
+		row->y > -limit && row->y < limit && end_y > -limit && end_y < limit && row->atlas->texel_count <= INT32_MAX;
+}
+
+#ifdef RAYCAST_X86_SIMD
+
+/*
+SSE2 kernel, 4 pixels at a time, there is no gather so the texels are fetched one by one,
+but the depth test, texel coordinates and the masked writes are done for all 4 at once
+*/
+
+// lanes where the depth buffer is further away than depth, as 32 bit masks
+__attribute__((target("sse2")))
+static inline __m128i raycast_depth_mask_sse2(const raycast_depth_t* depths, raycast_depth_t depth) {
+#if defined(RAYCAST_DEPTH_INT16)
+	__m128i mask = _mm_cmpgt_epi16(_mm_loadl_epi64((const __m128i *)depths), _mm_set1_epi16(depth));
+	return _mm_unpacklo_epi16(mask, mask);
+#elif defined(RAYCAST_DEPTH_INT32)
+	return _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)depths), _mm_set1_epi32(depth));
+#elif defined(RAYCAST_DEPTH_FLOAT)
+	return _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(depths), _mm_set1_ps(depth)));
+#else
+	__m128d lo = _mm_cmpgt_pd(_mm_loadu_pd(depths), _mm_set1_pd(depth));
+	__m128d hi = _mm_cmpgt_pd(_mm_loadu_pd(depths + 2), _mm_set1_pd(depth));
+	return _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(lo), _mm_castpd_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+#endif
+}
+
+__attribute__((target("sse2")))
+static inline __m128i raycast_blend_sse2(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// writes depth to the lanes of mask
+__attribute__((target("sse2")))
+static inline void raycast_depth_store_sse2(raycast_depth_t* depths, __m128i mask, raycast_depth_t depth) {
+#if defined(RAYCAST_DEPTH_INT16)
+	__m128i *dest = (__m128i *)depths;
+	_mm_storel_epi64(dest, raycast_blend_sse2(_mm_packs_epi32(mask, mask), _mm_set1_epi16(depth), _mm_loadl_epi64(dest)));
+#elif defined(RAYCAST_DEPTH_INT32)
+	__m128i *dest = (__m128i *)depths;
+	_mm_storeu_si128(dest, raycast_blend_sse2(mask, _mm_set1_epi32(depth), _mm_loadu_si128(dest)));
+#elif defined(RAYCAST_DEPTH_FLOAT)
+	__m128i *dest = (__m128i *)depths;
+	_mm_storeu_si128(dest, raycast_blend_sse2(mask, _mm_castps_si128(_mm_set1_ps(depth)), _mm_loadu_si128(dest)));
+#else
+	__m128i value = _mm_castpd_si128(_mm_set1_pd(depth));
+	__m128i *lo = (__m128i *)depths;
+	__m128i *hi = (__m128i *)(depths + 2);
+	_mm_storeu_si128(lo, raycast_blend_sse2(_mm_unpacklo_epi32(mask, mask), value, _mm_loadu_si128(lo)));
+	_mm_storeu_si128(hi, raycast_blend_sse2(_mm_unpackhi_epi32(mask, mask), value, _mm_loadu_si128(hi)));
+#endif
+}
+
+// lanes of a row that are drawn, either by the depth test or in column depth mode by the walls' rows
+__attribute__((target("sse2")))
+static inline __m128i raycast_row_mask_sse2(const raycast_row_t* row, int i) {
+	if (row->depths != NULL) return raycast_depth_mask_sse2(row->depths + i, row->depth);
+
+	__m128i y = _mm_set1_epi32(row->screen_y);
+	__m128i above = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(row->wall_starts + i)), y);
+	__m128i not_below = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(row->wall_ends + i)), y);
+	return _mm_or_si128(above, _mm_andnot_si128(not_below, _mm_set1_epi32(-1)));
+}
+
+__attribute__((target("sse2")))
+static void raycast_texture_row_sse2(const raycast_row_t* row) {
+	__m128i x = _mm_setr_epi32(row->x, row->x + row->step_x, row->x + 2 * row->step_x, row->x + 3 * row->step_x);
+	__m128i y = _mm_setr_epi32(row->y, row->y + row->step_y, row->y + 2 * row->step_y, row->y + 3 * row->step_y);
+	__m128i step_x = _mm_set1_epi32(row->step_x * 4);
+	__m128i step_y = _mm_set1_epi32(row->step_y * 4);
+
+	__m128i u_shift = _mm_cvtsi32_si128(16 - row->width_shift);
+	__m128i v_shift = _mm_cvtsi32_si128(16 - row->height_shift);
+	__m128i column_shift = _mm_cvtsi32_si128(row->height_shift);
+	__m128i width_mask = _mm_set1_epi32((1u << row->width_shift) - 1);
+	__m128i height_mask = _mm_set1_epi32((1u << row->height_shift) - 1);
+
+	uint32_t index[4];
+
+	int i = 0;
+	for (; i + 4 <= row->count; i += 4, x = _mm_add_epi32(x, step_x), y = _mm_add_epi32(y, step_y)) {
+		__m128i mask = raycast_row_mask_sse2(row, i);
+		if (_mm_movemask_epi8(mask) == 0) continue;
+
+		__m128i u = _mm_and_si128(_mm_srl_epi32(x, u_shift), width_mask);
+		__m128i v = _mm_and_si128(_mm_srl_epi32(y, v_shift), height_mask);
+		_mm_storeu_si128((__m128i *)index, _mm_add_epi32(_mm_sll_epi32(u, column_shift), v));
+
+		__m128i texel = _mm_setr_epi32(row->texels[index[0]], row->texels[index[1]], row->texels[index[2]], row->texels[index[3]]);
+
+		__m128i *pixel = (__m128i *)(row->pixels + i);
+		_mm_storeu_si128(pixel, raycast_blend_sse2(mask, texel, _mm_loadu_si128(pixel)));
+		if (row->depths != NULL) raycast_depth_store_sse2(row->depths + i, mask, row->depth);
+	}
+
+	raycast_texture_row_tail(row, i);
+}
+
+// raycast_shade for 4 texels, no channel times light + 1 passes 16 bits so 16 bit multiplies give the same result
+__attribute__((target("sse2")))
+static inline __m128i raycast_shade_sse2(__m128i texel, __m128i light) {
+	__m128i scale = _mm_add_epi32(light, _mm_set1_epi32(1));
+	__m128i low_bytes = _mm_set1_epi32(0x00ff00ff);
+	scale = _mm_or_si128(scale, _mm_slli_epi32(scale, 16));
+
+	__m128i red_blue = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(texel, 8), low_bytes), scale), 8);
+	__m128i green = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(texel, low_bytes), scale), 8);
+
+	return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(red_blue, 8), _mm_and_si128(green, _mm_set1_epi32(0x00ff0000))), _mm_and_si128(texel, _mm_set1_epi32(0xff)));
+}
+
+/*
+every lane of a cell row keeps its cell and the 16 bit fraction in it apart, the fractions carry into the cells
+as they step, so 32 bit lanes land on the same cells and texels as the 64 bit positions of the scalar loop
+*/
+__attribute__((target("sse2")))
+static inline void raycast_cell_step_sse2(__m128i* cell, __m128i* fraction, __m128i cell_step, __m128i fraction_step) {
+	*fraction = _mm_add_epi32(*fraction, fraction_step);
+	*cell = _mm_add_epi32(*cell, _mm_add_epi32(cell_step, _mm_srli_epi32(*fraction, 16)));
+	*fraction = _mm_and_si128(*fraction, _mm_set1_epi32(0xffff));
+}
+
+// the cells and fractions of the first lanes of a cell row and the step of a whole vector of them
+static void raycast_cell_lanes(int64_t position, int64_t step, int lanes, uint32_t* cells, uint32_t* fractions, int32_t* cell_step, int32_t* fraction_step) {
+	for (int i = 0; i < lanes; i++) {
+		int64_t lane = position + step * i;
+		cells[i] = (uint32_t)(lane >> 16);
+		fractions[i] = (uint32_t)lane & 0xffff;
+	}
+
+	*cell_step = (int32_t)((step * lanes) >> 16);
+	*fraction_step = (int32_t)((step * lanes) & 0xffff);
+}
+
+/*
+SSE2 kernel for rows that change texture or light from cell to cell, the cells of the 4 lanes are stepped and
+depth tested at once, the lanes that pass are handed to raycast_cell_row_fetch one by one for their texture,
+texel and light, and the texels are shaded and written for all 4 at once
+*/
+__attribute__((target("sse2")))
+static void raycast_texture_cell_row_sse2(const raycast_cell_row_t* cell_row) {
+	const raycast_row_t *row = &cell_row->row;
+	const uint32_t *texels = cell_row->atlas->texels;
+
+	uint32_t cell_x[4], cell_y[4], fraction_x[4], fraction_y[4];
+	int32_t cell_step_x, cell_step_y, fraction_step_x, fraction_step_y;
+
+	raycast_cell_lanes(cell_row->x, cell_row->step_x, 4, cell_x, fraction_x, &cell_step_x, &fraction_step_x);
+	raycast_cell_lanes(cell_row->y, cell_row->step_y, 4, cell_y, fraction_y, &cell_step_y, &fraction_step_y);
+
+	__m128i cells_x = _mm_loadu_si128((const __m128i *)cell_x);
+	__m128i cells_y = _mm_loadu_si128((const __m128i *)cell_y);
+	__m128i fractions_x = _mm_loadu_si128((const __m128i *)fraction_x);
+	__m128i fractions_y = _mm_loadu_si128((const __m128i *)fraction_y);
+
+	__m128i cell_steps_x = _mm_set1_epi32(cell_step_x);
+	__m128i cell_steps_y = _mm_set1_epi32(cell_step_y);
+	__m128i fraction_steps_x = _mm_set1_epi32(fraction_step_x);
+	__m128i fraction_steps_y = _mm_set1_epi32(fraction_step_y);
+
+	int i = 0;
+	for (; i + 4 <= row->count; i += 4, raycast_cell_step_sse2(&cells_x, &fractions_x, cell_steps_x, fraction_steps_x), raycast_cell_step_sse2(&cells_y, &fractions_y, cell_steps_y, fraction_steps_y)) {
+		__m128i mask = raycast_row_mask_sse2(row, i);
+		int visible = _mm_movemask_ps(_mm_castsi128_ps(mask));
+		if (visible == 0) continue;
+
+		_mm_storeu_si128((__m128i *)cell_x, cells_x);
+		_mm_storeu_si128((__m128i *)cell_y, cells_y);
+		_mm_storeu_si128((__m128i *)fraction_x, fractions_x);
+		_mm_storeu_si128((__m128i *)fraction_y, fractions_y);
+
+		uint32_t texel[4] = {0, 0, 0, 0}, light[4] = {255, 255, 255, 255};
+		int32_t drawn[4] = {0, 0, 0, 0};
+
+		for (int lane = 0; lane < 4; lane++) {
+			if (!(visible & (1 << lane))) continue;
+
+			uint8_t cell_light;
+			const raycast_texture_t *texture = raycast_cell_row_fetch(cell_row, (int32_t)cell_x[lane], (int32_t)cell_y[lane], &cell_light);
+			if (texture == NULL) continue;
+
+			uint32_t u = (fraction_x[lane] >> (16 - texture->width_shift)) & ((1u << texture->width_shift) - 1);
+			uint32_t v = (fraction_y[lane] >> (16 - texture->height_shift)) & ((1u << texture->height_shift) - 1);
+
+			texel[lane] = texels[texture->offset + (u << texture->height_shift) + v];
+			light[lane] = cell_light;
+			drawn[lane] = -1;
+		}
+
+		mask = _mm_loadu_si128((const __m128i *)drawn);
+		if (_mm_movemask_epi8(mask) == 0) continue;
+
+		__m128i color = _mm_loadu_si128((const __m128i *)texel);
+		if (cell_row->lightmap != NULL) color = raycast_shade_sse2(color, _mm_loadu_si128((const __m128i *)light));
+
+		__m128i *pixel = (__m128i *)(row->pixels + i);
+		_mm_storeu_si128(pixel, raycast_blend_sse2(mask, color, _mm_loadu_si128(pixel)));
+		if (row->depths != NULL) raycast_depth_store_sse2(row->depths + i, mask, row->depth);
+	}
+
+	raycast_texture_cell_row_tail(cell_row, i);
+}
+
+/*
+AVX2 kernel, 8 pixels at a time with the texels gathered straight from the atlas,
+vectors that are fully hidden behind walls are skipped without touching the texture
+*/
+
+__attribute__((target("avx2")))
+static inline __m256i raycast_depth_mask_avx2(const raycast_depth_t* depths, raycast_depth_t depth) {
+#if defined(RAYCAST_DEPTH_INT16)
+	return _mm256_cvtepi16_epi32(_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i *)depths), _mm_set1_epi16(depth)));
+#elif defined(RAYCAST_DEPTH_INT32)
+	return _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)depths), _mm256_set1_epi32(depth));
+#elif defined(RAYCAST_DEPTH_FLOAT)
+	return _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(depths), _mm256_set1_ps(depth), _CMP_GT_OQ));
+#else
+	__m256d lo = _mm256_cmp_pd(_mm256_loadu_pd(depths), _mm256_set1_pd(depth), _CMP_GT_OQ);
+	__m256d hi = _mm256_cmp_pd(_mm256_loadu_pd(depths + 4), _mm256_set1_pd(depth), _CMP_GT_OQ);
+
+	// keep the low half of every 64 bit mask, the shuffle works within 128 bit lanes so the halves are put back in order after
+	__m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castpd_ps(lo), _mm256_castpd_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+	return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+#endif
+}
+
+__attribute__((target("avx2")))
+static inline void raycast_depth_store_avx2(raycast_depth_t* depths, __m256i mask, raycast_depth_t depth) {
+#if defined(RAYCAST_DEPTH_INT16)
+	// there is no 16 bit masked store, blend the 8 depths in a 128 bit register instead
+	__m128i *dest = (__m128i *)depths;
+	__m128i mask16 = _mm_packs_epi32(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+	_mm_storeu_si128(dest, _mm_blendv_epi8(_mm_loadu_si128(dest), _mm_set1_epi16(depth), mask16));
+#elif defined(RAYCAST_DEPTH_INT32)
+	_mm256_maskstore_epi32((int *)depths, mask, _mm256_set1_epi32(depth));
+#elif defined(RAYCAST_DEPTH_FLOAT)
+	_mm256_maskstore_ps(depths, mask, _mm256_set1_ps(depth));
+#else
+	__m256d value = _mm256_set1_pd(depth);
+	_mm256_maskstore_pd(depths, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask)), value);
+	_mm256_maskstore_pd(depths + 4, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1)), value);
+#endif
+}
+
+__attribute__((target("avx2")))
+static inline __m256i raycast_row_mask_avx2(const raycast_row_t* row, int i) {
+	if (row->depths != NULL) return raycast_depth_mask_avx2(row->depths + i, row->depth);
+
+	__m256i y = _mm256_set1_epi32(row->screen_y);
+	__m256i above = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(row->wall_starts + i)), y);
+	__m256i not_below = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(row->wall_ends + i)), y);
+	return _mm256_or_si256(above, _mm256_andnot_si256(not_below, _mm256_set1_epi32(-1)));
+}
+
+__attribute__((target("avx2")))
+static void raycast_texture_row_avx2(const raycast_row_t* row) {
+	__m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i x = _mm256_add_epi32(_mm256_set1_epi32(row->x), _mm256_mullo_epi32(_mm256_set1_epi32(row->step_x), lane));
+	__m256i y = _mm256_add_epi32(_mm256_set1_epi32(row->y), _mm256_mullo_epi32(_mm256_set1_epi32(row->step_y), lane));
+	__m256i step_x = _mm256_set1_epi32(row->step_x * 8);
+	__m256i step_y = _mm256_set1_epi32(row->step_y * 8);
+
+	__m128i u_shift = _mm_cvtsi32_si128(16 - row->width_shift);
+	__m128i v_shift = _mm_cvtsi32_si128(16 - row->height_shift);
+	__m128i column_shift = _mm_cvtsi32_si128(row->height_shift);
+	__m256i width_mask = _mm256_set1_epi32((1u << row->width_shift) - 1);
+	__m256i height_mask = _mm256_set1_epi32((1u << row->height_shift) - 1);
+
+	// a 1x1 texture is a flat color, no texel coordinates are needed for it
+	int flat = row->width_shift == 0 && row->height_shift == 0;
+	__m256i flat_color = _mm256_set1_epi32(row->texels[0]);
+
+	int i = 0;
+	for (; i + 8 <= row->count; i += 8, x = _mm256_add_epi32(x, step_x), y = _mm256_add_epi32(y, step_y)) {
+		__m256i mask = raycast_row_mask_avx2(row, i);
+		if (_mm256_testz_si256(mask, mask)) continue;
+
+		__m256i texel = flat_color;
+		if (!flat) {
+			__m256i u = _mm256_and_si256(_mm256_srl_epi32(x, u_shift), width_mask);
+			__m256i v = _mm256_and_si256(_mm256_srl_epi32(y, v_shift), height_mask);
+			__m256i index = _mm256_add_epi32(_mm256_sll_epi32(u, column_shift), v);
+			texel = _mm256_mask_i32gather_epi32(flat_color, (const int *)row->texels, index, mask, 4);
+		}
+
+		_mm256_maskstore_epi32((int *)(row->pixels + i), mask, texel);
+		if (row->depths != NULL) raycast_depth_store_avx2(row->depths + i, mask, row->depth);
+	}
+
+	raycast_texture_row_tail(row, i);
+}
+
+// raycast_shade_sse2 for 8 texels
+__attribute__((target("avx2")))
+static inline __m256i raycast_shade_avx2(__m256i texel, __m256i light) {
+	__m256i scale = _mm256_add_epi32(light, _mm256_set1_epi32(1));
+	__m256i low_bytes = _mm256_set1_epi32(0x00ff00ff);
+	scale = _mm256_or_si256(scale, _mm256_slli_epi32(scale, 16));
+
+	__m256i red_blue = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(texel, 8), low_bytes), scale), 8);
+	__m256i green = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(texel, low_bytes), scale), 8);
+
+	return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(red_blue, 8), _mm256_and_si256(green, _mm256_set1_epi32(0x00ff0000))), _mm256_and_si256(texel, _mm256_set1_epi32(0xff)));
+}
+
+__attribute__((target("avx2")))
+static inline void raycast_cell_step_avx2(__m256i* cell, __m256i* fraction, __m256i cell_step, __m256i fraction_step) {
+	*fraction = _mm256_add_epi32(*fraction, fraction_step);
+	*cell = _mm256_add_epi32(*cell, _mm256_add_epi32(cell_step, _mm256_srli_epi32(*fraction, 16)));
+	*fraction = _mm256_and_si256(*fraction, _mm256_set1_epi32(0xffff));
+}
+
+/*
+AVX2 kernel for rows that change texture or light from cell to cell, 8 lanes at a time, only the texture and light
+of each lane's cell are fetched one by one, the texel coordinates are shifted by every lane's own texture size
+and the texels gathered from the atlas
+*/
+__attribute__((target("avx2")))
+static void raycast_texture_cell_row_avx2(const raycast_cell_row_t* cell_row) {
+	const raycast_row_t *row = &cell_row->row;
+
+	uint32_t cell_x[8], cell_y[8], fraction_x[8], fraction_y[8];
+	int32_t cell_step_x, cell_step_y, fraction_step_x, fraction_step_y;
+
+	raycast_cell_lanes(cell_row->x, cell_row->step_x, 8, cell_x, fraction_x, &cell_step_x, &fraction_step_x);
+	raycast_cell_lanes(cell_row->y, cell_row->step_y, 8, cell_y, fraction_y, &cell_step_y, &fraction_step_y);
+
+	__m256i cells_x = _mm256_loadu_si256((const __m256i *)cell_x);
+	__m256i cells_y = _mm256_loadu_si256((const __m256i *)cell_y);
+	__m256i fractions_x = _mm256_loadu_si256((const __m256i *)fraction_x);
+	__m256i fractions_y = _mm256_loadu_si256((const __m256i *)fraction_y);
+
+	__m256i cell_steps_x = _mm256_set1_epi32(cell_step_x);
+	__m256i cell_steps_y = _mm256_set1_epi32(cell_step_y);
+	__m256i fraction_steps_x = _mm256_set1_epi32(fraction_step_x);
+	__m256i fraction_steps_y = _mm256_set1_epi32(fraction_step_y);
+
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i sixteen = _mm256_set1_epi32(16);
+
+	int i = 0;
+	for (; i + 8 <= row->count; i += 8, raycast_cell_step_avx2(&cells_x, &fractions_x, cell_steps_x, fraction_steps_x), raycast_cell_step_avx2(&cells_y, &fractions_y, cell_steps_y, fraction_steps_y)) {
+		__m256i mask = raycast_row_mask_avx2(row, i);
+		int visible = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+		if (visible == 0) continue;
+
+		_mm256_storeu_si256((__m256i *)cell_x, cells_x);
+		_mm256_storeu_si256((__m256i *)cell_y, cells_y);
+
+		uint32_t offset[8] = {0}, width_shift[8] = {0}, height_shift[8] = {0};
+		uint32_t light[8] = {255, 255, 255, 255, 255, 255, 255, 255};
+		int32_t drawn[8] = {0};
+
+		for (int lane = 0; lane < 8; lane++) {
+			if (!(visible & (1 << lane))) continue;
+
+			uint8_t cell_light;
+			const raycast_texture_t *texture = raycast_cell_row_fetch(cell_row, (int32_t)cell_x[lane], (int32_t)cell_y[lane], &cell_light);
+			if (texture == NULL) continue;
+
+			offset[lane] = texture->offset;
+			width_shift[lane] = texture->width_shift;
+			height_shift[lane] = texture->height_shift;
+			light[lane] = cell_light;
+			drawn[lane] = -1;
+		}
+
+		mask = _mm256_loadu_si256((const __m256i *)drawn);
+		if (_mm256_testz_si256(mask, mask)) continue;
+
+		__m256i width_shifts = _mm256_loadu_si256((const __m256i *)width_shift);
+		__m256i height_shifts = _mm256_loadu_si256((const __m256i *)height_shift);
+
+		__m256i u = _mm256_and_si256(_mm256_srlv_epi32(fractions_x, _mm256_sub_epi32(sixteen, width_shifts)), _mm256_sub_epi32(_mm256_sllv_epi32(one, width_shifts), one));
+		__m256i v = _mm256_and_si256(_mm256_srlv_epi32(fractions_y, _mm256_sub_epi32(sixteen, height_shifts)), _mm256_sub_epi32(_mm256_sllv_epi32(one, height_shifts), one));
+		__m256i index = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)offset), _mm256_add_epi32(_mm256_sllv_epi32(u, height_shifts), v));
+
+		__m256i color = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)cell_row->atlas->texels, index, mask, 4);
+		if (cell_row->lightmap != NULL) color = raycast_shade_avx2(color, _mm256_loadu_si256((const __m256i *)light));
+
+		_mm256_maskstore_epi32((int *)(row->pixels + i), mask, color);
+		if (row->depths != NULL) raycast_depth_store_avx2(row->depths + i, mask, row->depth);
+	}
+
+	raycast_texture_cell_row_tail(cell_row, i);
+}
+
+#endif
+
+// the row kernel used by every renderer, picked once from what the cpu supports
+static raycast_row_kernel_t raycast_row_kernel = raycast_texture_row_scalar;
+static raycast_cell_row_kernel_t raycast_cell_row_kernel = raycast_texture_cell_row_scalar;
+
+static void raycast_select_kernels(void) {
+#ifdef RAYCAST_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		raycast_row_kernel = raycast_texture_row_avx2;
+		raycast_cell_row_kernel = raycast_texture_cell_row_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		raycast_row_kernel = raycast_texture_row_sse2;
+		raycast_cell_row_kernel = raycast_texture_cell_row_sse2;
+	}
+#endif
+
+#ifdef RAYCAST_SIMD_DDA
+	if (__builtin_cpu_supports("avx2")) {
+		raycast_rays_kernel = raycast_DDA_rays_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		raycast_rays_kernel = raycast_DDA_rays_sse2;
+	}
+#endif
+}
+
+/*
+draws one floor or ceiling row straight from the atlas, world coordinates are stepped in 16.16 fixed point,
+64 bits wide since rows near the horizon reach very far, the integer part is the cell and the top bits
+of the fraction are the texel, so no floating point work is left in the loop, unlit rows with one texture
+for every cell don't need the cell and are handed to the row kernel, the rest to the cell row kernel
+*/
+static void raycast_texture_row(raycast_renderer_t* renderer, raycast_scene_t* scene, int y, int is_floor, raycast_real_t floor_x, raycast_real_t floor_y, raycast_real_t floor_step_x, raycast_real_t floor_step_y, raycast_depth_t depth) {
+	const raycast_texture_atlas_t *atlas = scene->textures;
+	const uint8_t *cell_textures = is_floor ? atlas->floor_map : atlas->ceiling_map;
+	const raycast_texture_t *texture = raycast_atlas_texture(atlas, is_floor ? atlas->floor_texture : atlas->ceiling_texture);
+
+	// a tiled map with this layer replaces the atlas' map
+	const raycast_tiled_map_t *tiled = scene->tiled_map;
+	uint32_t layer = is_floor ? raycast_layer_floor : raycast_layer_ceiling;
+
+	if (tiled != NULL && layer >= tiled->layer_count) tiled = NULL;
+	if (tiled != NULL) cell_textures = NULL;
+
+	if (cell_textures == NULL && tiled == NULL && texture == NULL) return;
+
+	const raycast_lightmap_t *lightmap = raycast_scene_lightmap(scene);
+	raycast_face_t face = is_floor ? raycast_bottom : raycast_top;
+
+	int w = renderer->screen_width;
+	uint32_t *pixels = renderer->pixel_data + y * w;
+	raycast_depth_t *depths = renderer->column_depth ? NULL : renderer->depth_buffer + y * w;
+
+	int64_t fixed_x = (int64_t)(floor_x * 65536);
+	int64_t fixed_y = (int64_t)(floor_y * 65536);
+	int64_t fixed_step_x = (int64_t)(floor_step_x * 65536);
+	int64_t fixed_step_y = (int64_t)(floor_step_y * 65536);
+
+	raycast_row_t row = {pixels, depths, w, depth, (uint32_t)fixed_x, (uint32_t)fixed_y, (uint32_t)fixed_step_x, (uint32_t)fixed_step_y, NULL, 0, 0, renderer->wall_starts, renderer->wall_ends, y};
+
+	if (cell_textures == NULL && tiled == NULL && lightmap == NULL) {
+		row.texels = atlas->texels + texture->offset;
+		row.width_shift = texture->width_shift;
+		row.height_shift = texture->height_shift;
+
+		raycast_row_kernel(&row);
+		return;
+	}
+
+	raycast_cell_row_t cell_row = {row, fixed_x, fixed_y, fixed_step_x, fixed_step_y, atlas, texture, cell_textures, tiled, layer, scene->world_width, scene->world_height, lightmap, face};
+
+	if (raycast_cell_row_fits(&cell_row)) {
+		raycast_cell_row_kernel(&cell_row);
+	} else {
+		raycast_texture_cell_row_scalar(&cell_row);
+	}
+}
+
+static void raycast_render_walls_band(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera, raycast_scratch_t* scratch, int x_start, int x_end) {
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	raycast_surface_span_t span;
+
+	int textured = raycast_surfaces_textured(renderer, scene);
+	const raycast_lightmap_t *lightmap = raycast_scene_lightmap(scene);
+
+	raycast_vector_t ray_dirs[RAYCAST_PACKET_SIZE];
+
+	/*
+	hit information of each ray will be located in this array,
+	some names will not match what the variable represents
+	*/
+	raycast_hit_info_t hits[RAYCAST_PACKET_SIZE];
+
+	const raycast_distance_field_t *field = raycast_field_fits(renderer->distance_field, scene) ? renderer->distance_field : NULL;
+
+	for (int packet_x = x_start; packet_x < x_end; packet_x += RAYCAST_PACKET_SIZE) {
+		int lanes = x_end - packet_x < RAYCAST_PACKET_SIZE ? x_end - packet_x : RAYCAST_PACKET_SIZE;
+
+		for (int lane = 0; lane < lanes; lane++) {
+			// ranges from -0.5 to 0.5 depending on x
+			raycast_real_t camera_x = ((packet_x + lane) / (raycast_real_t)w * 2 - 1) / 2;
+
+			// ray directions
+			ray_dirs[lane].x = camera->direction.x * camera->focal_length + camera->plane.x * camera_x;
+			ray_dirs[lane].y = camera->direction.y * camera->focal_length + camera->plane.y * camera_x;
+		}
+
+		// a packet is only cast again if one of its columns is dirty, the rays are the same so are the hits
+		raycast_frame_cache_t *cache = renderer->frame_cache;
+		int cast = cache == NULL || memchr(cache->dirty + packet_x, 1, lanes) != NULL;
+
+		if (cast) {
+			// cast the packet, assume ray length is 1 for faster performance and to calculate perpendicular distance instead of euclidean
+			if (field != NULL) {
+				for (int lane = 0; lane < lanes; lane++) {
+					raycast_DDA_field(hits + lane, scene, field, camera->position.x, camera->position.y, ray_dirs[lane].x, ray_dirs[lane].y, 1);
+				}
+			} else {
+				raycast_DDA_packet(hits, scene, camera->position.x, camera->position.y, ray_dirs, 1, lanes);
+			}
+
+			if (cache != NULL) {
+				memcpy(cache->hits + packet_x, hits, lanes * sizeof(raycast_hit_info_t));
+				memset(cache->dirty + packet_x, 0, lanes);
+			}
+		} else {
+			memcpy(hits, cache->hits + packet_x, lanes * sizeof(raycast_hit_info_t));
+		}
+
+		for (int lane = 0; lane < lanes; lane++) {
+			int x = packet_x + lane;
+			raycast_real_t ray_dir_x = ray_dirs[lane].x;
+			raycast_real_t ray_dir_y = ray_dirs[lane].y;
+			raycast_hit_info_t hit_info = hits[lane];
+
+			// every step moves the ray one cell along one axis
+			if (cast) RAYCAST_PROFILE_ADD(scratch, dda_steps, abs((int)hit_info.hit_point.x - (int)camera->position.x) + abs((int)hit_info.hit_point.y - (int)camera->position.y));
+
+			// if we hit out of the map, don't draw anything
+			if (hit_info.wall_type == 0) {
+				raycast_set_column_wall(renderer, x, 0, 0, RAYCAST_DEPTH_CLEAR);
+				continue;
+			}
+
+			//calculate value of wall_x
+			raycast_real_t wall_x; //where exactly the wall was hit
+			if (hit_info.face == raycast_east || hit_info.face == raycast_west) {
+				wall_x = camera->position.y + hit_info.distance * ray_dir_y;
+			} else {
+				wall_x = camera->position.x + hit_info.distance * ray_dir_x;
+			}
+			wall_x -= raycast_floor(wall_x);
+
+			// the height of the vertical column
+			int line_height = (int)(h / hit_info.distance);
+
+			// where to offset endpoints from
+			int column_center = h / 2 + camera->pitch + (int)(h * camera->height / hit_info.distance);
+
+			// calculate the starting and ending pixel coordinates of the column to draw
+			int draw_start = column_center - (int)(line_height * scene->wall_height - (raycast_real_t)line_height / 2);
+			int draw_end = column_center + line_height / 2;
+
+			// How much to increase the texture coordinate per screen pixel
+			raycast_real_t step = (raycast_real_t)1 / (draw_end - draw_start);
+
+			//Starting texture coordinate
+			raycast_real_t wall_y = draw_start < 0 ? abs(draw_start) * step : 0;
+
+			// constrain draw_start and draw_end to be within the range 0 - screen_height
+			if (draw_start < 0) draw_start = 0;
+			if (draw_end >= h) draw_end = h;
+
+			RAYCAST_PROFILE_ADD(scratch, walls_shaded, draw_end > draw_start ? draw_end - draw_start : 0);
+
+			// the whole column is one face of one cell, so it has one light
+			uint8_t light = raycast_light_at(lightmap, (int64_t)hit_info.hit_point.x, (int64_t)hit_info.hit_point.y, hit_info.face);
+
+			if (textured) {
+				const raycast_texture_t *texture = raycast_atlas_texture(scene->textures, scene->textures->wall_textures[hit_info.wall_type][hit_info.face]);
+
+				if (texture != NULL) {
+					raycast_texture_column(renderer, scene->textures, texture, x, draw_start, draw_end, wall_x, wall_y, step, light);
+					raycast_set_column_wall(renderer, x, draw_start, draw_end, raycast_to_depth(hit_info.distance));
+				} else {
+					raycast_set_column_wall(renderer, x, 0, 0, RAYCAST_DEPTH_CLEAR);
+				}
+				continue;
+			}
+
+			raycast_surface_span_init(&span, scratch, hit_info.face);
+
+			for (int y = draw_start; y < draw_end; y++) {
+				int index = x + w * y;
+				uint32_t i = span.count++;
+
+				span.map_x[i] = hit_info.hit_point.x;
+				span.map_y[i] = hit_info.hit_point.y;
+				span.unit_x[i] = wall_x;
+				span.unit_y[i] = wall_y;
+				span.depth[i] = hit_info.distance;
+				span.pixels[i] = renderer->pixel_data + index;
+				span.locations[i] = index;
+				span.light[i] = light;
+
+				wall_y += step;
+			}
+
+			raycast_set_column_wall(renderer, x, draw_start, draw_end, raycast_to_depth(hit_info.distance));
+
+			if (span.count != 0) raycast_emit_surface_span(renderer, &span);
+		}
+	}
+}
+
+static void raycast_render_walls_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int w = job->renderer->screen_width;
+
+	raycast_render_walls_band(job->renderer, job->scene, job->camera, job->renderer->scratch + band, raycast_band_start(w, band, band_count), raycast_band_start(w, band + 1, band_count));
+}
+
+/*
+state of one column of a scene with cell heights, rows [top_clip, bottom_clip) are the ones nothing has been
+drawn on yet, every surface takes rows off one end of that range, so the column is full once it is empty
+*/
+typedef struct {
+	raycast_renderer_t *renderer;
+	raycast_scene_t *scene;
+	raycast_camera_t *camera;
+	raycast_scratch_t *scratch;
+	const raycast_lightmap_t *lightmap;
+	int x, horizon, textured;
+	raycast_real_t eye, ray_dir_x, ray_dir_y;
+	int top_clip, bottom_clip;
+} raycast_height_column_t;
+
+// 1 if the scene's surfaces are drawn a column at a time with cell heights, see raycast_height_column
+static inline int raycast_scene_heights(const raycast_scene_t* scene) {
+	return scene->cell_heights != NULL && (scene->world_map != NULL || scene->tiled_map != NULL);
+}
+
+// first row at or below where height z is seen at a distance, clamped to the screen
+static inline int raycast_height_row(const raycast_height_column_t* column, raycast_real_t z, raycast_real_t distance) {
+	int h = column->renderer->screen_height;
+	raycast_real_t y = column->horizon + (column->eye - z) * h / distance;
+
+	if (y <= 0) return 0;
+	if (y >= h) return h;
+
+	int row = (int)y;
+	return row < y ? row + 1 : row;
+}
+
+// writes one depth to rows [y_start, y_end) of the column, nothing in column depth mode
+static void raycast_height_depths(const raycast_height_column_t* column, int y_start, int y_end, raycast_depth_t depth) {
+	raycast_renderer_t *renderer = column->renderer;
+	if (renderer->column_depth) return;
+
+	int w = renderer->screen_width;
+	raycast_depth_t *pixel_depth = renderer->depth_buffer + column->x + w * y_start;
+
+	for (int y = y_start; y < y_end; y++, pixel_depth += w) {
+		*pixel_depth = depth;
+	}
+}
+
+// texture of the floor or ceiling of a cell, the same lookup raycast_texture_row makes, NULL if nothing is drawn there
+static const raycast_texture_t* raycast_plane_texture(const raycast_scene_t* scene, int is_floor, int64_t cell_x, int64_t cell_y) {
+	const raycast_texture_atlas_t *atlas = scene->textures;
+	const raycast_tiled_map_t *tiled = scene->tiled_map;
+	const uint8_t *cell_textures = is_floor ? atlas->floor_map : atlas->ceiling_map;
+	uint32_t layer = is_floor ? raycast_layer_floor : raycast_layer_ceiling;
+
+	if (tiled != NULL && layer >= tiled->layer_count) tiled = NULL;
+	if (tiled == NULL && cell_textures == NULL) return raycast_atlas_texture(atlas, is_floor ? atlas->floor_texture : atlas->ceiling_texture);
+
+	if (cell_x < 0 || cell_y < 0 || cell_x >= scene->world_width || cell_y >= scene->world_height) return NULL;
+
+	if (tiled != NULL) return raycast_atlas_texture(atlas, raycast_tiled_cell(tiled, layer, cell_x, cell_y));
+	return raycast_atlas_texture(atlas, cell_textures[cell_x + scene->world_width * cell_y]);
+}
+
+/*
+draws rows [y_start, y_end) of the column as a floor (the top of a cell) or ceiling at height z, the
+distance of every row is found from how far it is from the horizon, like the rows of a flat floor
+*/
+static void raycast_height_plane(raycast_height_column_t* column, int y_start, int y_end, raycast_real_t z, int is_floor) {
+	if (y_start >= y_end) return;
+
+	raycast_renderer_t *renderer = column->renderer;
+	raycast_camera_t *camera = column->camera;
+
+	if (!renderer->render_top_bottom || !(is_floor ? renderer->render_bottom : renderer->render_top)) {
+		raycast_height_depths(column, y_start, y_end, RAYCAST_DEPTH_CLEAR);
+		return;
+	}
+
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	// height of the camera above a floor or below a ceiling, in rows at a distance of 1
+	raycast_real_t plane_z = (is_floor ? column->eye - z : z - column->eye) * h;
+	raycast_face_t face = is_floor ? raycast_bottom : raycast_top;
+
+	raycast_surface_span_t span;
+	raycast_surface_span_init(&span, column->scratch, face);
+
+	for (int y = y_start; y < y_end; y++) {
+		int p = is_floor ? y - column->horizon : column->horizon - y;
+		raycast_real_t distance = p <= 0 ? 1e9 : plane_z / p;
+		raycast_depth_t depth = raycast_to_depth(distance);
+
+		raycast_real_t floor_x = camera->position.x + distance * column->ray_dir_x;
+		raycast_real_t floor_y = camera->position.y + distance * column->ray_dir_y;
+
+		int index = column->x + w * y;
+		if (!renderer->column_depth) renderer->depth_buffer[index] = depth;
+
+		if (column->textured) {
+			int64_t fixed_x = (int64_t)(floor_x * 65536);
+			int64_t fixed_y = (int64_t)(floor_y * 65536);
+
+			const raycast_texture_t *texture = raycast_plane_texture(column->scene, is_floor, fixed_x >> 16, fixed_y >> 16);
+			if (texture == NULL) continue;
+
+			uint32_t u = (uint32_t)(fixed_x >> (16 - texture->width_shift)) & ((1u << texture->width_shift) - 1);
+			uint32_t v = (uint32_t)(fixed_y >> (16 - texture->height_shift)) & ((1u << texture->height_shift) - 1);
+
+			uint32_t texel = column->scene->textures->texels[texture->offset + (u << texture->height_shift) + v];
+
+			renderer->pixel_data[index] = column->lightmap == NULL ? texel : raycast_shade(texel, raycast_light_at(column->lightmap, fixed_x >> 16, fixed_y >> 16, face));
+			continue;
+		}
+
+		int cell_x = (int)floor_x;
+		int cell_y = (int)floor_y;
+		uint32_t i = span.count++;
+
+		span.map_x[i] = cell_x;
+		span.map_y[i] = cell_y;
+		span.unit_x[i] = raycast_fabs(floor_x - cell_x);
+		span.unit_y[i] = raycast_fabs(floor_y - cell_y);
+		span.depth[i] = distance;
+		span.pixels[i] = renderer->pixel_data + index;
+		span.locations[i] = index;
+		span.light[i] = raycast_light_at(column->lightmap, floor_x < 0 ? -1 : cell_x, floor_y < 0 ? -1 : cell_y, face);
+	}
+
+	RAYCAST_PROFILE_ADD(column->scratch, top_bottom_shaded, y_end - y_start);
+
+	if (!column->textured && span.count != 0) raycast_emit_surface_span(renderer, &span);
+}
+
+/*
+draws rows [y_start, y_end) of the column as the side of the cell the ray hit, the side of a wall cell uses
+its wall type's textures and the step up to a higher empty cell uses those of wall type 0, textures repeat
+every unit of height and line up with the top of the side
+*/
+static void raycast_height_face(raycast_height_column_t* column, int y_start, int y_end, const raycast_hit_info_t* hit, raycast_real_t top) {
+	if (y_start >= y_end) return;
+
+	raycast_renderer_t *renderer = column->renderer;
+	raycast_camera_t *camera = column->camera;
+	raycast_depth_t depth = raycast_to_depth(hit->distance);
+
+	if (!renderer->render_walls) {
+		raycast_height_depths(column, y_start, y_end, RAYCAST_DEPTH_CLEAR);
+		return;
+	}
+
+	raycast_height_depths(column, y_start, y_end, depth);
+
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	raycast_real_t wall_x;
+	if (hit->face == raycast_east || hit->face == raycast_west) {
+		wall_x = camera->position.y + hit->distance * column->ray_dir_y;
+	} else {
+		wall_x = camera->position.x + hit->distance * column->ray_dir_x;
+	}
+	wall_x -= raycast_floor(wall_x);
+
+	// how far below the top of the side the first row is, and how much further down every row after it is
+	raycast_real_t step = hit->distance / h;
+	raycast_real_t wall_y = top - column->eye + (y_start - column->horizon) * step;
+
+	RAYCAST_PROFILE_ADD(column->scratch, walls_shaded, y_end - y_start);
+
+	uint8_t light = raycast_light_at(column->lightmap, (int64_t)hit->hit_point.x, (int64_t)hit->hit_point.y, hit->face);
+
+	if (column->textured) {
+		const raycast_texture_atlas_t *atlas = column->scene->textures;
+		const raycast_texture_t *texture = raycast_atlas_texture(atlas, atlas->wall_textures[hit->wall_type][hit->face]);
+		if (texture == NULL) return;
+
+		uint32_t height_mask = (1u << texture->height_shift) - 1;
+		uint32_t u = (uint32_t)(wall_x * (1 << texture->width_shift)) & ((1u << texture->width_shift) - 1);
+		const uint32_t *texels = atlas->texels + texture->offset + (u << texture->height_shift);
+
+		// the top of a side can be above its first row, the fixed point position wraps with the texture
+		uint32_t v = (uint32_t)(int64_t)(wall_y * (1 << texture->height_shift) * 65536);
+		uint32_t v_step = (uint32_t)(int64_t)(step * (1 << texture->height_shift) * 65536);
+		uint32_t *pixel = renderer->pixel_data + column->x + w * y_start;
+
+		for (int y = y_start; y < y_end; y++, pixel += w) {
+			*pixel = light == 255 ? texels[(v >> 16) & height_mask] : raycast_shade(texels[(v >> 16) & height_mask], light);
+			v += v_step;
+		}
+		return;
+	}
+
+	raycast_surface_span_t span;
+	raycast_surface_span_init(&span, column->scratch, hit->face);
+
+	for (int y = y_start; y < y_end; y++) {
+		int index = column->x + w * y;
+		uint32_t i = span.count++;
+
+		span.map_x[i] = hit->hit_point.x;
+		span.map_y[i] = hit->hit_point.y;
+		span.unit_x[i] = wall_x;
+		span.unit_y[i] = wall_y - raycast_floor(wall_y);
+		span.depth[i] = hit->distance;
+		span.pixels[i] = renderer->pixel_data + index;
+		span.locations[i] = index;
+		span.light[i] = light;
+
+		wall_y += step;
+	}
+
+	raycast_emit_surface_span(renderer, &span);
+}
+
+/*
+walks the column's ray through the map front to back, every cell it passes adds the ceiling above it and its top
+up to where the ray leaves it, and the next cell adds its side where it is higher, each clipped to the rows still
+open, so the walk stops as soon as the column is full and nothing is drawn over, rays that leave the map see
+the floor and ceiling planes going on forever, the depth of the surface that filled the column is kept in the
+wall arrays for sprite culling, so in column depth mode sprites are only hidden by it
+*/
+static void raycast_height_column(raycast_height_column_t* column) {
+	raycast_renderer_t *renderer = column->renderer;
+	raycast_scene_t *scene = column->scene;
+	raycast_camera_t *camera = column->camera;
+	raycast_real_t ceiling = scene->top_height;
+
+	raycast_ray_t ray;
+	raycast_ray_setup(&ray, camera->position.x, camera->position.y, column->ray_dir_x, column->ray_dir_y, 1);
+
+	raycast_real_t z = scene->bottom_height;
+	if (!raycast_ray_outside(&ray, scene)) z = raycast_cell_top(scene, raycast_world_cell(scene, ray.map_x, ray.map_y), ray.map_x, ray.map_y);
+
+	raycast_hit_info_t hit;
+	hit.distance = 0;
+	int left_map = 0;
+
+	while (column->top_clip < column->bottom_clip) {
+		raycast_ray_step(&ray);
+		raycast_ray_finish(&hit, &ray, 0);
+
+		if (column->eye < ceiling) {
+			int row = raycast_height_row(column, ceiling, hit.distance);
+			if (row > column->bottom_clip) row = column->bottom_clip;
+
+			raycast_height_plane(column, column->top_clip, row, ceiling, 0);
+			if (row > column->top_clip) column->top_clip = row;
+		}
+
+		if (column->eye > z) {
+			int row = raycast_height_row(column, z, hit.distance);
+			if (row < column->top_clip) row = column->top_clip;
+
+			raycast_height_plane(column, row, column->bottom_clip, z, 1);
+			if (row < column->bottom_clip) column->bottom_clip = row;
+		}
+
+		if (column->top_clip >= column->bottom_clip) break;
+
+		if (raycast_ray_outside(&ray, scene)) {
+			left_map = 1;
+			break;
+		}
+
+		hit.wall_type = raycast_world_cell(scene, ray.map_x, ray.map_y);
+		raycast_real_t top = raycast_cell_top(scene, hit.wall_type, ray.map_x, ray.map_y);
+
+		if (top > z) {
+			int row = raycast_height_row(column, top < ceiling ? top : ceiling, hit.distance);
+			if (row < column->top_clip) row = column->top_clip;
+
+			raycast_height_face(column, row, column->bottom_clip, &hit, top);
+			if (row < column->bottom_clip) column->bottom_clip = row;
+		}
+
+		// nothing is seen through a cell up to the ceiling
+		if (top >= ceiling) break;
+
+		z = top;
+	}
+
+	if (left_map) {
+		int horizon_end = column->horizon + 1 < 0 ? 0 : column->horizon + 1;
+		int ceiling_end = horizon_end < column->bottom_clip ? horizon_end : column->bottom_clip;
+		int floor_start = horizon_end > column->top_clip ? horizon_end : column->top_clip;
+
+		if (column->eye < ceiling) {
+			raycast_height_plane(column, column->top_clip, ceiling_end, ceiling, 0);
+			column->top_clip = ceiling_end > column->top_clip ? ceiling_end : column->top_clip;
+		}
+
+		if (column->eye > scene->bottom_height) {
+			raycast_height_plane(column, floor_start, column->bottom_clip, scene->bottom_height, 1);
+			column->bottom_clip = floor_start < column->bottom_clip ? floor_start : column->bottom_clip;
+		}
+	}
+
+	int full = column->top_clip >= column->bottom_clip && !left_map;
+
+	raycast_height_depths(column, column->top_clip, column->bottom_clip, RAYCAST_DEPTH_CLEAR);
+
+	renderer->wall_depths[column->x] = full ? raycast_to_depth(hit.distance) : RAYCAST_DEPTH_CLEAR;
+	renderer->wall_starts[column->x] = 0;
+	renderer->wall_ends[column->x] = full ? (int)renderer->screen_height : 0;
+}
+
+static void raycast_render_heights_band(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera, raycast_scratch_t* scratch, int x_start, int x_end) {
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	raycast_height_column_t column;
+	column.renderer = renderer;
+	column.scene = scene;
+	column.camera = camera;
+	column.scratch = scratch;
+	column.horizon = h / 2 + camera->pitch;
+	column.textured = raycast_surfaces_textured(renderer, scene);
+	column.lightmap = raycast_scene_lightmap(scene);
+	column.eye = camera->height + (raycast_real_t)0.5;
+
+	for (int x = x_start; x < x_end; x++) {
+		// ranges from -0.5 to 0.5 depending on x
+		raycast_real_t camera_x = (x / (raycast_real_t)w * 2 - 1) / 2;
+
+		column.x = x;
+		column.ray_dir_x = camera->direction.x * camera->focal_length + camera->plane.x * camera_x;
+		column.ray_dir_y = camera->direction.y * camera->focal_length + camera->plane.y * camera_x;
+		column.top_clip = 0;
+		column.bottom_clip = h;
+
+		raycast_height_column(&column);
+	}
+}
+
+static void raycast_render_heights_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int w = job->renderer->screen_width;
+
+	raycast_render_heights_band(job->renderer, job->scene, job->camera, job->renderer->scratch + band, raycast_band_start(w, band, band_count), raycast_band_start(w, band + 1, band_count));
+}
+
+/*
+copies the walls of a band of rows from the transposed wall target to the screen, rows are done
+RAYCAST_RESOLVE_ROWS at a time so each column's part of the strip is one cache line read and the
+strip's rows stay in cache
+*/
+static void raycast_resolve_walls_band(raycast_renderer_t* renderer, int band_start, int band_end) {
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	for (int strip_start = band_start; strip_start < band_end; strip_start += RAYCAST_RESOLVE_ROWS) {
+		int strip_end = band_end - strip_start < RAYCAST_RESOLVE_ROWS ? band_end : strip_start + RAYCAST_RESOLVE_ROWS;
+
+		for (int x = 0; x < w; x++) {
+			int start = renderer->wall_starts[x] > strip_start ? renderer->wall_starts[x] : strip_start;
+			int end = renderer->wall_ends[x] < strip_end ? renderer->wall_ends[x] : strip_end;
+
+			const uint32_t *source = renderer->wall_pixels + h * x;
+			uint32_t *pixel = renderer->pixel_data + x;
+
+			for (int y = start; y < end; y++) {
+				pixel[w * y] = source[y];
+			}
+		}
+	}
+}
+
+static void raycast_resolve_walls_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int h = job->renderer->screen_height;
+
+	raycast_resolve_walls_band(job->renderer, raycast_band_start(h, band, band_count), raycast_band_start(h, band + 1, band_count));
+}
+
+// 1 if two cameras cast the same wall rays
+static int raycast_same_rays(const raycast_camera_t* a, const raycast_camera_t* b) {
+	return a->position.x == b->position.x && a->position.y == b->position.y &&
+		a->direction.x == b->direction.x && a->direction.y == b->direction.y &&
+		a->plane.x == b->plane.x && a->plane.y == b->plane.y && a->focal_length == b->focal_length;
+}
+
+// 1 if two cameras see exactly the same frame
+static int raycast_same_view(const raycast_camera_t* a, const raycast_camera_t* b) {
+	return raycast_same_rays(a, b) && a->height == b->height && a->pitch == b->pitch;
+}
+
+void raycast_render_walls(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
+	raycast_frame_cache_t *cache = renderer->frame_cache;
+
+	// columns of a scene with cell heights are drawn whole straight to the screen, they never use the cached hits
+	if (raycast_scene_heights(scene)) {
+		if (cache != NULL) memset(cache->dirty, 1, renderer->screen_width);
+
+		raycast_render_job_t job = {renderer, scene, camera};
+		raycast_thread_pool_run(renderer->thread_pool, raycast_render_heights_task, &job, raycast_band_count(renderer, renderer->screen_width));
+		return;
+	}
+
+	// cached hits are only valid for the rays, map and frame width they were cast with
+	if (cache != NULL && (!raycast_same_rays(&cache->hit_camera, camera) || cache->world_map != scene->world_map ||
+		cache->tiled_map != scene->tiled_map || cache->world_width != scene->world_width || cache->world_height != scene->world_height || cache->hit_width != renderer->screen_width)) {
+		memset(cache->dirty, 1, renderer->screen_width);
+
+		cache->hit_camera = *camera;
+		cache->hit_width = renderer->screen_width;
+		cache->world_map = scene->world_map;
+		cache->tiled_map = scene->tiled_map;
+		cache->world_width = scene->world_width;
+		cache->world_height = scene->world_height;
+	}
+
+	raycast_render_job_t job = {renderer, scene, camera};
+	raycast_thread_pool_run(renderer->thread_pool, raycast_render_walls_task, &job, raycast_band_count(renderer, renderer->screen_width));
+
+	// only atlas textured walls are drawn to the transposed target, pixel and span functions write the screen directly
+	if (renderer->wall_pixels != NULL && raycast_surfaces_textured(renderer, scene)) {
+		raycast_thread_pool_run(renderer->thread_pool, raycast_resolve_walls_task, &job, raycast_band_count(renderer, renderer->screen_height));
+	}
+}
+
+#ifdef RAYCAST_PROFILE
+/*
+counts the pixels of a textured floor or ceiling row, the row kernels don't count as they go, but before the
+floor and ceiling pass the only depth a pixel can have is its column's wall, so a pixel is rejected exactly
+when the wall of its column hides it (the wall arrays match the depth buffer in both depth modes)
+*/
+static void raycast_profile_row(raycast_renderer_t* renderer, raycast_scratch_t* scratch, int y, raycast_depth_t depth) {
+	uint32_t rejected = 0;
+
+	for (uint32_t x = 0; x < renderer->screen_width; x++) {
+		rejected += renderer->column_depth ? raycast_wall_covers(renderer, x, y) : raycast_wall_hides(renderer, x, y, depth);
+	}
+
+	scratch->stats.top_bottom_rejected += rejected;
+	scratch->stats.top_bottom_shaded += renderer->screen_width - rejected;
+}
+#endif
+
+/*
+distance and depth of the floor or ceiling seen by every row, they only depend on the frame height, the pitch
+and how far the camera is from the floor and ceiling planes, so the table is rebuilt when one of those changes
+instead of dividing for every row of every frame, floors and ceilings at any height cost the same
+*/
+static void raycast_update_row_table(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
+	raycast_row_table_t *table = renderer->row_table;
+
+	int h = renderer->screen_height;
+
+	if (table->valid && table->height == h && table->pitch == camera->pitch && table->camera_height == camera->height &&
+		table->top_height == scene->top_height && table->bottom_height == scene->bottom_height) return;
+	int horizon = h / 2 + camera->pitch;
+
+	// vertical position of the camera above the floor and below the ceiling, 0.5 is the middle between them
+	raycast_real_t floor_z = (camera->height + (raycast_real_t)0.5 - scene->bottom_height) * h;
+	raycast_real_t ceiling_z = (scene->top_height - (camera->height + (raycast_real_t)0.5)) * h;
+
+	for (int y = 0; y < h; y++) {
+		// current y position compared to the center of the screen (the horizon)
+		int p = y - horizon;
+
+		// horizontal distance from the camera to the floor or ceiling for this row
+		raycast_real_t row_distance = p == 0 ? 1e9 : raycast_fabs((y > horizon ? floor_z : ceiling_z) / p);
+
+		table->distances[y] = row_distance;
+		table->depths[y] = raycast_to_depth(row_distance);
+	}
+
+	table->valid = 1;
+	table->height = h;
+	table->pitch = camera->pitch;
+	table->camera_height = camera->height;
+	table->top_height = scene->top_height;
+	table->bottom_height = scene->bottom_height;
+}
+
+/*
+rows above the horizon are ceiling and rows below it are floor, each row only looks up its distance in the
+row table, every row of the band gets its depth from the wall arrays right before it is drawn, rows that
+aren't drawn too, so the depth buffer is only ever written a row at a time and never needs clearing
+*/
+static void raycast_render_top_bottom_band(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera, raycast_scratch_t* scratch, int band_start, int band_end) {
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+	int half_h = h / 2;
+	int horizon = half_h + camera->pitch;
+
+	int render_surfaces = renderer->surface_pixel != NULL || renderer->surface_span != NULL || scene->textures != NULL;
+
+	int y_start = renderer->render_top ? 0 : half_h;
+	int y_end = renderer->render_bottom ? h : half_h;
+
+	if (!render_surfaces || !renderer->render_top_bottom) y_start = y_end = 0;
+
+	raycast_surface_span_t span;
+
+	int textured = raycast_surfaces_textured(renderer, scene);
+	const raycast_lightmap_t *lightmap = raycast_scene_lightmap(scene);
+
+	const raycast_real_t *row_distances = renderer->row_table->distances;
+	const raycast_depth_t *row_depths = renderer->row_table->depths;
+
+	// rayDir for leftmost ray (x = 0) and rightmost ray (x = w)
+	raycast_real_t ray_dir_x0 = camera->direction.x * camera->focal_length - camera->plane.x / 2;
+	raycast_real_t ray_dir_y0 = camera->direction.y * camera->focal_length - camera->plane.y / 2;
+	raycast_real_t ray_dir_x1 = camera->direction.x * camera->focal_length + camera->plane.x / 2;
+	raycast_real_t ray_dir_y1 = camera->direction.y * camera->focal_length + camera->plane.y / 2;
+
+	raycast_real_t ray_span_x = ray_dir_x1 - ray_dir_x0;
+	raycast_real_t ray_span_y = ray_dir_y1 - ray_dir_y0;
+
+	for (int y = band_start; y < band_end; y++) {
+		if (!renderer->column_depth) raycast_fill_row_depth(renderer, y);
+
+		if (y < y_start || y >= y_end) continue;
+
+		// the floor is the bottom face of the world, the ceiling the top face
+		int is_floor = y > horizon;
+		raycast_face_t face = is_floor ? raycast_bottom : raycast_top;
+
+		raycast_real_t row_distance = row_distances[y];
+		raycast_depth_t depth = row_depths[y];
+
+		// calculate the real world step vector we have to add for each x (parallel to camera plane)
+		// adding step by step avoids multiplications with a weight in the inner loop
+		raycast_real_t floor_step_x = row_distance * ray_span_x / w;
+		raycast_real_t floor_step_y = row_distance * ray_span_y / w;
+
+		// real world coordinates of the leftmost column. This will be updated as we step to the right.
+		raycast_real_t floor_x = camera->position.x + row_distance * ray_dir_x0;
+		raycast_real_t floor_y = camera->position.y + row_distance * ray_dir_y0;
+
+		if (textured) {
+			raycast_texture_row(renderer, scene, y, is_floor, floor_x, floor_y, floor_step_x, floor_step_y, depth);
+#ifdef RAYCAST_PROFILE
+			raycast_profile_row(renderer, scratch, y, depth);
+#endif
+			continue;
+		}
+
+		raycast_surface_span_init(&span, scratch, face);
+
+		for (int x = 0; x < w; ++x) {
+			// the cell coord is simply got from the integer parts of floor_x and floor_y
+			int cell_x = (int)floor_x;
+			int cell_y = (int)floor_y;
+
+			// the floating point coordinates within the cell, ranges between 0 - 1
+			raycast_real_t unit_x = floor_x - cell_x;
+			raycast_real_t unit_y = floor_y - cell_y;
+
+			int index = y * w + x;
+
+			if (renderer->column_depth ? !raycast_wall_covers(renderer, x, y) : renderer->depth_buffer[index] > depth) {
+				uint32_t i = span.count++;
+
+				span.map_x[i] = cell_x;
+				span.map_y[i] = cell_y;
+				span.unit_x[i] = raycast_fabs(unit_x);
+				span.unit_y[i] = raycast_fabs(unit_y);
+				span.depth[i] = row_distance;
+				span.pixels[i] = renderer->pixel_data + index;
+				span.locations[i] = index;
+
+				// the cast rounds towards 0, so anything left of or above the map is sent off it by hand
+				span.light[i] = raycast_light_at(lightmap, floor_x < 0 ? -1 : cell_x, floor_y < 0 ? -1 : cell_y, face);
+
+				if (!renderer->column_depth) renderer->depth_buffer[index] = depth;
+			}
+
+			floor_x += floor_step_x;
+			floor_y += floor_step_y;
+		}
+
+		RAYCAST_PROFILE_ADD(scratch, top_bottom_shaded, span.count);
+		RAYCAST_PROFILE_ADD(scratch, top_bottom_rejected, w - span.count);
+
+		if (span.count != 0) raycast_emit_surface_span(renderer, &span);
+	}
+}
+
+static void raycast_render_top_bottom_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int h = job->renderer->screen_height;
+
+	raycast_render_top_bottom_band(job->renderer, job->scene, job->camera, job->renderer->scratch + band, raycast_band_start(h, band, band_count), raycast_band_start(h, band + 1, band_count));
+}
+
+void raycast_render_top_bottom(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
+	if (raycast_scene_heights(scene)) return;
+
+	pthread_once(&raycast_kernels_once, raycast_select_kernels);
+	raycast_update_row_table(renderer, scene, camera);
+
+	raycast_render_job_t job = {renderer, scene, camera};
+	raycast_thread_pool_run(renderer->thread_pool, raycast_render_top_bottom_task, &job, raycast_band_count(renderer, renderer->screen_height));
+}
+
+/*
+draws the visible rows of a sprite straight from the atlas, fully transparent texels (alpha 0)
+are skipped and only fully opaque texels (alpha 255) write to the depth buffer
+*/
+static void raycast_texture_sprite(raycast_renderer_t* renderer, raycast_scratch_t* scratch, const raycast_texture_atlas_t* atlas, const raycast_texture_t* texture, int draw_start_x, int draw_end_x, int draw_start_y, int draw_end_y, int sprite_top, raycast_real_t sprite_percent_x, raycast_real_t step_x, raycast_real_t step, raycast_depth_t depth) {
+	int w = renderer->screen_width;
+
+	uint32_t width_mask = (1u << texture->width_shift) - 1;
+	uint32_t height_mask = (1u << texture->height_shift) - 1;
+
+	uint32_t u_start = (uint32_t)(int64_t)(sprite_percent_x * (1 << texture->width_shift) * 65536);
+	uint32_t u_step = (uint32_t)(int64_t)(step_x * (1 << texture->width_shift) * 65536);
+
+	const uint32_t *texels = atlas->texels + texture->offset;
+
+	for (int y = draw_start_y; y < draw_end_y; y++) {
+		uint32_t v = (uint32_t)((y - sprite_top) * step * (1 << texture->height_shift)) & height_mask;
+		uint32_t u = u_start;
+
+		uint32_t *pixels = renderer->pixel_data + y * w;
+		raycast_depth_t *depths = renderer->column_depth ? NULL : renderer->depth_buffer + y * w;
+
+		for (int x = draw_start_x; x < draw_end_x; x++, u += u_step) {
+			if (depths == NULL ? raycast_wall_hides(renderer, x, y, depth) : depths[x] <= depth) {
+				RAYCAST_PROFILE_ADD(scratch, sprites_rejected, 1);
+				continue;
+			}
+			RAYCAST_PROFILE_ADD(scratch, sprites_shaded, 1);
+
+			uint32_t texel = texels[(((u >> 16) & width_mask) << texture->height_shift) + v];
+			if ((texel & 0xFF) == 0) continue;
+
+			pixels[x] = texel;
+			if ((texel & 0xFF) == 255 && depths != NULL) depths[x] = depth;
+		}
+	}
+}
+
+// orders sprites front to back, ties keep object order so every frame sorts the same way
+static int raycast_sprite_nearer(const void* a, const void* b) {
+	const struct raycast_sprite *sprite_a = (const struct raycast_sprite *)a;
+	const struct raycast_sprite *sprite_b = (const struct raycast_sprite *)b;
+
+	if (sprite_a->distance != sprite_b->distance) return sprite_a->distance < sprite_b->distance ? -1 : 1;
+	return sprite_a->object < sprite_b->object ? -1 : 1;
+}
+
+static int raycast_sprite_further(const void* a, const void* b) {
+	return raycast_sprite_nearer(b, a);
+}
+
+// 1 if the wall of column x is in front of depth and covers every row in [draw_start_y, draw_end_y)
+static inline int raycast_wall_hides_column(const raycast_renderer_t* renderer, int x, int draw_start_y, int draw_end_y, raycast_depth_t depth) {
+	return renderer->wall_depths[x] <= depth && renderer->wall_starts[x] <= draw_start_y && renderer->wall_ends[x] >= draw_end_y;
+}
+
+/*
+projects an object onto the screen, returns 0 if none of it can be seen: it is behind the camera, off the screen,
+or every column of it is hidden behind a wall, columns hidden behind walls at either side are clipped off
+*/
+static int raycast_project_sprite(raycast_renderer_t* renderer, raycast_camera_t* camera, raycast_real_t inv_det, raycast_object_t* object, raycast_sprite_t* sprite) {
+	int w = renderer->screen_width;
+	int h = renderer->screen_height;
+
+	raycast_real_t camera_i_x = camera->plane.x / 2;
+	raycast_real_t camera_i_y = camera->plane.y / 2;
+
+	raycast_real_t camera_j_x = camera->direction.x * camera->focal_length;
+	raycast_real_t camera_j_y = camera->direction.y * camera->focal_length;
+
+	//translate sprite position to relative to camera
+	raycast_real_t sprite_x = object->position.x - camera->position.x;
+	raycast_real_t sprite_y = object->position.y - camera->position.y;
+
+	// sprites coordinates relative to the camera, y coordinate used as depth (z-axis)
+	raycast_real_t transform_x = inv_det * (camera_j_y * sprite_x - camera_j_x * sprite_y);
+	raycast_real_t transform_y = inv_det * (-camera_i_y * sprite_x + camera_i_x * sprite_y);
+
+	// if the sprite is behind us, don't draw it
+	if (transform_y <= 0) return 0;
+
+	// screen coordinates of the sprite's center
+	int sprite_screen_x = (int)((1 + transform_x / transform_y) / 2 * w);
+	int sprite_screen_y = (int)((1 - object->height / transform_y) / 2 * h) + camera->pitch + (int)(h * camera->height / transform_y);
+
+	//calculate height of the sprite on screen
+	int sprite_height = abs((int)(h * (object->size / transform_y)));
+	if (sprite_height == 0) return 0;
+
+	//calculate lowest and highest pixel to fill in current stripe
+	int draw_start_y = sprite_screen_y - sprite_height / 2;
+	int draw_end_y = sprite_screen_y + sprite_height / 2;
+
+	/*
+	calculate width of the sprite, same as its height given that it's square, unless the pixels of a scaled frame
+	aren't, the ratio is exactly 1 otherwise and the rounding keeps a ratio a hair under 1 from taking off a column
+	*/
+	raycast_real_t pixel_ratio = (raycast_real_t)w / h / renderer->aspect_ratio;
+	int sprite_width = (int)(sprite_height * pixel_ratio + (raycast_real_t)0.5);
+	if (sprite_width == 0) return 0;
+	int draw_start_x = sprite_screen_x - sprite_width / 2;
+	int draw_end_x = sprite_screen_x + sprite_width / 2;
+
+	/*
+	rows and columns work out their percentage from their distance to the unclamped top left, an accumulated
+	sum would round differently depending on where a band starts once the compiler reorders it
+	*/
+	sprite->top = draw_start_y;
+	sprite->left = draw_start_x;
+
+	// clamp draw start / end values to fit into the screen
+	if (draw_start_y < 0) draw_start_y = 0;
+	if (draw_end_y >= h) draw_end_y = h;
+	if (draw_start_x < 0) draw_start_x = 0;
+	if (draw_end_x > w) draw_end_x = w;
+
+	if (draw_start_y >= draw_end_y || draw_start_x >= draw_end_x) return 0;
+
+	raycast_depth_t depth = raycast_to_depth(transform_y);
+
+	// clip off the columns at either side that a wall hides completely
+	while (draw_start_x < draw_end_x && raycast_wall_hides_column(renderer, draw_start_x, draw_start_y, draw_end_y, depth)) draw_start_x++;
+	while (draw_start_x < draw_end_x && raycast_wall_hides_column(renderer, draw_end_x - 1, draw_start_y, draw_end_y, depth)) draw_end_x--;
+
+	if (draw_start_x == draw_end_x) return 0;
+
+	sprite->object = object;
+	sprite->distance = transform_y;
+	sprite->depth = depth;
+	sprite->step = (raycast_real_t)1 / sprite_height;
+	sprite->step_x = (raycast_real_t)1 / sprite_width;
+	sprite->percent_x = (raycast_real_t)(draw_start_x - sprite->left) / sprite_width;
+	sprite->draw_start_x = draw_start_x;
+	sprite->draw_end_x = draw_end_x;
+	sprite->draw_start_y = draw_start_y;
+	sprite->draw_end_y = draw_end_y;
+	return 1;
+}
+
+/*
+builds the frame's list of visible sprites, projected once and sorted, opaque sprites go front to back so the depth
+test throws away the pixels they hide before the user is called for them, translucent ones follow back to front
+so they blend over everything behind them, in column depth mode sprites don't test each other and all go back to front
+*/
+static int raycast_build_sprites(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
+	// the list of a renderer with a memory block can't grow, visible objects past its capacity are culled
+	if (scene->object_count > renderer->sprite_capacity && renderer->memory == NULL) {
+		raycast_sprite_t *sprites = (raycast_sprite_t *) realloc(renderer->sprites, scene->object_count * sizeof(raycast_sprite_t));
+		if (sprites == NULL) return -1;
+
+		renderer->sprites = sprites;
+		renderer->sprite_capacity = scene->object_count;
+	}
+
+	raycast_real_t camera_i_x = camera->plane.x / 2;
+	raycast_real_t camera_i_y = camera->plane.y / 2;
+
+	raycast_real_t camera_j_x = camera->direction.x * camera->focal_length;
+	raycast_real_t camera_j_y = camera->direction.y * camera->focal_length;
+
+	//transform sprites with the inverse camera matrix, the same for every sprite
+	raycast_real_t inv_det = (raycast_real_t)1 / (camera_i_x * camera_j_y - camera_j_x * camera_i_y);
+
+	int textured = raycast_sprites_textured(renderer, scene);
+
+	// objects the camera's cell can't see are dropped before any projection work, a batch has already tested them
+	const raycast_visibility_t *visibility = raycast_scene_visibility(scene);
+	const uint64_t *object_views = renderer->object_view_bit != 0 ? renderer->object_views : NULL;
+	const uint32_t *set = NULL;
+
+	if (visibility != NULL && object_views == NULL) set = raycast_visibility_camera_set(visibility, camera);
+
+	// opaque sprites fill the list from the front, translucent ones from the back
+	uint32_t capacity = renderer->sprite_capacity;
+	uint32_t opaque_count = 0;
+	uint32_t translucent_count = 0;
+
+	for (uint32_t i = 0; i < scene->object_count && opaque_count + translucent_count < capacity; i++) {
+		raycast_object_t *object = scene->objects + i;
+		raycast_sprite_t sprite;
+
+		if (object_views != NULL && !(object_views[i] & renderer->object_view_bit)) continue;
+		if (set != NULL && !raycast_visibility_sees_object(visibility, set, object)) continue;
+
+		sprite.texture = NULL;
+		if (textured) {
+			sprite.texture = raycast_atlas_texture(scene->textures, object->texture);
+			if (sprite.texture == NULL) continue;
+		}
+
+		if (!raycast_project_sprite(renderer, camera, inv_det, object, &sprite)) continue;
 
-		// sprite percentage coordinates (ranges from 0 - 1) the current pixel is on
-		double sprite_percent_x = draw_start_x < 0 ? (double)abs(draw_start_x) / sprite_height : 0;
-		double sprite_percent_x_initial = sprite_percent_x;
-		double sprite_percent_y = draw_start_y < 0 ? (double)abs(draw_start_y) / sprite_height : 0;
+		if (object->translucent && !renderer->column_depth) {
+			renderer->sprites[capacity - ++translucent_count] = sprite;
+		} else {
+			renderer->sprites[opaque_count++] = sprite;
+		}
+	}
+
+	// close the gap so the translucent sprites follow the opaque ones
+	memmove(renderer->sprites + opaque_count, renderer->sprites + capacity - translucent_count, translucent_count * sizeof(raycast_sprite_t));
+
+	qsort(renderer->sprites, opaque_count, sizeof(raycast_sprite_t), renderer->column_depth ? raycast_sprite_further : raycast_sprite_nearer);
+	qsort(renderer->sprites + opaque_count, translucent_count, sizeof(raycast_sprite_t), raycast_sprite_further);
+
+	renderer->sprite_count = opaque_count + translucent_count;
+	renderer->sprites_drawn = renderer->sprite_count;
+	renderer->sprites_culled = scene->object_count - renderer->sprite_count;
+	return 0;
+}
 
-		// clamp draw start / end values to fit into the screen
-		if (draw_start_y < 0) draw_start_y = 0;
-		if (draw_end_y >= h) draw_end_y = h;
+/*
+every band walks the frame's sprite list in the same order but only touches its own rows,
+so overlapping sprites blend in the same order no matter how many bands there are
+*/
+static void raycast_render_sprites_band(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_scratch_t* scratch, int band_start, int band_end) {
+	int w = renderer->screen_width;
+
+	for (uint32_t i = 0; i < renderer->sprite_count; i++) {
+		const raycast_sprite_t *sprite = renderer->sprites + i;
 
-		if (draw_start_x < 0) draw_start_x = 0;
-		if (draw_end_x > w) draw_end_x = w;
+		int draw_start_y = sprite->draw_start_y;
+		int draw_end_y = sprite->draw_end_y;
+
+		// clamp to the rows of this band
+		if (draw_end_y <= band_start || draw_start_y >= band_end) continue;
+		if (draw_start_y < band_start) draw_start_y = band_start;
+		if (draw_end_y > band_end) draw_end_y = band_end;
+
+		raycast_real_t step = sprite->step;
+		raycast_depth_t depth = sprite->depth;
+
+		if (sprite->texture != NULL) {
+			raycast_texture_sprite(renderer, scratch, scene->textures, sprite->texture, sprite->draw_start_x, sprite->draw_end_x, draw_start_y, draw_end_y, sprite->top, sprite->percent_x, sprite->step_x, step, depth);
+			continue;
+		}
 
-		raycast_screen_pixel_t pixel;
+		raycast_sprite_span_t span;
+		span.id = sprite->object->id;
+		span.depth = sprite->distance;
+		span.unit_x = scratch->unit_x;
+		span.pixels = scratch->pixels;
+		span.locations = scratch->locations;
 
 		for (int y = draw_start_y; y < draw_end_y; y++) {
-			for (int x = draw_start_x; x < draw_end_x; x++) {
+			span.count = 0;
+			span.unit_y = (y - sprite->top) * step;
+
+			raycast_real_t sprite_percent_x = sprite->percent_x;
+
+			for (int x = sprite->draw_start_x; x < sprite->draw_end_x; x++) {
 				int index = x + y * w;
 
-				if (renderer->depth_buffer[index] > transform_y) {
-					raycast_uint32_to_color(renderer->pixel_data[index], &(pixel.color));
+				if (renderer->column_depth ? !raycast_wall_hides(renderer, x, y, depth) : renderer->depth_buffer[index] > depth) {
+					uint32_t n = span.count++;
+
+					span.unit_x[n] = sprite_percent_x;
+					span.pixels[n] = renderer->pixel_data + index;
+					span.locations[n] = index;
+				}
+				sprite_percent_x += sprite->step_x;
+			}
 
-					pixel.location = index;
+			RAYCAST_PROFILE_ADD(scratch, sprites_shaded, span.count);
+			RAYCAST_PROFILE_ADD(scratch, sprites_rejected, sprite->draw_end_x - sprite->draw_start_x - span.count);
 
-					renderer->sprite_pixel(&pixel, object->id, sprite_percent_x, sprite_percent_y, transform_y);
+			if (span.count != 0) {
+				raycast_emit_sprite_span(renderer, &span);
 
-					renderer->pixel_data[index] = raycast_color_to_uint32(&(pixel.color));
-					// only account for the sprites depth if the pixel being drawn is fully opaque
-					if (pixel.color.a == 255) {
-						renderer->depth_buffer[index] = transform_y;
+				// only account for the sprites depth if the pixel being drawn is fully opaque, in column depth mode only walls keep depth
+				for (uint32_t n = 0; n < span.count && !renderer->column_depth; n++) {
+					if ((*span.pixels[n] & 0xFF) == 255) {
+						renderer->depth_buffer[span.locations[n]] = depth;
 					}
 				}
-				sprite_percent_x += step;
 			}
-			sprite_percent_x = sprite_percent_x_initial;
-			sprite_percent_y += step;
 		}
 	}
 }
 
+static void raycast_render_sprites_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int h = job->renderer->screen_height;
+
+	raycast_render_sprites_band(job->renderer, job->scene, job->renderer->scratch + band, raycast_band_start(h, band, band_count), raycast_band_start(h, band + 1, band_count));
+}
+
+void raycast_render_sprites(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
+	if (raycast_build_sprites(renderer, scene, camera) != 0) return;
+
+	raycast_render_job_t job = {renderer, scene, camera};
+	raycast_thread_pool_run(renderer->thread_pool, raycast_render_sprites_task, &job, raycast_band_count(renderer, renderer->screen_height));
+}
+
+static double raycast_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+#ifdef RAYCAST_PROFILE
+
+// starts the stats of a new frame, the counters of every band's scratch are zeroed too
+static void raycast_profile_start(raycast_renderer_t* renderer) {
+	memset(&renderer->stats, 0, sizeof(raycast_frame_stats_t));
+
+	for (uint32_t i = 0; i < renderer->thread_count; i++) {
+		memset(&renderer->scratch[i].stats, 0, sizeof(raycast_frame_stats_t));
+	}
+
+	renderer->stats.start_time = raycast_now();
+}
+
+// adds the time since the last mark (or the start of the frame) to one pass
+static void raycast_profile_mark(raycast_renderer_t* renderer, double* pass_time) {
+	double elapsed = raycast_now() - renderer->stats.start_time - renderer->stats.frame_time;
+
+	*pass_time += elapsed;
+	renderer->stats.frame_time += elapsed;
+}
+
+static void raycast_profile_finish(raycast_renderer_t* renderer) {
+	raycast_frame_stats_t *stats = &renderer->stats;
+
+	for (uint32_t i = 0; i < renderer->thread_count; i++) {
+		const raycast_frame_stats_t *band = &renderer->scratch[i].stats;
+
+		stats->dda_steps += band->dda_steps;
+		stats->walls_shaded += band->walls_shaded;
+		stats->top_bottom_shaded += band->top_bottom_shaded;
+		stats->sprites_shaded += band->sprites_shaded;
+		stats->top_bottom_rejected += band->top_bottom_rejected;
+		stats->sprites_rejected += band->sprites_rejected;
+	}
+
+	stats->sprites_drawn = renderer->sprites_drawn;
+	stats->sprites_culled = renderer->sprites_culled;
+}
+
+#define RAYCAST_PROFILE_START(renderer) raycast_profile_start(renderer)
+#define RAYCAST_PROFILE_MARK(renderer, pass) raycast_profile_mark(renderer, &(renderer)->stats.pass)
+#define RAYCAST_PROFILE_FINISH(renderer) raycast_profile_finish(renderer)
+#else
+#define RAYCAST_PROFILE_START(renderer) ((void)0)
+#define RAYCAST_PROFILE_MARK(renderer, pass) ((void)0)
+#define RAYCAST_PROFILE_FINISH(renderer) ((void)0)
+#endif
+
+static uint64_t raycast_hash(uint64_t hash, const void* data, size_t size) {
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+#define raycast_hash_value(hash, value) raycast_hash(hash, &(value), sizeof(value))
+
+/*
+hash of everything besides the camera and the map that a frame is drawn from, the renderer's settings,
+the scene's heights, its objects, the atlas' wall, floor and ceiling settings and the versions of the lightmap
+and visibility set, the texels of the atlas and the floor / ceiling maps aren't hashed, raycast_renderer_invalidate
+has to be called after changing them
+*/
+static uint64_t raycast_frame_hash(const raycast_renderer_t* renderer, const raycast_scene_t* scene) {
+	uint64_t hash = 1469598103934665603ULL;
+
+	hash = raycast_hash_value(hash, renderer->pixel_data);
+	hash = raycast_hash_value(hash, renderer->screen_width);
+	hash = raycast_hash_value(hash, renderer->screen_height);
+	hash = raycast_hash_value(hash, renderer->distance_field);
+	hash = raycast_hash_value(hash, renderer->column_depth);
+	hash = raycast_hash_value(hash, renderer->render_top_bottom);
+	hash = raycast_hash_value(hash, renderer->render_top);
+	hash = raycast_hash_value(hash, renderer->render_bottom);
+	hash = raycast_hash_value(hash, renderer->render_walls);
+	hash = raycast_hash_value(hash, renderer->render_sprites);
+	hash = raycast_hash_value(hash, renderer->scale_x);
+	hash = raycast_hash_value(hash, renderer->scale_y);
+	hash = raycast_hash_value(hash, renderer->linear_upscale);
+	hash = raycast_hash_value(hash, renderer->surface_pixel);
+	hash = raycast_hash_value(hash, renderer->sprite_pixel);
+	hash = raycast_hash_value(hash, renderer->surface_span);
+	hash = raycast_hash_value(hash, renderer->sprite_span);
+
+	hash = raycast_hash_value(hash, scene->wall_height);
+	hash = raycast_hash_value(hash, scene->top_height);
+	hash = raycast_hash_value(hash, scene->bottom_height);
+	hash = raycast_hash_value(hash, scene->objects);
+	hash = raycast_hash_value(hash, scene->object_count);
+	hash = raycast_hash_value(hash, scene->textures);
+	hash = raycast_hash_value(hash, scene->tiled_map);
+	hash = raycast_hash_value(hash, scene->cell_heights);
+	hash = raycast_hash_value(hash, scene->height_scale);
+	hash = raycast_hash_value(hash, scene->lightmap);
+	hash = raycast_hash_value(hash, scene->visibility);
+
+	// every bake bumps the version, so a rebaked lightmap redraws the frame
+	if (scene->lightmap != NULL) hash = raycast_hash_value(hash, scene->lightmap->version);
+	if (scene->visibility != NULL) hash = raycast_hash_value(hash, scene->visibility->version);
+
+	for (uint32_t i = 0; scene->objects != NULL && i < scene->object_count; i++) {
+		const raycast_object_t *object = scene->objects + i;
+
+		hash = raycast_hash_value(hash, object->id);
+		hash = raycast_hash_value(hash, object->position);
+		hash = raycast_hash_value(hash, object->height);
+		hash = raycast_hash_value(hash, object->size);
+		hash = raycast_hash_value(hash, object->texture);
+		hash = raycast_hash_value(hash, object->translucent);
+	}
+
+	const raycast_texture_atlas_t *atlas = scene->textures;
+
+	if (atlas != NULL) {
+		hash = raycast_hash_value(hash, atlas->texel_count);
+		hash = raycast_hash_value(hash, atlas->texture_count);
+		hash = raycast_hash_value(hash, atlas->wall_textures);
+		hash = raycast_hash_value(hash, atlas->floor_map);
+		hash = raycast_hash_value(hash, atlas->ceiling_map);
+		hash = raycast_hash_value(hash, atlas->floor_texture);
+		hash = raycast_hash_value(hash, atlas->ceiling_texture);
+	}
+
+	return hash;
+}
+
+// blends two colors channel by channel, weight goes from 0 (all of a) to 256 (all of b)
+static inline uint32_t raycast_blend_color(uint32_t a, uint32_t b, uint32_t weight) {
+	uint32_t red_blue = (((a & 0x00ff00ff) * (256 - weight) + (b & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+	uint32_t green_alpha = (((a >> 8) & 0x00ff00ff) * (256 - weight) + ((b >> 8) & 0x00ff00ff) * weight) & 0xff00ff00;
+	return red_blue | green_alpha;
+}
+
+/*
+position of the center of screen row y in the scaled frame, in 8 bit fixed point, split into the scaled row
+at or above it and the weight of the one below it, clamped to the edges of the scaled frame
+*/
+static inline void raycast_upscale_row(int y, int scale, int scaled_height, int* source, uint32_t* weight) {
+	int position = (2 * y + 1) * 128 / scale - 128;
+
+	if (position < 0) position = 0;
+	if (position > (scaled_height - 1) * 256) position = (scaled_height - 1) * 256;
+
+	*source = position >> 8;
+	*weight = position & 255;
+}
+
+/*
+scales a band of the screen's rows up from scaled_pixels to pixel_data, nearest repeats every scaled pixel scale_x
+times along a row and copies finished rows down to the rows that share their scaled row, linear blends the two
+scaled rows around a row into the scratch's locations first, padded with a copy of the first and last pixel so the
+edges need no clamping, then blends along the row between the two pixels around each pixel's center, a pixel's
+offset from its scaled pixel repeats every scale_x pixels so the row is filled one offset at a time
+*/
+static void raycast_upscale_band(raycast_renderer_t* renderer, raycast_scratch_t* scratch, int band_start, int band_end) {
+	int w = renderer->screen_width;
+	int scale_x = renderer->scale_x;
+	int scale_y = renderer->scale_y;
+	int scaled_w = (w + scale_x - 1) / scale_x;
+	int scaled_h = ((int)renderer->screen_height + scale_y - 1) / scale_y;
+
+	for (int y = band_start; y < band_end; y++) {
+		uint32_t *row = renderer->pixel_data + w * y;
+
+		if (!renderer->linear_upscale) {
+			if (y != band_start && y % scale_y != 0) {
+				memcpy(row, row - w, w * sizeof(uint32_t));
+				continue;
+			}
+
+			const uint32_t *source = renderer->scaled_pixels + scaled_w * (y / scale_y);
+			uint32_t *pixel = row;
+
+			if (scale_x == 1) {
+				memcpy(row, source, w * sizeof(uint32_t));
+				continue;
+			}
+
+			for (int x = 0; x < scaled_w; x++) {
+				uint32_t color = source[x];
+				int count = x == scaled_w - 1 ? w - x * scale_x : scale_x;
+
+				for (int i = 0; i < count; i++) *pixel++ = color;
+			}
+			continue;
+		}
+
+		int source_y;
+		uint32_t weight_y;
+		raycast_upscale_row(y, scale_y, scaled_h, &source_y, &weight_y);
+
+		const uint32_t *above = renderer->scaled_pixels + scaled_w * source_y;
+		const uint32_t *below = source_y + 1 < scaled_h ? above + scaled_w : above;
+
+		// without horizontal scaling the blended row is the screen row
+		uint32_t *blended = scale_x == 1 ? row : scratch->locations + 1;
+
+		for (int x = 0; x < scaled_w; x++) {
+			blended[x] = raycast_blend_color(above[x], below[x], weight_y);
+		}
+
+		if (scale_x == 1) continue;
+
+		blended[-1] = blended[0];
+		blended[scaled_w] = blended[scaled_w - 1];
+
+		for (int i = 0; i < scale_x; i++) {
+			// offset of pixels i, i + scale_x, ... from the center of their scaled pixel, in [-128, 128)
+			int offset = (2 * i + 1) * 128 / scale_x - 128;
+
+			// pixels left of the center blend with the scaled pixel before theirs
+			const uint32_t *pair = offset < 0 ? blended - 1 : blended;
+			uint32_t weight = offset & 255;
+
+			for (int x = i, k = 0; x < w; x += scale_x, k++) {
+				row[x] = raycast_blend_color(pair[k], pair[k + 1], weight);
+			}
+		}
+	}
+}
+
+static void raycast_upscale_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_render_job_t *job = (raycast_render_job_t *)data;
+	int h = job->renderer->screen_height;
+
+	raycast_upscale_band(job->renderer, job->renderer->scratch + band, raycast_band_start(h, band, band_count), raycast_band_start(h, band + 1, band_count));
+}
+
+/*
+moves the render scale towards the target frame time once RAYCAST_SCALE_FRAMES frames have been drawn at it,
+columns are coarsened first since they save whole wall rays, and rows are refined first, the scale is only
+refined when a quarter of the target is to spare so it doesn't flip back and forth around the target
+*/
+static void raycast_update_scale(raycast_renderer_t* renderer, double frame_time) {
+	renderer->scale_time += frame_time;
+	if (++renderer->scale_frames < RAYCAST_SCALE_FRAMES) return;
+
+	double average = renderer->scale_time / renderer->scale_frames;
+
+	renderer->scale_time = 0;
+	renderer->scale_frames = 0;
+
+	uint32_t scale_x = renderer->scale_x;
+	uint32_t scale_y = renderer->scale_y;
+
+	if (average > renderer->target_frame_time) {
+		if (scale_x <= scale_y && scale_x < renderer->max_scale) {
+			scale_x++;
+		} else if (scale_y < renderer->max_scale) {
+			scale_y++;
+		}
+	} else if (average < renderer->target_frame_time * 0.75) {
+		if (scale_y >= scale_x && scale_y > 1) {
+			scale_y--;
+		} else if (scale_x > 1) {
+			scale_x--;
+		}
+	}
+
+	// on failure to allocate the scaled frame the scale just stays where it is
+	raycast_renderer_set_render_scale(renderer, scale_x, scale_y);
+}
+
 void raycast_render(raycast_renderer_t* renderer, raycast_scene_t* scene, raycast_camera_t* camera) {
-	if (renderer->pixel_data == NULL) return;
+	if (renderer->pixel_data == NULL || renderer->scratch == NULL) return;
+
+	double start_time = renderer->target_frame_time > 0 ? raycast_now() : 0;
+
+	RAYCAST_PROFILE_START(renderer);
+
+	raycast_frame_cache_t *cache = renderer->frame_cache;
+	uint64_t frame_hash = 0;
+
+	// the last frame is still in pixel_data, if nothing it was drawn from changed it is the frame
+	if (cache != NULL) {
+		frame_hash = raycast_frame_hash(renderer, scene);
+
+		if (cache->frame_valid && cache->frame_scene == scene && cache->frame_hash == frame_hash &&
+			raycast_same_view(&cache->frame_camera, camera)) {
+			RAYCAST_PROFILE_FINISH(renderer);
+			return;
+		}
+	}
+
+	/*
+	a scaled frame is drawn by pointing the renderer at scaled_pixels with the scaled size for the passes,
+	pitch is in rows so it is scaled too, everything else the passes use is in world units
+	*/
+	uint32_t screen_width = renderer->screen_width;
+	uint32_t screen_height = renderer->screen_height;
+	uint32_t *pixel_data = renderer->pixel_data;
+
+	raycast_camera_t scaled_camera;
+	int scaled = renderer->scaled_pixels != NULL;
+
+	if (scaled) {
+		renderer->screen_width = (screen_width + renderer->scale_x - 1) / renderer->scale_x;
+		renderer->screen_height = (screen_height + renderer->scale_y - 1) / renderer->scale_y;
+		renderer->pixel_data = renderer->scaled_pixels;
+
+		scaled_camera = *camera;
+		scaled_camera.pitch = camera->pitch / (int)renderer->scale_y;
+	}
+
+	raycast_camera_t *view = scaled ? &scaled_camera : camera;
 
 	// clear the screen before next frame
 	memset(renderer->pixel_data, 0, renderer->screen_width * renderer->screen_height * 4);
+	RAYCAST_PROFILE_MARK(renderer, clear_time);
+
+	int render_surfaces = renderer->surface_pixel != NULL || renderer->surface_span != NULL || scene->textures != NULL;
+	int has_map = scene->world_map != NULL || scene->tiled_map != NULL;
+	int render_walls = render_surfaces && has_map && (renderer->render_walls || raycast_scene_heights(scene));
+
+	/*
+	the floor and ceiling pass writes the whole depth buffer from the wall arrays, so it runs even when it draws
+	nothing, only the columns of a scene with cell heights write their own depth and need it reset without walls
+	*/
+	if (render_walls) {
+		raycast_render_walls(renderer, scene, view);
+		RAYCAST_PROFILE_MARK(renderer, wall_time);
+	} else {
+		raycast_clear_walls(renderer);
 
-	// reset the depth buffer
-	for (int x = 0; x < renderer->screen_width; ++x) {
-		for (int y = 0; y < renderer->screen_height; ++y) {
-			renderer->depth_buffer[x * renderer->screen_height + y] = INFINITY;
+		raycast_depth_t *depth = raycast_scene_heights(scene) ? renderer->depth_buffer : NULL;
+		for (uint32_t i = 0; depth && i < renderer->screen_width * renderer->screen_height; i++) {
+			depth[i] = RAYCAST_DEPTH_CLEAR;
 		}
+		RAYCAST_PROFILE_MARK(renderer, clear_time);
 	}
 
 	// render surfaces
-	if (renderer->surface_pixel != NULL) {
+	raycast_render_top_bottom(renderer, scene, view);
+	RAYCAST_PROFILE_MARK(renderer, top_bottom_time);
 
-		if (scene->world_map != NULL && renderer->render_walls) raycast_render_walls(renderer, scene, camera);
+	// render objects
+	if (scene->objects != NULL && (renderer->sprite_pixel != NULL || renderer->sprite_span != NULL || scene->textures != NULL) && renderer->render_sprites) {
+		raycast_render_sprites(renderer, scene, view);
+	}
+	RAYCAST_PROFILE_MARK(renderer, sprite_time);
 
-		if (renderer->render_top_bottom) raycast_render_top_bottom(renderer, scene, camera);
+	if (scaled) {
+		renderer->screen_width = screen_width;
+		renderer->screen_height = screen_height;
+		renderer->pixel_data = pixel_data;
+
+		raycast_render_job_t job = {renderer, scene, camera};
+		raycast_thread_pool_run(renderer->thread_pool, raycast_upscale_task, &job, raycast_band_count(renderer, screen_height));
+		RAYCAST_PROFILE_MARK(renderer, upscale_time);
 	}
 
-	// render objects
-	if (scene->objects != NULL && renderer->sprite_pixel != NULL && renderer->render_sprites) {
-		raycast_render_sprites(renderer, scene, camera);
+	if (cache != NULL) {
+		cache->frame_valid = 1;
+		cache->frame_camera = *camera;
+		cache->frame_scene = scene;
+		cache->frame_hash = frame_hash;
+	}
+
+	// frames the cache skipped aren't timed, they say nothing about the scale
+	if (renderer->target_frame_time > 0) raycast_update_scale(renderer, raycast_now() - start_time);
+
+	RAYCAST_PROFILE_FINISH(renderer);
+}
+
+// batch functions
+
+int raycast_batch_init(raycast_batch_t* batch, uint32_t max_width, uint32_t max_height, surface_pixel_t surface_pixel, sprite_pixel_t sprite_pixel, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	size_t frame_size = (size_t)max_width * max_height;
+
+	batch->max_width = max_width;
+	batch->max_height = max_height;
+	batch->thread_count = 0;
+	batch->object_views = NULL;
+	batch->object_capacity = 0;
+	batch->renderers = (raycast_renderer_t *) malloc(thread_count * sizeof(raycast_renderer_t));
+	batch->pixels = (uint32_t *) malloc(thread_count * frame_size * sizeof(uint32_t));
+	batch->thread_pool = raycast_thread_pool_create(thread_count);
+
+	if (batch->renderers == NULL || batch->pixels == NULL || batch->thread_pool == NULL) {
+		raycast_batch_free(batch);
+		return -1;
+	}
+
+	// the batch splits views between threads, so each renderer draws on the thread it is given
+	for (uint32_t i = 0; i < thread_count; i++) {
+		raycast_renderer_t *renderer = batch->renderers + i;
+
+		if (raycast_renderer_init(renderer, batch->pixels + i * frame_size, max_width, max_height, surface_pixel, sprite_pixel) != 0) {
+			raycast_batch_free(batch);
+			return -1;
+		}
+		batch->thread_count++;
+
+		if (raycast_renderer_set_thread_count(renderer, 1) != 0) {
+			raycast_batch_free(batch);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void raycast_batch_free(raycast_batch_t* batch) {
+	raycast_thread_pool_free(batch->thread_pool);
+	batch->thread_pool = NULL;
+
+	for (uint32_t i = 0; batch->renderers != NULL && i < batch->thread_count; i++) {
+		raycast_renderer_free(batch->renderers + i);
+	}
+
+	free(batch->renderers);
+	free(batch->pixels);
+	free(batch->object_views);
+	batch->renderers = NULL;
+	batch->pixels = NULL;
+	batch->object_views = NULL;
+	batch->object_capacity = 0;
+	batch->thread_count = 0;
+}
+
+void raycast_batch_set_distance_field(raycast_batch_t* batch, const raycast_distance_field_t* field) {
+	for (uint32_t i = 0; i < batch->thread_count; i++) {
+		raycast_renderer_set_distance_field(batch->renderers + i, field);
+	}
+}
+
+/*
+arguments shared by every view of a batch, each band is one view, sets are the distinct sets the cameras of
+the first 64 views stand in and set_views the views in each, open_views see everything and culled_views are
+the views object_views is filled in for, 0 if the scene has no visibility set
+*/
+typedef struct {
+	raycast_batch_t *batch;
+	raycast_scene_t *scene;
+	raycast_view_t *views;
+	const raycast_visibility_t *visibility;
+	const uint32_t *sets[64];
+	uint64_t set_views[64];
+	uint32_t set_count;
+	uint64_t open_views, culled_views;
+} raycast_batch_job_t;
+
+// tests a band of the scene's objects against the sets of every view at once, views in the same cell share one test
+static void raycast_batch_cull_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_batch_job_t *job = (raycast_batch_job_t *)data;
+	raycast_scene_t *scene = job->scene;
+
+	uint32_t start = (uint32_t)((uint64_t)scene->object_count * band / band_count);
+	uint32_t end = (uint32_t)((uint64_t)scene->object_count * (band + 1) / band_count);
+
+	for (uint32_t i = start; i < end; i++) {
+		uint64_t views = job->open_views;
+
+		for (uint32_t s = 0; s < job->set_count; s++) {
+			if (raycast_visibility_sees_object(job->visibility, job->sets[s], scene->objects + i)) views |= job->set_views[s];
+		}
+
+		job->batch->object_views[i] = views;
+	}
+}
+
+/*
+the pool runs band i on thread i % thread_count, so the renderer of that thread is never used by two
+views at once, the renderer is pointed at the view's size and framebuffer, then set back to its own pixels
+*/
+static void raycast_batch_task(void* data, uint32_t band, uint32_t band_count) {
+	raycast_batch_job_t *job = (raycast_batch_job_t *)data;
+	raycast_batch_t *batch = job->batch;
+	raycast_view_t *view = job->views + band;
+	raycast_renderer_t *renderer = batch->renderers + band % batch->thread_count;
+
+	uint32_t *own_pixels = renderer->pixel_data;
+	int in_place = view->x == 0 && view->stride == view->width;
+
+	renderer->screen_width = view->width;
+	renderer->screen_height = view->height;
+	renderer->aspect_ratio = (raycast_real_t) view->width / view->height;
+	if (in_place) renderer->pixel_data = view->pixel_data + (size_t)view->y * view->stride;
+
+	if (band < 64 && job->culled_views != 0) {
+		renderer->object_views = batch->object_views;
+		renderer->object_view_bit = (uint64_t)1 << band;
+	}
+
+	raycast_render(renderer, job->scene, view->camera);
+
+	if (!in_place) {
+		uint32_t *target = view->pixel_data + (size_t)view->y * view->stride + view->x;
+
+		for (uint32_t y = 0; y < view->height; y++) {
+			memcpy(target + (size_t)y * view->stride, own_pixels + (size_t)y * view->width, view->width * sizeof(uint32_t));
+		}
+	}
+
+	renderer->pixel_data = own_pixels;
+	renderer->object_views = NULL;
+	renderer->object_view_bit = 0;
+	renderer->screen_width = batch->max_width;
+	renderer->screen_height = batch->max_height;
+	renderer->aspect_ratio = (raycast_real_t) batch->max_width / batch->max_height;
+}
+
+int raycast_batch_render(raycast_batch_t* batch, raycast_scene_t* scene, raycast_view_t* views, uint32_t view_count) {
+	for (uint32_t i = 0; i < view_count; i++) {
+		raycast_view_t *view = views + i;
+
+		if (view->camera == NULL || view->pixel_data == NULL || view->width == 0 || view->height == 0 ||
+			view->width > batch->max_width || view->height > batch->max_height || view->x + view->width > view->stride) return -1;
+	}
+
+	if (batch->thread_count == 0) return -1;
+
+	raycast_batch_job_t job;
+	job.batch = batch;
+	job.scene = scene;
+	job.views = views;
+	job.visibility = raycast_scene_visibility(scene);
+	job.set_count = 0;
+	job.open_views = 0;
+	job.culled_views = 0;
+
+	if (job.visibility != NULL && scene->object_count > 0) {
+		if (scene->object_count > batch->object_capacity) {
+			uint64_t *object_views = (uint64_t *) realloc(batch->object_views, scene->object_count * sizeof(uint64_t));
+			if (object_views == NULL) return -1;
+
+			batch->object_views = object_views;
+			batch->object_capacity = scene->object_count;
+		}
+
+		for (uint32_t i = 0; i < view_count && i < 64; i++) {
+			const uint32_t *set = raycast_visibility_camera_set(job.visibility, views[i].camera);
+			uint64_t bit = (uint64_t)1 << i;
+			job.culled_views |= bit;
+
+			if (set == NULL) {
+				job.open_views |= bit;
+				continue;
+			}
+
+			uint32_t s = 0;
+			while (s < job.set_count && job.sets[s] != set) s++;
+
+			if (s == job.set_count) {
+				job.sets[job.set_count] = set;
+				job.set_views[job.set_count++] = 0;
+			}
+			job.set_views[s] |= bit;
+		}
+
+		raycast_thread_pool_run(batch->thread_pool, raycast_batch_cull_task, &job, batch->thread_count);
 	}
-}
\ No newline at end of file
+
+	raycast_thread_pool_run(batch->thread_pool, raycast_batch_task, &job, view_count);
+	return 0;
+}
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../include/voxelspace.h"
+
+/*
+headless flyover benchmark, every terrain is generated from a fixed seed and flown over on a scripted camera
+path so runs are comparable between builds, results are printed one json object per scene, and a checksum of
+every frame is compared against a golden file to catch changes in output
+
+usage: bench [-w width] [-h height] [-f frames] [-t threads] [-l levels] [-S scene_prefix] [-g golden_file] [-G golden_file_to_write]
+
+-t and the scalar build (make bench builds build/bench_nosimd with VOXELSPACE_NO_SIMD) only change how a frame is
+drawn, not what, so they check against the same golden checksums, with -t above 1 every frame is also drawn on a
+single threaded renderer and any difference fails the run, -l n builds n map levels (counting the maps themselves)
+so distant slices read smaller maps, which changes what is drawn and gives the golden key a _levelsn suffix
+*/
+
+typedef struct {
+	const char *name;
+	uint32_t size;
+	uint32_t octaves;
+} bench_scene_t;
+
+static const bench_scene_t bench_scenes[] = {
+	{"hills_512", 512, 5},
+	{"hills_2048", 2048, 7},
+};
+
+typedef struct {
+	uint32_t width, height, frames, threads, levels;
+	const char *scenes, *golden, *write_golden;
+} bench_options_t;
+
+// small fixed generator so terrains don't depend on the libc's rand
+static uint32_t bench_seed;
+
+static uint32_t bench_random(void) {
+	bench_seed = bench_seed * 1664525u + 1013904223u;
+	return bench_seed >> 8;
+}
+
+static double bench_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_hash(uint64_t hash, const uint32_t *data, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+heights are octaves of value noise on lattices that divide the map, so the terrain wraps like the map does,
+each octave has twice the cells and half the weight of the one before it, colors go from grass to rock to snow
+*/
+static void bench_build_terrain(const bench_scene_t *scene, uint8_t *height_map, uint32_t *color_map) {
+	uint32_t size = scene->size;
+	double *heights = (double *) calloc((size_t)size * size, sizeof(double));
+	double weight = 1, total = 0;
+
+	for (uint32_t octave = 0; octave < scene->octaves; octave++) {
+		uint32_t cells = 4u << octave;
+		uint32_t cell_size = size / cells;
+		uint8_t *lattice = (uint8_t *) malloc(cells * cells);
+
+		for (uint32_t i = 0; i < cells * cells; i++) {
+			lattice[i] = (uint8_t)bench_random();
+		}
+
+		for (uint32_t y = 0; y < size; y++) {
+			uint32_t y0 = y / cell_size, y1 = (y0 + 1) % cells;
+			double fy = (y % cell_size) / (double)cell_size;
+			fy = fy * fy * (3 - 2 * fy);
+
+			for (uint32_t x = 0; x < size; x++) {
+				uint32_t x0 = x / cell_size, x1 = (x0 + 1) % cells;
+				double fx = (x % cell_size) / (double)cell_size;
+				fx = fx * fx * (3 - 2 * fx);
+
+				double top = lattice[x0 + cells * y0] + (lattice[x1 + cells * y0] - lattice[x0 + cells * y0]) * fx;
+				double bottom = lattice[x0 + cells * y1] + (lattice[x1 + cells * y1] - lattice[x0 + cells * y1]) * fx;
+				heights[x + (size_t)size * y] += (top + (bottom - top) * fy) * weight;
+			}
+		}
+
+		free(lattice);
+		total += weight;
+		weight /= 2;
+	}
+
+	for (size_t i = 0; i < (size_t)size * size; i++) {
+		uint32_t height = (uint32_t)(heights[i] / total);
+		uint32_t shade = bench_random() % 24;
+
+		height_map[i] = (uint8_t)height;
+
+		if (height < 110) color_map[i] = ((40 + shade) << 24) | ((120 + shade + height / 2) << 16) | ((30 + shade) << 8) | 255;
+		else if (height < 170) color_map[i] = ((100 + shade + height / 4) << 24) | ((90 + shade + height / 4) << 16) | ((80 + shade) << 8) | 255;
+		else color_map[i] = ((200 + shade) << 24) | ((200 + shade) << 16) | ((210 + shade) << 8) | 255;
+	}
+
+	free(heights);
+}
+
+// camera path, a loop over the map that keeps a height above the terrain below it, banks its turns and looks up and down
+static void bench_path(voxelspace_scene_t *world, const bench_scene_t *scene, uint32_t frame, uint32_t frames, voxelspace_camera_t *camera) {
+	double t = frame / (double)frames * 2 * M_PI;
+	double radius = scene->size * 0.35;
+
+	camera->position.x = scene->size / 2.0 + cos(t) * radius;
+	camera->position.y = scene->size / 2.0 + sin(2 * t) * radius * 0.6;
+	camera->height = voxelspace_terrain_height(world, camera->position.x, camera->position.y) + 40 + 30 * sin(3 * t);
+	camera->pitch = (int)(40 * sin(t * 5));
+
+	voxelspace_camera_set_rotation(camera, t + M_PI / 2 + 0.6 * sin(t * 4));
+}
+
+static int bench_compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// looks up the golden checksum of a scene, returns 0 if the file has no entry for it
+static int bench_find_golden(const char *path, const char *key, uint64_t *checksum) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) return 0;
+
+	char name[128];
+	unsigned long long value;
+	int found = 0;
+
+	while (fscanf(file, "%127s %llx", name, &value) == 2) {
+		if (strcmp(name, key) == 0) {
+			*checksum = value;
+			found = 1;
+		}
+	}
+
+	fclose(file);
+	return found;
+}
+
+// runs one scene and prints its json line, returns 1 if its checksum doesn't match the golden file or its frames differ between thread counts
+static int bench_run(const bench_scene_t *scene, const bench_options_t *options, FILE *golden_out) {
+	uint32_t size = scene->size;
+	size_t pixel_count = (size_t)options->width * options->height;
+
+	bench_seed = 4242 + size * 3 + scene->octaves;
+
+	uint8_t *height_map = (uint8_t *) malloc((size_t)size * size);
+	uint32_t *color_map = (uint32_t *) malloc((size_t)size * size * sizeof(uint32_t));
+	uint32_t *pixels = (uint32_t *) malloc(pixel_count * sizeof(uint32_t));
+	uint32_t *single_pixels = options->threads > 1 ? (uint32_t *) malloc(pixel_count * sizeof(uint32_t)) : NULL;
+	double *frame_times = (double *) malloc(options->frames * sizeof(double));
+
+	bench_build_terrain(scene, height_map, color_map);
+
+	voxelspace_scene_t world;
+	voxelspace_scene_init(&world, height_map, color_map, size, size);
+	world.height_scale = 1;
+
+	double start = bench_now();
+	if (options->levels > 1 && voxelspace_scene_build_levels(&world, options->levels) != 0) {
+		fprintf(stderr, "bench: failed to build the map levels of %s\n", scene->name);
+		exit(1);
+	}
+	double levels_time = bench_now() - start;
+
+	voxelspace_renderer_t renderer, single;
+	int init_failed = voxelspace_renderer_init(&renderer, pixels, options->width, options->height) != 0 ||
+		voxelspace_renderer_set_thread_count(&renderer, options->threads) != 0;
+
+	if (!init_failed && single_pixels != NULL) init_failed = voxelspace_renderer_init(&single, single_pixels, options->width, options->height) != 0;
+
+	if (init_failed) {
+		fprintf(stderr, "bench: failed to create a %ux%u renderer with %u threads\n", options->width, options->height, options->threads);
+		exit(1);
+	}
+
+	voxelspace_camera_t camera;
+	voxelspace_camera_init(&camera, &renderer, 0, 0);
+
+	uint64_t checksum = 1469598103934665603ULL;
+	double render_time = 0;
+	uint32_t thread_mismatches = 0;
+
+	for (uint32_t frame = 0; frame < options->frames; frame++) {
+		bench_path(&world, scene, frame, options->frames, &camera);
+
+		start = bench_now();
+		voxelspace_render(&renderer, &world, &camera);
+		frame_times[frame] = bench_now() - start;
+
+		render_time += frame_times[frame];
+		checksum = bench_hash(checksum, pixels, pixel_count);
+
+		if (single_pixels != NULL) {
+			voxelspace_render(&single, &world, &camera);
+			thread_mismatches += memcmp(pixels, single_pixels, pixel_count * sizeof(uint32_t)) != 0;
+		}
+	}
+
+	qsort(frame_times, options->frames, sizeof(double), bench_compare_doubles);
+
+	char key[128];
+	int length = snprintf(key, sizeof(key), "%s_%ux%u_%u", scene->name, options->width, options->height, options->frames);
+	if (world.level_count > 1) snprintf(key + length, sizeof(key) - length, "_levels%u", world.level_count);
+
+	uint64_t golden;
+	const char *golden_state = "none";
+	int failed = thread_mismatches != 0;
+
+	if (options->golden != NULL && bench_find_golden(options->golden, key, &golden)) {
+		golden_state = golden != checksum ? "mismatch" : "ok";
+		failed |= golden != checksum;
+	}
+
+	if (golden_out != NULL) fprintf(golden_out, "%s %016llx\n", key, (unsigned long long)checksum);
+
+#ifdef VOXELSPACE_NO_SIMD
+	const char *simd = "none";
+#else
+	const char *simd = "default";
+#endif
+
+	printf("{\"scene\": \"%s\", \"key\": \"%s\", \"map_size\": %u, \"width\": %u, \"height\": %u, \"threads\": %u, \"levels\": %u, \"simd\": \"%s\", \"levels_build_ms\": %.1f, \"frames\": %u, ",
+		scene->name, key, size, options->width, options->height, options->threads, world.level_count, simd, levels_time * 1e3, options->frames);
+	printf("\"ms_p50\": %.3f, \"ms_p90\": %.3f, \"ms_p99\": %.3f, \"ms_max\": %.3f, \"mpixels_per_s\": %.2f, \"thread_mismatches\": %u, ",
+		frame_times[options->frames / 2] * 1e3, frame_times[options->frames * 9 / 10] * 1e3, frame_times[options->frames * 99 / 100] * 1e3,
+		frame_times[options->frames - 1] * 1e3, (double)pixel_count * options->frames / render_time / 1e6, thread_mismatches);
+	printf("\"checksum\": \"%016llx\", \"golden\": \"%s\"}\n", (unsigned long long)checksum, golden_state);
+	fflush(stdout);
+
+	if (single_pixels != NULL) voxelspace_renderer_free(&single);
+	voxelspace_renderer_free(&renderer);
+	voxelspace_scene_free_levels(&world);
+	free(frame_times);
+	free(single_pixels);
+	free(pixels);
+	free(color_map);
+	free(height_map);
+
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	bench_options_t options = {640, 360, 120, 1, 1, "", NULL, NULL};
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "-w") == 0) options.width = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-h") == 0) options.height = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-f") == 0) options.frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-t") == 0) options.threads = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-l") == 0) options.levels = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-S") == 0) options.scenes = argv[i + 1];
+		else if (strcmp(argv[i], "-g") == 0) options.golden = argv[i + 1];
+		else if (strcmp(argv[i], "-G") == 0) options.write_golden = argv[i + 1];
+		else {
+			fprintf(stderr, "usage: bench [-w width] [-h height] [-f frames] [-t threads] [-l levels] [-S scene_prefix] [-g golden_file] [-G golden_file_to_write]\n");
+			return 2;
+		}
+	}
+
+	if (options.frames == 0 || options.width == 0 || options.height == 0 || options.threads == 0 || options.levels == 0) {
+		fprintf(stderr, "bench: sizes and counts must be positive\n");
+		return 2;
+	}
+
+	FILE *golden_out = NULL;
+	if (options.write_golden != NULL) {
+		golden_out = fopen(options.write_golden, "w");
+		if (golden_out == NULL) {
+			fprintf(stderr, "bench: can't write %s\n", options.write_golden);
+			return 2;
+		}
+	}
+
+	int failed = 0;
+	for (uint32_t i = 0; i < sizeof(bench_scenes) / sizeof(bench_scenes[0]); i++) {
+		if (strncmp(bench_scenes[i].name, options.scenes, strlen(options.scenes)) != 0) continue;
+		failed += bench_run(bench_scenes + i, &options, golden_out);
+	}
+
+	if (golden_out != NULL) fclose(golden_out);
+
+	if (failed) fprintf(stderr, "bench: %d scene(s) don't match the golden checksums or failed their checks\n", failed);
+	return failed != 0;
+}
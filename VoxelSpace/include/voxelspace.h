@@ -0,0 +1,135 @@
+#ifndef VOXELSPACE_H
+#define VOXELSPACE_H
+
+#include <stdint.h>
+
+// simple 32bit color struct
+typedef struct {
+	uint8_t r, g, b, a;
+} voxelspace_color_t;
+
+// simple 2d point struct
+typedef struct {
+	double x, y;
+} voxelspace_point_t;
+
+// vector is the same as point, only used to distinguish the intent of a variable
+typedef voxelspace_point_t voxelspace_vector_t;
+
+// most levels a scene's maps can have, level 0 being the maps themselves
+#ifndef VOXELSPACE_MAX_LEVELS
+#define VOXELSPACE_MAX_LEVELS 16
+#endif
+
+/*
+persistent pool of worker threads owned by a renderer, the calling thread
+always takes part in the work so a pool of n threads only spawns n - 1 workers
+*/
+typedef struct voxelspace_thread_pool voxelspace_thread_pool_t;
+
+// distance, scale and map level of every slice of a frame, rebuilt by each voxelspace_render
+typedef struct voxelspace_slice_table voxelspace_slice_table_t;
+
+// one level of a scene's maps, each level is half the width and height of the one before it
+typedef struct {
+	uint8_t *height_map;
+	uint32_t *color_map;
+	uint32_t map_width, map_height;
+} voxelspace_map_level_t;
+
+/*
+the renderer is responsible for storing information about the screen and certain render settings
+
+the terrain is drawn front to back in slices across the view, the distance between slices starts at 1 and
+grows by lod every slice so far terrain takes fewer, coarser slices (lod can't be negative, nothing is drawn
+then), each column walks through every slice on its own, keeping the highest row it has drawn so anything a
+nearer slice covers is never drawn, and it stops at distance or as soon as it is filled to the top of the
+screen, y_buffer holds the row each column stopped at and whatever is above it is sky
+
+columns don't depend on each other, so with thread_count greater than 1 the screen is split into column bands,
+slices are walked four at a time with SSE2 on x86, slices far enough away that neighbouring columns or slices
+are more than a cell apart read the scene's smaller map levels, which keeps the samples of distant terrain in cache
+*/
+typedef struct {
+	uint32_t *pixel_data;
+	int *y_buffer;
+	uint32_t screen_width, screen_height;
+	double aspect_ratio;
+	double distance, lod;
+	uint32_t sky_color;
+	voxelspace_slice_table_t *slice_table;
+	uint32_t thread_count;
+	voxelspace_thread_pool_t *thread_pool;
+} voxelspace_renderer_t;
+
+/*
+the scene is responsible for storing the terrain, one height (0 - 255) and one color for every cell
+of the map, the map repeats in both directions so its width and height must be powers of two,
+height_scale is the height in world units of one step of the height map
+
+levels holds the smaller versions of the maps made by voxelspace_scene_build_levels, level_count
+counts the maps themselves too, so a scene without levels has a level_count of 1
+*/
+typedef struct {
+	uint8_t *height_map;
+	uint32_t *color_map;
+	uint32_t map_width, map_height;
+	double height_scale;
+	voxelspace_map_level_t levels[VOXELSPACE_MAX_LEVELS];
+	uint32_t level_count;
+} voxelspace_scene_t;
+
+/*
+the camera is responsible for storing information about where
+the world will be rendered, and what fov it will be rendered at,
+height is the height of the camera above 0, not above the terrain
+*/
+typedef struct {
+	voxelspace_point_t position;
+	voxelspace_vector_t direction;
+	voxelspace_vector_t plane;
+	double height, focal_length, plane_length;
+	int pitch;
+} voxelspace_camera_t;
+
+// utility functions
+void voxelspace_uint32_to_color(uint32_t, voxelspace_color_t*);
+uint32_t voxelspace_color_to_uint32(voxelspace_color_t*);
+
+// height of the terrain in world units at a point of the map, for keeping the camera above it
+double voxelspace_terrain_height(voxelspace_scene_t*, double x, double y);
+
+// init functions
+void voxelspace_scene_init(voxelspace_scene_t*, uint8_t *height_map, uint32_t *color_map, uint32_t map_width, uint32_t map_height);
+void voxelspace_camera_init(voxelspace_camera_t*, voxelspace_renderer_t*, double x, double y);
+
+// returns -1 on failure to initialize or 0 on success
+int voxelspace_renderer_init(voxelspace_renderer_t*, uint32_t *pixel_data, uint32_t width, uint32_t height);
+
+/*
+fills levels with up to level_count - 1 halved copies of the maps, each cell averaging four of the level
+before it, call it again after changing the maps, returns -1 on failure to allocate or 0 on success
+*/
+int voxelspace_scene_build_levels(voxelspace_scene_t*, uint32_t level_count);
+
+/*
+replaces the renderers worker pool with one of thread_count threads (0 is treated as 1),
+returns -1 on failure to create the threads or 0 on success, on failure the renderer falls back to 1 thread
+*/
+int voxelspace_renderer_set_thread_count(voxelspace_renderer_t*, uint32_t thread_count);
+
+// de-init functions
+void voxelspace_renderer_free(voxelspace_renderer_t*);
+
+// frees the levels made by voxelspace_scene_build_levels, the maps themselves belong to the user
+void voxelspace_scene_free_levels(voxelspace_scene_t*);
+
+// camera movement functions
+void voxelspace_camera_set_dir(voxelspace_camera_t*, double x, double y);
+void voxelspace_camera_rotate(voxelspace_camera_t*, double angle);
+void voxelspace_camera_set_rotation(voxelspace_camera_t*, double angle);
+
+// render functions
+void voxelspace_render(voxelspace_renderer_t*, voxelspace_scene_t*, voxelspace_camera_t*);
+
+#endif
@@ -0,0 +1,668 @@
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "voxelspace.h"
+
+// x86 builds walk slices with SSE2, which every x86-64 cpu has, define VOXELSPACE_NO_SIMD to only build the scalar walk
+#if !defined(VOXELSPACE_NO_SIMD) && defined(__SSE2__)
+#define VOXELSPACE_SSE2
+#include <emmintrin.h>
+#endif
+
+// columns a slice is drawn across at once
+#define VOXELSPACE_COLUMN_BLOCK 4
+
+/*
+a task is run once for every band in [0, band_count), bands are handed out
+statically so band i always runs on thread i % thread_count
+*/
+typedef void (*voxelspace_task_t)(void *data, uint32_t band, uint32_t band_count);
+
+struct voxelspace_thread_pool {
+	pthread_t *workers;
+	uint32_t thread_count;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_ready, work_done;
+
+	voxelspace_task_t task;
+	void *data;
+	uint32_t band_count;
+
+	// bumped every time new work is posted, workers compare against the last generation they ran
+	uint32_t generation;
+	uint32_t busy_workers;
+	char quit;
+};
+
+typedef struct {
+	voxelspace_thread_pool_t *pool;
+	uint32_t index;
+} voxelspace_worker_arg_t;
+
+/*
+every slice of a frame, base is the screen row of height 0 at the slice's distance, height_step
+the rows one step of the height map rises there and level the map level the slice reads
+*/
+struct voxelspace_slice_table {
+	float *z, *base, *height_step;
+	uint8_t *levels;
+	uint32_t slice_count, capacity;
+};
+
+// thread pool functions
+
+static void voxelspace_thread_pool_run_bands(voxelspace_thread_pool_t* pool, uint32_t index) {
+	for (uint32_t band = index; band < pool->band_count; band += pool->thread_count) {
+		pool->task(pool->data, band, pool->band_count);
+	}
+}
+
+static void* voxelspace_worker_main(void* arg) {
+	voxelspace_worker_arg_t worker = *(voxelspace_worker_arg_t *)arg;
+	voxelspace_thread_pool_t *pool = worker.pool;
+	free(arg);
+
+	uint32_t seen_generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		while (!pool->quit && pool->generation == seen_generation) {
+			pthread_cond_wait(&pool->work_ready, &pool->mutex);
+		}
+		if (pool->quit) break;
+
+		seen_generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		voxelspace_thread_pool_run_bands(pool, worker.index);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy_workers == 0) {
+			pthread_cond_signal(&pool->work_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void voxelspace_thread_pool_free(voxelspace_thread_pool_t* pool) {
+	if (pool == NULL) return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->mutex);
+
+	// worker 0 is the calling thread, it is never spawned
+	for (uint32_t i = 1; i < pool->thread_count; i++) {
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->work_ready);
+	pthread_cond_destroy(&pool->work_done);
+	free(pool->workers);
+	free(pool);
+}
+
+// returns NULL on failure
+static voxelspace_thread_pool_t* voxelspace_thread_pool_create(uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	voxelspace_thread_pool_t *pool = (voxelspace_thread_pool_t *) calloc(1, sizeof(voxelspace_thread_pool_t));
+	if (pool == NULL) return NULL;
+
+	pool->workers = (pthread_t *) malloc(thread_count * sizeof(pthread_t));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+
+	// count up as threads start so a failure part way through only joins the threads that exist
+	pool->thread_count = 1;
+
+	for (uint32_t i = 1; i < thread_count; i++) {
+		voxelspace_worker_arg_t *arg = (voxelspace_worker_arg_t *) malloc(sizeof(voxelspace_worker_arg_t));
+		if (arg == NULL) {
+			voxelspace_thread_pool_free(pool);
+			return NULL;
+		}
+		arg->pool = pool;
+		arg->index = i;
+
+		if (pthread_create(pool->workers + i, NULL, voxelspace_worker_main, arg) != 0) {
+			free(arg);
+			voxelspace_thread_pool_free(pool);
+			return NULL;
+		}
+		pool->thread_count++;
+	}
+
+	return pool;
+}
+
+// runs task over every band, splitting the bands between the pool's threads, returns once all bands are done
+static void voxelspace_thread_pool_run(voxelspace_thread_pool_t* pool, voxelspace_task_t task, void* data, uint32_t band_count) {
+	if (pool == NULL || pool->thread_count == 1 || band_count <= 1) {
+		for (uint32_t band = 0; band < band_count; band++) {
+			task(data, band, band_count);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->data = data;
+	pool->band_count = band_count;
+	pool->busy_workers = pool->thread_count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->mutex);
+
+	voxelspace_thread_pool_run_bands(pool, 0);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy_workers != 0) {
+		pthread_cond_wait(&pool->work_done, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+// utility functions
+void voxelspace_uint32_to_color(uint32_t num, voxelspace_color_t* color) {
+	color->r = (num & 0xFF000000) >> 24;
+	color->g = (num & 0x00FF0000) >> 16;
+	color->b = (num & 0x0000FF00) >> 8;
+	color->a = (num & 0x000000FF);
+}
+
+uint32_t voxelspace_color_to_uint32(voxelspace_color_t* color) {
+	return (uint32_t)((color->r << 24) + (color->g << 16) + (color->b << 8) + color->a);
+}
+
+// index of the cell (x, y) falls in, the map repeats so any point has one
+static inline uint32_t voxelspace_cell(const voxelspace_scene_t* scene, double x, double y) {
+	uint32_t cell_x = (uint32_t)(int64_t)floor(x) & (scene->map_width - 1);
+	uint32_t cell_y = (uint32_t)(int64_t)floor(y) & (scene->map_height - 1);
+	return cell_x + cell_y * scene->map_width;
+}
+
+double voxelspace_terrain_height(voxelspace_scene_t* scene, double x, double y) {
+	return scene->height_map[voxelspace_cell(scene, x, y)] * scene->height_scale;
+}
+
+// init functions
+
+void voxelspace_scene_init(voxelspace_scene_t* scene, uint8_t *height_map, uint32_t *color_map, uint32_t map_width, uint32_t map_height) {
+	scene->height_map = height_map;
+	scene->color_map = color_map;
+	scene->map_width = map_width;
+	scene->map_height = map_height;
+
+	scene->height_scale = 0.25;
+
+	scene->levels[0].height_map = height_map;
+	scene->levels[0].color_map = color_map;
+	scene->levels[0].map_width = map_width;
+	scene->levels[0].map_height = map_height;
+	scene->level_count = 1;
+}
+
+// averages four colors channel by channel
+static inline uint32_t voxelspace_average_color(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+	uint32_t color = 0;
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		uint32_t sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+		color |= ((sum + 2) / 4) << shift;
+	}
+	return color;
+}
+
+int voxelspace_scene_build_levels(voxelspace_scene_t* scene, uint32_t level_count) {
+	voxelspace_scene_free_levels(scene);
+
+	// the maps may have been swapped out since the scene was made, level 1 is built from the current ones
+	scene->levels[0].height_map = scene->height_map;
+	scene->levels[0].color_map = scene->color_map;
+	scene->levels[0].map_width = scene->map_width;
+	scene->levels[0].map_height = scene->map_height;
+
+	if (level_count > VOXELSPACE_MAX_LEVELS) level_count = VOXELSPACE_MAX_LEVELS;
+
+	for (uint32_t i = 1; i < level_count; i++) {
+		const voxelspace_map_level_t *source = scene->levels + i - 1;
+		voxelspace_map_level_t *level = scene->levels + i;
+
+		// a level is never narrower than one cell
+		if (source->map_width == 1 && source->map_height == 1) break;
+
+		level->map_width = source->map_width > 1 ? source->map_width / 2 : 1;
+		level->map_height = source->map_height > 1 ? source->map_height / 2 : 1;
+		level->height_map = (uint8_t *) malloc(level->map_width * level->map_height);
+		level->color_map = (uint32_t *) malloc(level->map_width * level->map_height * sizeof(uint32_t));
+
+		if (level->height_map == NULL || level->color_map == NULL) {
+			free(level->height_map);
+			free(level->color_map);
+			voxelspace_scene_free_levels(scene);
+			return -1;
+		}
+
+		// the four cells of the level before, a side that is already 1 cell wide reads its one cell twice
+		uint32_t step_x = source->map_width > 1 ? 1 : 0;
+		uint32_t step_y = source->map_height > 1 ? source->map_width : 0;
+
+		for (uint32_t y = 0; y < level->map_height; y++) {
+			for (uint32_t x = 0; x < level->map_width; x++) {
+				uint32_t corner = (x << step_x) + (y << (step_y != 0)) * source->map_width;
+				uint32_t cells[4] = {corner, corner + step_x, corner + step_y, corner + step_x + step_y};
+
+				uint32_t height = 0;
+				for (int k = 0; k < 4; k++) height += source->height_map[cells[k]];
+
+				level->height_map[x + y * level->map_width] = (uint8_t)((height + 2) / 4);
+				level->color_map[x + y * level->map_width] = voxelspace_average_color(source->color_map[cells[0]], source->color_map[cells[1]],
+					source->color_map[cells[2]], source->color_map[cells[3]]);
+			}
+		}
+
+		scene->level_count++;
+	}
+
+	return 0;
+}
+
+void voxelspace_camera_init(voxelspace_camera_t* camera, voxelspace_renderer_t *renderer, double x, double y) {
+	camera->position.x = x;
+	camera->position.y = y;
+
+	camera->direction.x = 1;
+	camera->direction.y = 0;
+
+	camera->plane.x = 0;
+	camera->plane.y = renderer->aspect_ratio;
+	camera->plane_length = renderer->aspect_ratio;
+
+	camera->pitch = 0;
+	camera->height = 100;
+	camera->focal_length = 1;
+}
+
+int voxelspace_renderer_init(voxelspace_renderer_t* renderer, uint32_t *pixel_data, uint32_t screen_width, uint32_t screen_height) {
+	renderer->pixel_data = pixel_data;
+	renderer->screen_width = screen_width;
+	renderer->screen_height = screen_height;
+	renderer->aspect_ratio = (double) screen_width / screen_height;
+
+	renderer->distance = 800;
+	renderer->lod = 0.01;
+	renderer->sky_color = 0x87CEEBFF;
+
+	// everything voxelspace_renderer_free touches is set before the first allocation that can fail
+	renderer->slice_table = NULL;
+	renderer->thread_count = 0;
+	renderer->thread_pool = NULL;
+
+	renderer->y_buffer = (int *) malloc(screen_width * sizeof(int));
+
+	// grown to the number of slices on the first frame
+	renderer->slice_table = (voxelspace_slice_table_t *) calloc(1, sizeof(voxelspace_slice_table_t));
+
+	if (renderer->y_buffer == NULL || renderer->slice_table == NULL || voxelspace_renderer_set_thread_count(renderer, 1) != 0) {
+		voxelspace_renderer_free(renderer);
+		return -1;
+	}
+	return 0;
+}
+
+int voxelspace_renderer_set_thread_count(voxelspace_renderer_t* renderer, uint32_t thread_count) {
+	if (thread_count == 0) thread_count = 1;
+
+	voxelspace_thread_pool_free(renderer->thread_pool);
+	renderer->thread_pool = voxelspace_thread_pool_create(thread_count);
+
+	// keep the renderer usable, a NULL pool renders on the calling thread
+	if (renderer->thread_pool == NULL) {
+		renderer->thread_count = 1;
+		return -1;
+	}
+
+	renderer->thread_count = thread_count;
+	return 0;
+}
+
+// de-init functions
+
+static void voxelspace_slice_table_free(voxelspace_slice_table_t* table) {
+	if (table == NULL) return;
+
+	free(table->z);
+	free(table->base);
+	free(table->height_step);
+	free(table->levels);
+	free(table);
+}
+
+void voxelspace_renderer_free(voxelspace_renderer_t* renderer) {
+	voxelspace_thread_pool_free(renderer->thread_pool);
+	renderer->thread_pool = NULL;
+
+	voxelspace_slice_table_free(renderer->slice_table);
+	renderer->slice_table = NULL;
+
+	free(renderer->y_buffer);
+	renderer->y_buffer = NULL;
+}
+
+void voxelspace_scene_free_levels(voxelspace_scene_t* scene) {
+	for (uint32_t i = 1; i < scene->level_count; i++) {
+		free(scene->levels[i].height_map);
+		free(scene->levels[i].color_map);
+	}
+	scene->level_count = 1;
+}
+
+// camera movement functions
+
+void voxelspace_camera_set_dir(voxelspace_camera_t* camera, double x, double y) {
+	double length = sqrt(x * x + y * y);
+	if (length == 0) return;
+	camera->direction.x = x / length;
+	camera->direction.y = y / length;
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+void voxelspace_camera_rotate(voxelspace_camera_t* camera, double angle) {
+	double i_x = cos(angle);
+	double i_y = sin(angle);
+	double j_x = -i_y;
+	double j_y = i_x;
+
+	double x = camera->direction.x;
+	double y = camera->direction.y;
+
+	camera->direction.x = x * i_x + y * j_x;
+	camera->direction.y = x * i_y + y * j_y;
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+void voxelspace_camera_set_rotation(voxelspace_camera_t* camera, double angle) {
+	camera->direction.x = cos(angle);
+	camera->direction.y = sin(angle);
+
+	camera->plane.x = -(camera->direction.y) * camera->plane_length;
+	camera->plane.y = camera->direction.x * camera->plane_length;
+}
+
+// render functions
+
+/*
+arguments shared by every band of a frame, bands split the screen into equal column ranges, the
+camera's position is wrapped into the map and shifted by a whole number of maps so every position
+a slice reaches is positive, rays are the direction of column 0 and the step between columns
+*/
+typedef struct {
+	voxelspace_renderer_t *renderer;
+	voxelspace_scene_t *scene;
+	voxelspace_map_level_t levels[VOXELSPACE_MAX_LEVELS];
+	float position_x, position_y;
+	float ray_x, ray_y, ray_step_x, ray_step_y;
+} voxelspace_render_job_t;
+
+// start of a band when splitting length into band_count ranges, band_count gives the end of the last band
+static int voxelspace_band_start(int length, uint32_t band, uint32_t band_count) {
+	return (int)((int64_t)length * band / band_count);
+}
+
+// log2 of a power of two
+static uint32_t voxelspace_log2(uint32_t value) {
+	uint32_t log = 0;
+	while ((1u << log) < value) log++;
+	return log;
+}
+
+/*
+lays out the slices of the frame, the map level of a slice is the one whose cells are about as wide as the
+gap between neighbouring columns or neighbouring slices there, whichever is wider, returns -1 on failure to
+grow the table or if lod is negative, in which case nothing is drawn
+*/
+static int voxelspace_build_slices(voxelspace_renderer_t* renderer, voxelspace_scene_t* scene, voxelspace_camera_t* camera) {
+	voxelspace_slice_table_t *table = renderer->slice_table;
+
+	// with a negative lod the step between slices stops being positive and the slices never reach distance
+	if (!(renderer->lod >= 0)) return -1;
+
+	uint32_t count = 0;
+	double step = 1;
+	for (double z = 1; z < renderer->distance; z += step, step += renderer->lod) count++;
+
+	if (count > table->capacity) {
+		float *z = (float *) realloc(table->z, count * sizeof(float));
+		if (z != NULL) table->z = z;
+		float *base = (float *) realloc(table->base, count * sizeof(float));
+		if (base != NULL) table->base = base;
+		float *height_step = (float *) realloc(table->height_step, count * sizeof(float));
+		if (height_step != NULL) table->height_step = height_step;
+		uint8_t *levels = (uint8_t *) realloc(table->levels, count);
+		if (levels != NULL) table->levels = levels;
+
+		if (z == NULL || base == NULL || height_step == NULL || levels == NULL) return -1;
+		table->capacity = count;
+	}
+
+	int horizon = renderer->screen_height / 2 + camera->pitch;
+
+	// gap between the rays of neighbouring columns at distance 1
+	double column_gap = sqrt(camera->plane.x * camera->plane.x + camera->plane.y * camera->plane.y) / renderer->screen_width;
+
+	double z = 1;
+	step = 1;
+
+	for (uint32_t i = 0; i < count; i++) {
+		// screen rows per world unit of height at this distance
+		double scale = renderer->screen_height / z;
+
+		table->z[i] = (float)z;
+		table->base[i] = (float)(camera->height * scale + horizon);
+		table->height_step[i] = (float)(scene->height_scale * scale);
+
+		double gap = column_gap * z > step ? column_gap * z : step;
+
+		uint32_t level = 0;
+		while (level + 1 < scene->level_count && gap >= (double)(2u << level)) level++;
+		table->levels[i] = (uint8_t)level;
+
+		z += step;
+		step += renderer->lod;
+	}
+
+	table->slice_count = count;
+	return 0;
+}
+
+/*
+draws the terrain of one slice in column x if it rises above the highest row drawn there so far,
+returns 1 if that fills the column to the top of the screen
+*/
+static inline int voxelspace_draw_sample(voxelspace_renderer_t* renderer, const voxelspace_map_level_t* map, uint32_t cell, int y, int x) {
+	int top = renderer->y_buffer[x];
+
+	// terrain above the screen is clamped first, so a column that is already full never counts as filled again
+	if (y < 0) y = 0;
+	if (y >= top) return 0;
+
+	int w = renderer->screen_width;
+	uint32_t color = map->color_map[cell];
+	uint32_t *pixel = renderer->pixel_data + y * w + x;
+
+	for (int row = y; row < top; row++, pixel += w) {
+		*pixel = color;
+	}
+
+	renderer->y_buffer[x] = y;
+	return y == 0;
+}
+
+/*
+draws one slice across the columns [x_start, x_end), positions are floored, shifted down to the slice's level
+and wrapped, the map's width and height are powers of two so wrapping is a mask, with SSE2 the cells and rows
+of four columns are found at once and the four are skipped together when the y buffer hides all of them,
+returns how many columns the slice filled to the top of the screen
+*/
+static uint32_t voxelspace_render_slice(const voxelspace_render_job_t* job, uint32_t slice, int x_start, int x_end) {
+	voxelspace_renderer_t *renderer = job->renderer;
+	const voxelspace_slice_table_t *table = renderer->slice_table;
+
+	uint32_t level = table->levels[slice];
+	const voxelspace_map_level_t *map = job->levels + level;
+
+	uint32_t mask_x = map->map_width - 1;
+	uint32_t mask_y = map->map_height - 1;
+	uint32_t shift_y = voxelspace_log2(map->map_width);
+
+	float z = table->z[slice];
+	float base = table->base[slice];
+	float height_step = table->height_step[slice];
+
+	// point of column 0 and the step between the points of neighbouring columns
+	float left_x = job->position_x + z * job->ray_x;
+	float left_y = job->position_y + z * job->ray_y;
+	float step_x = z * job->ray_step_x;
+	float step_y = z * job->ray_step_y;
+
+	uint32_t filled = 0;
+	int x = x_start;
+
+#ifdef VOXELSPACE_SSE2
+	__m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+	__m128i level_shift = _mm_cvtsi32_si128(level);
+
+	for (; x + VOXELSPACE_COLUMN_BLOCK <= x_end; x += VOXELSPACE_COLUMN_BLOCK) {
+		__m128 column = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+		__m128 x4 = _mm_add_ps(_mm_set1_ps(left_x), _mm_mul_ps(column, _mm_set1_ps(step_x)));
+		__m128 y4 = _mm_add_ps(_mm_set1_ps(left_y), _mm_mul_ps(column, _mm_set1_ps(step_y)));
+
+		// positions are positive so truncating floors them
+		__m128i cell_x = _mm_and_si128(_mm_srl_epi32(_mm_cvttps_epi32(x4), level_shift), _mm_set1_epi32(mask_x));
+		__m128i cell_y = _mm_and_si128(_mm_srl_epi32(_mm_cvttps_epi32(y4), level_shift), _mm_set1_epi32(mask_y));
+
+		uint32_t cells[VOXELSPACE_COLUMN_BLOCK];
+		_mm_storeu_si128((__m128i *)cells, _mm_or_si128(cell_x, _mm_sll_epi32(cell_y, _mm_cvtsi32_si128(shift_y))));
+
+		__m128i heights = _mm_setr_epi32(map->height_map[cells[0]], map->height_map[cells[1]], map->height_map[cells[2]], map->height_map[cells[3]]);
+		__m128 rows4 = _mm_sub_ps(_mm_set1_ps(base), _mm_mul_ps(_mm_cvtepi32_ps(heights), _mm_set1_ps(height_step)));
+		__m128i rows = _mm_cvttps_epi32(rows4);
+
+		// most samples are hidden by nearer slices, those blocks end here
+		int visible = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(rows, _mm_loadu_si128((const __m128i *)(renderer->y_buffer + x)))));
+		if (visible == 0) continue;
+
+		int row[VOXELSPACE_COLUMN_BLOCK];
+		_mm_storeu_si128((__m128i *)row, rows);
+
+		for (int i = 0; i < VOXELSPACE_COLUMN_BLOCK; i++) {
+			if (visible & (1 << i)) filled += voxelspace_draw_sample(renderer, map, cells[i], row[i], x + i);
+		}
+	}
+#endif
+
+	for (; x < x_end; x++) {
+		uint32_t cell_x = ((uint32_t)(int)(left_x + (float)x * step_x) >> level) & mask_x;
+		uint32_t cell_y = ((uint32_t)(int)(left_y + (float)x * step_y) >> level) & mask_y;
+		uint32_t cell = cell_x | (cell_y << shift_y);
+
+		int y = (int)(base - (float)map->height_map[cell] * height_step);
+		filled += voxelspace_draw_sample(renderer, map, cell, y, x);
+	}
+
+	return filled;
+}
+
+/*
+draws a band of columns front to back one slice at a time, and stops early once every column
+of the band is filled to the top of the screen
+*/
+static void voxelspace_render_task(void* data, uint32_t band, uint32_t band_count) {
+	voxelspace_render_job_t *job = (voxelspace_render_job_t *)data;
+	voxelspace_renderer_t *renderer = job->renderer;
+	const voxelspace_slice_table_t *table = renderer->slice_table;
+
+	uint32_t w = renderer->screen_width;
+	uint32_t h = renderer->screen_height;
+
+	int x_start = voxelspace_band_start(w, band, band_count);
+	int x_end = voxelspace_band_start(w, band + 1, band_count);
+
+	// nothing is drawn yet, every column is open up from the bottom of the screen
+	for (int x = x_start; x < x_end; x++) {
+		renderer->y_buffer[x] = h;
+	}
+
+	uint32_t open = x_end - x_start;
+
+	for (uint32_t slice = 0; slice < table->slice_count && open > 0; slice++) {
+		open -= voxelspace_render_slice(job, slice, x_start, x_end);
+	}
+
+	// whatever the terrain didn't cover is sky, filled a row at a time
+	for (uint32_t y = 0; y < h; y++) {
+		uint32_t *row = renderer->pixel_data + y * w;
+
+		for (int x = x_start; x < x_end; x++) {
+			if ((int)y < renderer->y_buffer[x]) row[x] = renderer->sky_color;
+		}
+	}
+}
+
+void voxelspace_render(voxelspace_renderer_t* renderer, voxelspace_scene_t* scene, voxelspace_camera_t* camera) {
+	if (renderer->pixel_data == NULL || renderer->y_buffer == NULL || scene->height_map == NULL || scene->color_map == NULL) return;
+
+	if (voxelspace_build_slices(renderer, scene, camera) != 0) return;
+
+	voxelspace_render_job_t job;
+	job.renderer = renderer;
+	job.scene = scene;
+
+	// level 0 is read from the scene so swapping its maps needs no rebuild, as long as the size stays the same
+	memcpy(job.levels, scene->levels, sizeof(job.levels));
+	job.levels[0].height_map = scene->height_map;
+	job.levels[0].color_map = scene->color_map;
+	job.levels[0].map_width = scene->map_width;
+	job.levels[0].map_height = scene->map_height;
+
+	// ray of the leftmost column and the step between the rays of neighbouring columns
+	job.ray_x = (float)(camera->direction.x * camera->focal_length - camera->plane.x / 2);
+	job.ray_y = (float)(camera->direction.y * camera->focal_length - camera->plane.y / 2);
+	job.ray_step_x = (float)(camera->plane.x / renderer->screen_width);
+	job.ray_step_y = (float)(camera->plane.y / renderer->screen_width);
+
+	/*
+	floats keep the walk fast but run out of precision far from the origin, so the position is wrapped into
+	the map first, then pushed right and down by whole maps until the furthest slice can't reach below 0
+	*/
+	const voxelspace_slice_table_t *table = renderer->slice_table;
+	double reach = table->slice_count ? table->z[table->slice_count - 1] * (camera->focal_length + camera->plane_length) + 1 : 0;
+
+	double wrapped_x = camera->position.x - floor(camera->position.x / scene->map_width) * scene->map_width;
+	double wrapped_y = camera->position.y - floor(camera->position.y / scene->map_height) * scene->map_height;
+
+	job.position_x = (float)(wrapped_x + ceil(reach / scene->map_width) * scene->map_width);
+	job.position_y = (float)(wrapped_y + ceil(reach / scene->map_height) * scene->map_height);
+
+	uint32_t band_count = renderer->thread_pool == NULL ? 1 : renderer->thread_count;
+	if (band_count > renderer->screen_width) band_count = renderer->screen_width;
+
+	voxelspace_thread_pool_run(renderer->thread_pool, voxelspace_render_task, &job, band_count);
+}